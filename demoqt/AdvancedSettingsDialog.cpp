@@ -2,8 +2,9 @@
 #include "ui_defaultdialog.h"
 #include <SFML/Graphics.hpp>
 #include "SMC100C.h"
-#include "LibUSB3DPrinter.h" // Include the provided header file
+#include "LightEngineDriver.h"
 #include "individualCommands.h"
+#include <QMessageBox>
 
 /**************************************************************************************************************************************
 AdvancedSettingsDialog Implementation
@@ -25,7 +26,8 @@ Features:
 Implementation Details:
 - Utilizes Qt framework for UI elements and signal-slot mechanism to handle user interactions.
 - Employs error handling and input validation to ensure robust operation.
-- Integrates directly with hardware APIs, abstracting complex commands and responses for ease of use.
+- Every hardware command runs on the stage or light engine thread of HardwareExecutor, the dialog stays responsive and shows a
+  busy cursor until the answers arrive. Stop Stage cancels the stage commands still waiting and is sent next.
 - Designed for extensibility and maintenance ease, with clear separation between UI logic and hardware interaction.
 
 Author:
@@ -43,10 +45,13 @@ AdvancedSettingsDialog::AdvancedSettingsDialog(QWidget* parent) :
     ui(new Ui::AdvancedSettingsDialog)
 {
     ui->setupUi(this);
-    if (!initializeController(controller)) {
-
-        exit(0);
-    }
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage]() { return initializeController(*stage); }, [this](const bool& ok) {
+        if (!ok) {
+            QMessageBox::warning(this, tr("Advanced Settings"), tr("The stage controller did not answer on the selected COM port."));
+            reject();
+        }
+        });
     // Connect buttons to slots
     connect(ui->getLedDefault_Button, &QPushButton::clicked, this, &AdvancedSettingsDialog::on_getLedStatus_clicked);
     connect(ui->setLedDefaultButton, &QPushButton::clicked, this, &AdvancedSettingsDialog::on_setLedStatus_clicked);
@@ -68,110 +73,160 @@ AdvancedSettingsDialog::AdvancedSettingsDialog(QWidget* parent) :
 
 AdvancedSettingsDialog::~AdvancedSettingsDialog()
 {
+    cancelled->store(true); // Commands still queued are skipped, the running one finishes on its own
     delete ui;
 }
 
-void AdvancedSettingsDialog::on_getLedStatus_clicked() {
-    U8 status;
-    // Assuming GetLedDefaultStatus returns a bool indicating the status
-    if (GetLedDefaultStatus(&status)) {
-        ui->LedDefaultLabel->setText(status ? "On" : "Off");
+void AdvancedSettingsDialog::setBusy(int change) {
+    pendingCommands += change;
+    if (pendingCommands > 0) {
+        setCursor(Qt::BusyCursor);
+    }
+    else {
+        pendingCommands = 0;
+        unsetCursor();
     }
 }
 
-void AdvancedSettingsDialog::on_setLedStatus_clicked() {
-    U8 currentStatus;
-    // Assuming GetLedDefaultStatus returns a bool-like value (0 for off, non-0 for on)
-    if (GetLedDefaultStatus(&currentStatus)) {
-        // Toggle status: If it was on (true/non-0), set it to off (0), and vice versa
-        U8 newStatus = !currentStatus; // This toggles between 0 and 1
-        if (SetLedDefaultStatus(newStatus)) {
-            // Update the label to reflect the new status
-            ui->LedDefaultLabel->setText(newStatus ? "On" : "Off");
+void AdvancedSettingsDialog::cancelPendingCommands() {
+    cancelled->store(true);
+    cancelled = makeHardwareCancelToken();
+    setBusy(-pendingCommands);
+}
+
+namespace {
+
+// Strips the line end of a controller reply and returns the value at the given offset
+QString stageReplyValue(std::string reply, size_t length) {
+    reply.erase(std::remove(reply.begin(), reply.end(), '\n'), reply.end()); // Remove newline
+    reply.erase(std::remove(reply.begin(), reply.end(), '\r'), reply.end()); // Remove carriage return
+    return reply.size() > 3 ? QString::fromStdString(reply.substr(3, length)) : QString();
+}
+
+}
+
+void AdvancedSettingsDialog::on_getLedStatus_clicked() {
+    runCommand<std::optional<bool>>(HardwareLane::LightEngine, []() -> std::optional<bool> {
+        bool status;
+        if (lightEngine().getLedDefaultStatus(status)) {
+            return status;
         }
-        else {
-            // Handle error in setting new status, maybe log or show a message box
+        return std::nullopt;
+        }, [this](const std::optional<bool>& status) {
+            if (status) {
+                ui->LedDefaultLabel->setText(*status ? "On" : "Off");
+            }
+        });
+}
+
+void AdvancedSettingsDialog::on_setLedStatus_clicked() {
+    runCommand<std::optional<bool>>(HardwareLane::LightEngine, []() -> std::optional<bool> {
+        bool currentStatus;
+        if (lightEngine().getLedDefaultStatus(currentStatus)) {
+            // Toggle status: If it was on, set it to off, and vice versa
+            bool newStatus = !currentStatus;
+            if (lightEngine().setLedDefaultStatus(newStatus)) {
+                return newStatus;
+            }
         }
-    }
-    else {
-        // Handle error in getting current status, maybe log or show a message box
-    }
+        return std::nullopt;
+        }, [this](const std::optional<bool>& status) {
+            if (status) {
+                // Update the label to reflect the new status
+                ui->LedDefaultLabel->setText(*status ? "On" : "Off");
+            }
+        });
 }
 
 void AdvancedSettingsDialog::on_setIntensity_clicked() {
     uint8_t intensity = static_cast<uint8_t>(ui->IntensityLineEdit->text().toInt());
-    SetCurrent(0, intensity);  // Assuming index 0 for simplicity
+    runCommand<bool>(HardwareLane::LightEngine, [intensity]() { return lightEngine().setCurrent(intensity); });
 }
 
 void AdvancedSettingsDialog::on_getIntensity_clicked() {
-    uint8_t intensity;
-    if (GetCurrent(0, &intensity)) {  // Assuming index 0 for simplicity
-        ui->IntensityLineEdit->setText(QString::number(intensity));
-    }
+    runCommand<std::optional<int>>(HardwareLane::LightEngine, []() -> std::optional<int> {
+        uint8_t intensity;
+        if (lightEngine().getCurrent(intensity)) {
+            return intensity;
+        }
+        return std::nullopt;
+        }, [this](const std::optional<int>& intensity) {
+            if (intensity) {
+                ui->IntensityLineEdit->setText(QString::number(*intensity));
+            }
+        });
 }
 
 void AdvancedSettingsDialog::on_getPosition_clicked() {
-    std::string position = controller.GetPosition();
-    position.erase(std::remove(position.begin(), position.end(), '\n'), position.end()); // Remove newline
-    position.erase(std::remove(position.begin(), position.end(), '\r'), position.end()); // Remove carriage return
-    ui->PositionLineEdit->setText(QString::fromStdString(position.substr(3, 6)));
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<std::string>(HardwareLane::Stage, [stage]() { return stage->GetPosition(); }, [this](const std::string& position) {
+        ui->PositionLineEdit->setText(stageReplyValue(position, 6));
+        });
 }
 
 void AdvancedSettingsDialog::on_setPosition_clicked() {
     float position = ui->PositionLineEdit->text().toFloat();
-    controller.AbsoluteMove(position);
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage, position]() { stage->AbsoluteMove(position); return true; });
 }
 
 void AdvancedSettingsDialog::on_getAcceleration_clicked() {
-    std::string acc = controller.GetAcceleration();
-    acc.erase(std::remove(acc.begin(), acc.end(), '\n'), acc.end()); // Remove newline
-    acc.erase(std::remove(acc.begin(), acc.end(), '\r'), acc.end()); // Remove carriage return
-    ui->AccelerationLineEdit->setText(QString::fromStdString(acc.substr(3, 2)));
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<std::string>(HardwareLane::Stage, [stage]() { return stage->GetAcceleration(); }, [this](const std::string& acc) {
+        ui->AccelerationLineEdit->setText(stageReplyValue(acc, 2));
+        });
 }
 
 void AdvancedSettingsDialog::on_setAcceleration_clicked() {
     float acceleration = ui->AccelerationLineEdit->text().toFloat();
-    controller.SetAcceleration(acceleration);
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage, acceleration]() { stage->SetAcceleration(acceleration); return true; });
 }
 
 void AdvancedSettingsDialog::on_getVelocity_clicked() {
-    std::string velocity = controller.GetVelocity();
-    velocity.erase(std::remove(velocity.begin(), velocity.end(), '\n'), velocity.end()); // Remove newline
-    velocity.erase(std::remove(velocity.begin(), velocity.end(), '\r'), velocity.end()); // Remove carriage return
-    ui->VelocityLineEdit->setText(QString::fromStdString(velocity.substr(3, 4)));
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<std::string>(HardwareLane::Stage, [stage]() { return stage->GetVelocity(); }, [this](const std::string& velocity) {
+        ui->VelocityLineEdit->setText(stageReplyValue(velocity, 4));
+        });
 }
 
 void AdvancedSettingsDialog::on_setVelocity_clicked() {
     float velocity = ui->VelocityLineEdit->text().toFloat();
-    controller.SetVelocity(velocity);
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage, velocity]() { stage->SetVelocity(velocity); return true; });
 }
 
 void AdvancedSettingsDialog::on_getPosLimit_clicked() {
-    std::string pL = controller.GetPositiveLimit();
-    pL.erase(std::remove(pL.begin(), pL.end(), '\n'), pL.end()); // Remove newline
-    pL.erase(std::remove(pL.begin(), pL.end(), '\r'), pL.end()); // Remove carriage return
-    ui->PosLimitLineEdit->setText(QString::fromStdString(pL.substr(3, 2)));
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<std::string>(HardwareLane::Stage, [stage]() { return stage->GetPositiveLimit(); }, [this](const std::string& pL) {
+        ui->PosLimitLineEdit->setText(stageReplyValue(pL, 2));
+        });
 }
 
 
 void AdvancedSettingsDialog::on_setPosLimit_clicked() {
     float pL = ui->VelocityLineEdit->text().toFloat();
-    controller.SetPositiveLimit(pL);
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage, pL]() { stage->SetPositiveLimit(pL); return true; });
 }
 
 void AdvancedSettingsDialog::on_getNegLimit_clicked() {
-    std::string nL = controller.GetNegativeLimit();
-    nL.erase(std::remove(nL.begin(), nL.end(), '\n'), nL.end()); // Remove newline
-    nL.erase(std::remove(nL.begin(), nL.end(), '\r'), nL.end()); // Remove carriage return
-    ui->NegLimitLineEdit->setText(QString::fromStdString(nL.substr(3, 2)));
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<std::string>(HardwareLane::Stage, [stage]() { return stage->GetNegativeLimit(); }, [this](const std::string& nL) {
+        ui->NegLimitLineEdit->setText(stageReplyValue(nL, 2));
+        });
 }
  
 
 void AdvancedSettingsDialog::on_setNegLimit_clicked() {
     float nL = ui->VelocityLineEdit->text().toFloat();
-    controller.SetNegativeLimit(nL);
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage, nL]() { stage->SetNegativeLimit(nL); return true; });
 }
 
+// Moves and settings still waiting are dropped, so the stop is the next command the stage receives
 void AdvancedSettingsDialog::on_stopStage_clicked() {
-    controller.StopMotion();
+    cancelPendingCommands();
+    std::shared_ptr<SMC100C> stage = controller;
+    runCommand<bool>(HardwareLane::Stage, [stage]() { stage->StopMotion(); return true; });
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 #define ADVANCEDSETTINGSDIALOG_H
 
 #include <QDialog>
+#include <memory>
+#include <optional>
 #include "ui_defaultdialog.h"
 #include "SMC100C.h"
+#include "HardwareExecutor.h"
 
 
 namespace Ui {
@@ -41,7 +44,24 @@ private slots:
 
 private:
     Ui::AdvancedSettingsDialog *ui;
-    SMC100C controller; // Member variable for the SMC100C controller
+    // Used on the stage thread only, shared with the queued commands so closing the dialog never waits for the stage
+    std::shared_ptr<SMC100C> controller = std::make_shared<SMC100C>();
+    HardwareCancelToken cancelled = makeHardwareCancelToken(); // Replaced by stopStage, set when the dialog closes
+    int pendingCommands = 0; // The busy cursor is shown while commands are queued or running
+
+    // Runs a command on the hardware thread of its device, done receives the answer on the GUI thread
+    template <typename Result>
+    void runCommand(HardwareLane lane, std::function<Result()> operation, std::function<void(const Result&)> done = nullptr) {
+        setBusy(1);
+        runOnHardware<Result>(this, lane, cancelled, operation, [this, done](const Result& result) {
+            setBusy(-1);
+            if (done) {
+                done(result);
+            }
+            });
+    }
+    void setBusy(int change);
+    void cancelPendingCommands();
 };
 
 #endif // ADVANCEDSETTINGSDIALOG_H
@@ -0,0 +1,19 @@
+#include "HardwareExecutor.h"
+
+HardwareExecutor::HardwareExecutor() {
+    // One thread per device, kept alive between commands so a query does not pay for a thread start
+    for (QThreadPool* pool : { &stagePool, &lightEnginePool }) {
+        pool->setMaxThreadCount(1);
+        pool->setExpiryTimeout(-1);
+    }
+}
+
+void HardwareExecutor::waitForDone() {
+    stagePool.waitForDone();
+    lightEnginePool.waitForDone();
+}
+
+HardwareExecutor& hardwareExecutor() {
+    static HardwareExecutor executor;
+    return executor;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef HARDWAREEXECUTOR_H
+#define HARDWAREEXECUTOR_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// The stage and the light engine each have one thread, so their commands never overlap and run in the order they were queued,
+// while a slow light engine warm-up does not hold up a stage query.
+enum class HardwareLane {
+    Stage,
+    LightEngine
+};
+
+// Set to skip the queued operations of a window and drop the results of its running ones
+typedef std::shared_ptr<std::atomic<bool>> HardwareCancelToken;
+
+inline HardwareCancelToken makeHardwareCancelToken() {
+    return std::make_shared<std::atomic<bool>>(false);
+}
+
+class HardwareExecutor {
+public:
+    HardwareExecutor();
+
+    QThreadPool* lane(HardwareLane lane) { return lane == HardwareLane::Stage ? &stagePool : &lightEnginePool; }
+
+    template <typename Operation>
+    auto run(HardwareLane lane, Operation operation) {
+        return QtConcurrent::run(this->lane(lane), std::move(operation));
+    }
+
+    // Waits for the running and queued operations, called before the hardware is shut down
+    void waitForDone();
+
+private:
+    QThreadPool stagePool;
+    QThreadPool lightEnginePool;
+};
+
+HardwareExecutor& hardwareExecutor();
+
+// Runs the operation on the lane and hands its result to done on the receiver's thread through the event loop. Nothing is
+// delivered once the token is cancelled or the receiver is destroyed; an operation that has not started by then is skipped.
+template <typename Result>
+void runOnHardware(QObject* receiver, HardwareLane lane, HardwareCancelToken cancelled, std::function<Result()> operation,
+    std::function<void(const Result&)> done) {
+    auto* watcher = new QFutureWatcher<Result>(receiver);
+    QObject::connect(watcher, &QFutureWatcher<Result>::finished, receiver, [watcher, cancelled, done]() {
+        if (!cancelled->load()) {
+            done(watcher->result());
+        }
+        watcher->deleteLater();
+        });
+    watcher->setFuture(hardwareExecutor().run(lane, [cancelled, operation]() {
+        return cancelled->load() ? Result{} : operation();
+        }));
+}
+
+#endif // HARDWAREEXECUTOR_H
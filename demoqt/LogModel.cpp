@@ -0,0 +1,147 @@
+#include "LogModel.h"
+#include <QBrush>
+#include <QColor>
+#include <QDateTime>
+#include <algorithm>
+#include <iterator>
+
+/**************************************************************************************************************************************
+LogModel Implementation
+
+Description:
+Model behind the output terminal. The worker, the compile thread and the GUI itself append messages together with their severity and
+subsystem, a list view that only lays out the visible rows shows them.
+
+Notes:
+- Messages are inserted in batches by a single-shot timer, a burst of thousands of lines costs one model update.
+- The filter model works on the stated severity and subsystem, the text itself is never searched.
+***************************************************************************************************************************************/
+
+QString logSubsystemName(LogSubsystem subsystem) {
+    switch (subsystem) {
+    case LogSubsystem::Print: return "Print";
+    case LogSubsystem::Stage: return "Stage";
+    case LogSubsystem::LightEngine: return "Light engine";
+    case LogSubsystem::Slices: return "Slices";
+    default: return "General";
+    }
+}
+
+//--------------------------------------------------------Log Model-----------------------------------------------------------------
+
+LogModel::LogModel(QObject* parent)
+    : QAbstractListModel(parent), flushTimer(new QTimer(this))
+{
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(frameMs);
+    connect(flushTimer, &QTimer::timeout, this, &LogModel::flush);
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(entries.size());
+}
+
+QVariant LogModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(entries.size())) {
+        return QVariant();
+    }
+    const LogEntry& entry = entries[static_cast<size_t>(index.row())];
+    switch (role) {
+    case Qt::DisplayRole:
+        return QDateTime::fromMSecsSinceEpoch(entry.timeMs).toString("hh:mm:ss  ") + entry.text;
+    case Qt::ToolTipRole:
+        return logSubsystemName(entry.subsystem) + ": " + entry.text;
+    case Qt::ForegroundRole:
+        if (entry.severity == LogSeverity::Error) {
+            return QBrush(QColor(192, 0, 0));
+        }
+        if (entry.severity == LogSeverity::Warning) {
+            return QBrush(QColor(176, 96, 0));
+        }
+        return QVariant();
+    case SeverityRole:
+        return static_cast<int>(entry.severity);
+    case SubsystemRole:
+        return static_cast<int>(entry.subsystem);
+    default:
+        return QVariant();
+    }
+}
+
+void LogModel::append(const QString& message, LogSeverity severity, LogSubsystem subsystem) {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QStringList lines = message.split('\n');
+    for (const QString& line : lines) {
+        pending.append(LogEntry{ now, severity, subsystem, line });
+    }
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void LogModel::clear() {
+    beginResetModel();
+    entries.clear();
+    pending.clear();
+    endResetModel();
+}
+
+/**************************************************************************************************************************************
+Function:
+    LogModel::flush
+Parameters:
+    void
+Returns:
+    void
+Description:
+    Inserts the messages received during the last frame with one insert, after removing the oldest entries that no longer fit.
+    Views and filter models therefore see at most one removal and one insertion per frame, however fast the print logs.
+***************************************************************************************************************************************/
+
+void LogModel::flush() {
+    if (pending.isEmpty()) {
+        return;
+    }
+    if (pending.size() > maxEntries) {
+        pending.erase(pending.begin(), pending.end() - maxEntries);
+    }
+
+    int overflow = static_cast<int>(entries.size()) + pending.size() - maxEntries;
+    int removed = std::min(overflow, static_cast<int>(entries.size()));
+    if (removed > 0) {
+        beginRemoveRows(QModelIndex(), 0, removed - 1);
+        entries.erase(entries.begin(), entries.begin() + removed);
+        endRemoveRows();
+    }
+
+    int first = static_cast<int>(entries.size());
+    beginInsertRows(QModelIndex(), first, first + pending.size() - 1);
+    std::move(pending.begin(), pending.end(), std::back_inserter(entries));
+    endInsertRows();
+    pending.clear();
+}
+
+//--------------------------------------------------------Log Filter-----------------------------------------------------------------
+
+LogFilterModel::LogFilterModel(QObject* parent)
+    : QSortFilterProxyModel(parent)
+{
+}
+
+void LogFilterModel::setMinimumSeverity(LogSeverity severity) {
+    minimumSeverity = severity;
+    invalidateFilter();
+}
+
+void LogFilterModel::setSubsystem(int subsystem) {
+    this->subsystem = subsystem;
+    invalidateFilter();
+}
+
+bool LogFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const {
+    QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    if (sourceModel()->data(index, LogModel::SeverityRole).toInt() < static_cast<int>(minimumSeverity)) {
+        return false;
+    }
+    return subsystem < 0 || sourceModel()->data(index, LogModel::SubsystemRole).toInt() == subsystem;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QSortFilterProxyModel>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include <deque>
+#include "LogCallback.h"
+
+Q_DECLARE_METATYPE(LogSeverity)
+Q_DECLARE_METATYPE(LogSubsystem)
+
+struct LogEntry {
+    qint64 timeMs; // Milliseconds since the epoch, when the GUI received the message
+    LogSeverity severity;
+    LogSubsystem subsystem;
+    QString text;
+};
+
+QString logSubsystemName(LogSubsystem subsystem);
+
+// Output terminal contents. Messages are queued and inserted at most once per frame, the oldest lines are dropped beyond
+// maxEntries, so a long print costs neither memory nor layout time that grows with its length.
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        SeverityRole = Qt::UserRole,
+        SubsystemRole
+    };
+    static constexpr int maxEntries = 20000;
+    static constexpr int frameMs = 33; // Matches the 30 fps of the print window
+
+    explicit LogModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+public slots:
+    // Each line of the message becomes one entry with the severity and subsystem of the whole message
+    void append(const QString& message, LogSeverity severity = LogSeverity::Info, LogSubsystem subsystem = LogSubsystem::General);
+    void clear();
+
+private slots:
+    void flush();
+
+private:
+    std::deque<LogEntry> entries;
+    QVector<LogEntry> pending; // Received since the last flush
+    QTimer* flushTimer;
+};
+
+// Lines of a LogModel at or above a severity, optionally of one subsystem
+class LogFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit LogFilterModel(QObject* parent = nullptr);
+
+    void setMinimumSeverity(LogSeverity severity);
+    void setSubsystem(int subsystem); // -1 for all subsystems
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+private:
+    LogSeverity minimumSeverity = LogSeverity::Info;
+    int subsystem = -1;
+};
+
+#endif // LOGMODEL_H
@@ -11,13 +11,14 @@ with the GUI and other parts of the application.
 Features:
 - Setup of printing parameters and system initialization.
 - Support for both static and dynamic printing processes.
+- A queue of jobs printed back to back, each prepared while the one before it prints.
 - Asynchronous execution of the printing process in a separate thread.
 - Abortion mechanism to stop the printing process as needed.
 - Logging of messages and errors for debugging and user feedback.
 
 Implementation Details:
 - Uses QtConcurrent and QThread for managing long-running tasks without blocking the main thread.
-- Employs atomic flags for thread-safe operation control (e.g., abortFlag and readyToRunFull).
+- Employs an atomic abort flag and a condition variable for the start of the print, both safe to set from the GUI thread.
 - Signals for logging messages and indicating process completion, ensuring GUI updates happen on the main thread.
 - Integration with SFML for managing the rendering window, used in the printing process.
 
@@ -35,41 +36,52 @@ Notes:
 
 #include "Worker.h"
 #include "individualCommands.h" // Include your SFML operations
+#include "LightEngineDriver.h"
 #include <iostream>
 #include <QDebug>
 #include <QtConcurrent/QtConcurrentRun>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#endif
 
 
 
 
 // Constructor
 Worker::Worker(QObject* parent) : QObject(parent) {
+    callback = [this](const std::string& message, LogSeverity severity, LogSubsystem subsystem) {
+        emit logMessage(QString::fromStdString(message), severity, subsystem);
+    };
 }
 
 // Destructor
 Worker::~Worker() {
 }
 
-void Worker::setParameters(const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime,
-    int inputCurrent, float initialPosition, float inputVelocity, bool isCLIP, float dlpPumpingAction, float initialVelocity,
-    int initialExposureCounter, int initialLayers) {
-    this->directoryPath = directoryPath;
-    this->maxImageDisplayCount = maxImageDisplayCount;
-    this->stepSize = stepSize;
-    this->mindarktime = mindarktime;
-    this->inputCurrent = inputCurrent; // Assume these are now member variables of Worker
-    this->initialPosition = initialPosition;
-    this->inputVelocity = inputVelocity;
-    this->isCLIP = isCLIP; // Add this
-    this->dlpPumpingAction = dlpPumpingAction; // Add this
-    this->initialVelocity = initialVelocity;
-    this->initialExposureCounter = initialExposureCounter;
-    this->initialLayers = initialLayers;
+bool Worker::setJob(const PrintJob& job) {
+    std::lock_guard<std::mutex> lock(startMutex);
+    if (readyToRunFull) {
+        return false;
+    }
+    if (jobs.empty()) {
+        jobs.push_back(job);
+    }
+    else {
+        jobs.front() = job;
+    }
+    return true;
 }
-void Worker::setDynamicParameters(const std::vector<std::pair<LayerSettings, int>>& orderedSettings) {
-    this->orderedSettings = orderedSettings;
-    // Flag to indicate dynamic printing is enabled
-    this->dynamicFlag = true;
+
+size_t Worker::enqueueJob(const PrintJob& job) {
+    std::lock_guard<std::mutex> lock(startMutex);
+    jobs.push_back(job);
+    if (readyToRunFull) {
+        prepareNextJob(); // Queued behind the running print, prepared while it prints
+    }
+    return jobs.size() + (nextJob.valid() ? 1 : 0);
 }
 
 
@@ -78,102 +90,281 @@ void Worker::process() {
     
     initializeSfmlWindow(); // Assuming this sets up the window
 
+    PrintJob job;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (jobs.empty()) {
+            // A start that arrived before the job would otherwise refuse every job until the program restarts
+            readyToRunFull = false;
+            abortFlag.store(false, std::memory_order_relaxed);
+            emit logMessage("No job to print, select one and initialize again.", LogSeverity::Warning, LogSubsystem::Print);
+            emit finished();
+            return;
+        }
+        job = jobs.front();
+    }
+
     // Log before InitializeSystem
     QString beforeInitMsg = "Initializing system...";
     emit logMessage(beforeInitMsg);
 
-    InitializeSystem(inputCurrent, initialPosition, inputVelocity, window, initialVelocity);
-
+    if (!InitializeSystem(job.inputCurrent, job.initialPosition, job.inputVelocity, window, job.initialVelocity)) {
+        emit error("The stage controller could not be opened, the system was not initialized.");
+        {
+            std::lock_guard<std::mutex> lock(startMutex);
+            jobs.clear();
+            readyToRunFull = false;
+            abortFlag.store(false, std::memory_order_relaxed);
+        }
+        window.close();
+        emit finished();
+        return;
+    }
 
 
     // Format and emit log message after initialization
     QString afterInitMsg = QString("System initialized with current: %1, position: %2, velocity: %3, initialVelocity: %4")
-        .arg(inputCurrent)
-        .arg(initialPosition)
-        .arg(inputVelocity)
+        .arg(job.inputCurrent)
+        .arg(job.initialPosition)
+        .arg(job.inputVelocity)
         // Assuming window has a method or property to represent it as a string
-        .arg(initialVelocity);
+        .arg(job.initialVelocity);
 
     emit logMessage(afterInitMsg);
 
     QString dynamicLog = QString("Dynamic Status: %1")
-        .arg(dynamicFlag);
+        .arg(job.kind != PrintJobKind::Static);
       
     emit logMessage(dynamicLog);
 
 
     qDebug() << "Worker's process thread ID:" << QThread::currentThreadId();
-    if (!isCLIP) {
+    if (!job.isClip) {
         qDebug() << "DLP flag triggered.";
         
     }
 
-    qDebug() << "DlP Pump:" << dlpPumpingAction;
-    // Wait loop for readyToRunFull to become true
-    while (!readyToRunFull) {
-        //qDebug() << "Flag Status:" << readyToRunFull;
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Prevents busy waiting
-        // Handle events to keep the window responsive
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) window.close();
+    qDebug() << "DlP Pump:" << job.dlpPumpingAction;
+    if (!waitForStart()) {
+        emit logMessage("Print aborted before it started.", LogSeverity::Warning, LogSubsystem::Print);
+        {
+            std::lock_guard<std::mutex> lock(startMutex);
+            jobs.clear(); // Queued jobs are dropped with the first one
         }
+        emit logMessage("Deinitializing System.");
+        if (!DeinitializeSystem(job.inputCurrent, job.initialPosition, job.inputVelocity, window, job.initialVelocity)) {
+            emit error("The stage controller could not be opened, the stage was not moved to its base position.");
+        }
+        emit logMessage("Deinitialization finished.");
+    }
+    else {
+        emit logMessage("Flag has been triggered");
+        runQueue(job);
     }
-    
 
-    emit logMessage("Flag has been triggered");
-    
-    // Define the logging callback
-    LogCallback callback = [this](const std::string& message) {
-        emit logMessage(QString::fromStdString(message));
-    };
+    // Ready for the next batch, the thread is started again by the next initialization
+    size_t leftOver = 0;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        leftOver = jobs.size();
+        jobs.clear();
+        readyToRunFull = false;
+        abortFlag.store(false, std::memory_order_relaxed);
+    }
+    if (leftOver > 0) {
+        emit logMessage(QString("%1 jobs were queued after the last one had finished and were not printed.").arg(leftOver),
+            LogSeverity::Warning, LogSubsystem::Print);
+    }
 
-    if (dynamicFlag) {
+    emit finished();
+}
 
-        try {
+/**************************************************************************************************************************************
+Function:
+    Worker::runQueue
+Parameters:
+    const PrintJob& firstJob: Job the system was initialized for
+Returns:
+    void
+Description:
+    Prints the queued jobs back to back. While a job prints, the job after it is validated, ingested and planned on another thread
+    and its first layers are decoded, so it starts as soon as the stage has moved to its initial position. The window, the light
+    engine and its monitor stay up between the jobs and the stage keeps one connection for the batch. It is homed by InitializeSystem
+    before the first job and only moved to the initial position of the others, the system is deinitialized after the last one.
+Notes:
+    - A job that cannot be prepared is skipped with its reason logged, the queue continues with the next one.
+    - An abort ends the running job and drops the queued ones.
+    - Every job writes its own layer timing, trace and metrics files, named after the job and its start (see RunPlan).
+***************************************************************************************************************************************/
+
+void Worker::runQueue(const PrintJob& firstJob) {
+    PrintJob lastJob = firstJob; // Deinitialized with, also when no job could be printed
+    bool atStart = true; // The stage is at the initial position of the job about to print, process moved it there for the first one
+    size_t printed = 0;
+
+    SMC100C stage; // Opened after InitializeSystem and closed before DeinitializeSystem, which open the port themselves
+    if (!initializeController(stage)) {
+        emit error("The stage connection could not be opened, no job was printed.");
+        std::lock_guard<std::mutex> lock(startMutex);
+        jobs.clear();
+        abortFlag.store(true, std::memory_order_relaxed); // Drops a job that is being prepared
+    }
 
-            emit logMessage("Entering Dynamic Function");
-            RunFullDynamic(directoryPath, stepSize, window, callback, [this]() -> bool { return this->abortFlag; }, isCLIP,
-                dlpPumpingAction,
-                orderedSettings);
+    while (true) {
+        std::future<PreparedJob> prepared;
+        size_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(startMutex);
+            if (getAbortFlag()) {
+                dropped = jobs.size() + (nextJob.valid() ? 1 : 0);
+                jobs.clear();
+            }
+            else {
+                prepareNextJob();
+            }
+            prepared = std::move(nextJob);
+            if (!prepared.valid()) {
+                readyToRunFull = false; // The batch ends here, jobs queued from now on wait for the next initialization
+            }
         }
-        catch (const std::exception& e) {
-            QString errorMsg = QString("Error in RunFullDynamic: %1").arg(e.what());
-            emit error(errorMsg);
-            qDebug() << errorMsg;
+        if (dropped > 0) {
+            emit logMessage(QString("Print aborted, %1 queued jobs dropped.").arg(dropped), LogSeverity::Warning, LogSubsystem::Print);
         }
-    }
-    else {
-        // Existing logic for static printing
-            // Call RunFull with the logging callback
-    // Make sure to catch exceptions if your RunFull function can throw them
-        try {
-            RunFull(directoryPath, maxImageDisplayCount, stepSize, mindarktime, window, callback, [this]() -> bool { return this->abortFlag; }, isCLIP,
-                dlpPumpingAction,
-                initialExposureCounter, initialLayers);
+        if (!prepared.valid()) {
+            break;
+        }
+        PreparedJob current = prepared.get(); // Usually ready, it was prepared while the job before printed
+        if (getAbortFlag()) {
+            continue; // Drops the remaining jobs above
+        }
+        if (!current.ok) {
+            emit logMessage(QString::fromStdString("Skipping " + current.job.jobPath + ", the job could not be prepared."),
+                LogSeverity::Warning, LogSubsystem::Slices);
+            continue;
+        }
+
+        initializeSfmlWindow(); // Reopened if it was closed during the job before
+        if (!atStart) {
+            emit logMessage("Moving the stage to the initial position of the next job.", LogSeverity::Info, LogSubsystem::Stage);
+            moveToJobStart(stage, current.job.initialPosition, current.job.inputVelocity, current.job.initialVelocity);
+            lightEngine().setCurrent(static_cast<unsigned char>(current.job.inputCurrent));
+        }
+        atStart = false;
+        lastJob = current.job;
+
+        {
+            std::lock_guard<std::mutex> lock(startMutex);
+            prepareNextJob(); // The job after this one is prepared while it prints
         }
 
+        emit logMessage(QString::fromStdString("Printing " + current.job.jobPath), LogSeverity::Info, LogSubsystem::Print);
+        try {
+            RunPlan(current.plan, window, callback, [this]() -> bool { return this->abortFlag; }, current.job.isClip,
+                current.job.dlpPumpingAction, false, &stage);
+            printed += getAbortFlag() ? 0 : 1;
+        }
         catch (const std::exception& e) {
-            QString errorMsg = QString("Error in RunFull: %1").arg(e.what());
+            QString errorMsg = QString("Error in RunPlan: %1").arg(e.what());
             emit error(errorMsg);
             qDebug() << errorMsg;
         }
     }
 
+    emit logMessage(QString("%1 jobs printed.").arg(printed));
     emit logMessage("Deinitializing System.");
 
-    DeinitializeSystem(inputCurrent, initialPosition, inputVelocity, window, initialVelocity);
+    stage.SMC100CClose();
+    if (!DeinitializeSystem(lastJob.inputCurrent, lastJob.initialPosition, lastJob.inputVelocity, window, lastJob.initialVelocity)) {
+        emit error("The stage controller could not be opened, the stage was not moved to its base position.");
+    }
+    window.close();
 
     emit logMessage("Deinitialization finished.");
+}
 
-    emit finished();
+/**************************************************************************************************************************************
+Function:
+    Worker::prepareNextJob
+Parameters:
+    None
+Returns:
+    void
+Description:
+    Takes the first waiting job off the queue and builds its plan with preparePrintJob on a thread of its own, with the first
+    layers decoded the way the print loop's ready-frame queue would. Only one job is prepared ahead, the memory of a queue of
+    decoded jobs would grow with the queue.
+Notes:
+    - Called with startMutex held.
+    - The preparation runs on its own thread alone and below normal priority. Exposures are counted in display frames, a
+      preparation competing with the print loop and its prefetcher for the cores would lengthen them.
+***************************************************************************************************************************************/
+
+void Worker::prepareNextJob() {
+    if (nextJob.valid() || jobs.empty()) {
+        return;
+    }
+    PrintJob job = jobs.front();
+    jobs.pop_front();
+    job.sourceSettings.width = frameSize.x;
+    job.sourceSettings.height = frameSize.y;
+
+    // Its log lines interleave with those of the running print
+    std::string name = std::filesystem::path(job.jobPath).filename().string();
+    LogCallback jobLog = [this, name](const std::string& message, LogSeverity severity, LogSubsystem subsystem) {
+        callback("[" + name + "] " + message, severity, subsystem);
+    };
+    nextJob = std::async(std::launch::async, [job, jobLog]() {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+        setIngestThreadLimit(1);
+        const size_t preloadLayers = 4; // The depth of RunPlan's ready-frame queue
+        PreparedJob prepared;
+        prepared.job = job;
+        try {
+            prepared.ok = preparePrintJob(job, jobLog, prepared.plan, preloadLayers);
+        }
+        catch (const std::exception& e) {
+            jobLog(std::string("Error while preparing the job: ") + e.what(), LogSeverity::Error, LogSubsystem::Slices);
+        }
+        return prepared;
+        });
 }
 
 
-// In Worker.cpp
 void Worker::setReadyToRunFull(bool ready) {
-    qDebug() << "setReadyToRunFull invoked with:" << ready;
-    readyToRunFull = ready;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        readyToRunFull = ready;
+    }
+    startCondition.notify_one();
+}
+
+/**************************************************************************************************************************************
+Function:
+    Worker::waitForStart
+Parameters:
+    None
+Returns:
+    bool: True once the print was started, false if it was aborted first
+Description:
+    Blocks on the start condition instead of polling the flag, so the print starts as soon as setReadyToRunFull is called. SFML
+    only delivers the window's events to the thread that polls them, the wait therefore times out once per frame to keep the
+    projector window responsive.
+***************************************************************************************************************************************/
+
+bool Worker::waitForStart() {
+    const auto frameInterval = std::chrono::milliseconds(33);
+    std::unique_lock<std::mutex> lock(startMutex);
+    while (!startCondition.wait_for(lock, frameInterval, [this]() { return readyToRunFull || getAbortFlag(); })) {
+        lock.unlock();
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed) window.close();
+        }
+        lock.lock();
+    }
+    return readyToRunFull;
 }
 
 void Worker::initializeSfmlWindow() {
@@ -188,11 +379,19 @@ void Worker::initializeSfmlWindow() {
         // Enable VSync to synchronize with the monitor refresh rate
         window.setVerticalSyncEnabled(true);
         window.setFramerateLimit(30);
+
+        std::lock_guard<std::mutex> lock(startMutex);
+        frameSize = window.getSize();
     }
 }
 
 void Worker::setAbortFlag(bool shouldAbort) {
-    abortFlag.store(shouldAbort, std::memory_order_relaxed);
+    {
+        // Under the start lock, so waitForStart cannot miss the abort between its check and its wait
+        std::lock_guard<std::mutex> lock(startMutex);
+        abortFlag.store(shouldAbort, std::memory_order_relaxed);
+    }
+    startCondition.notify_one();
 }
 
 bool Worker::getAbortFlag() const {
@@ -7,11 +7,12 @@
 #include <SFML/Graphics.hpp>
 #include <QDebug>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
 #include "individualCommands.h"
 
-
-typedef std::function<void(const std::string&)> LogCallback;
-
 class Worker : public QObject {
     Q_OBJECT
 
@@ -19,46 +20,49 @@ public:
     Worker(QObject* parent = nullptr);
     ~Worker();
 
-    void setParameters(const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime,
-        int inputCurrent, float initialPosition, float inputVelocity, bool isCLIP, float dlpPumpingAction,float initialVelocity,
-    int initialExposureCounter, int initialLayers);
-    void setDynamicParameters(const std::vector < std::pair<LayerSettings, int>>& orderedSettings);
+    // Job the system is initialized for, replaces the one set before. False once the print has started, queue the job instead.
+    bool setJob(const PrintJob& job);
+    // Appends a job printed right after the ones before it, also while they print. Returns the number of jobs waiting.
+    size_t enqueueJob(const PrintJob& job);
     void setAbortFlag(bool shouldAbort);
     bool getAbortFlag() const;
 
 signals:
     void finished();
     void error(QString err);
-    void logMessage(QString message);
+    void logMessage(QString message, LogSeverity severity = LogSeverity::Info, LogSubsystem subsystem = LogSubsystem::General);
 
 public slots:
+    // Thread-safe, process blocks the worker's event loop while it waits, so these are called from the GUI thread
     void setReadyToRunFull(bool ready);
     void process();
-    void setReadyToRunFullSlot() { readyToRunFull = true; 
-    qDebug() << "Worker slot: Flag set to" << readyToRunFull;
-    }
-    
+    void setReadyToRunFullSlot() { setReadyToRunFull(true); }
+
 
 private:
-    bool readyToRunFull = false; // Flag to indicate readiness
-    std::string directoryPath;
-    int maxImageDisplayCount;
-    float stepSize;
-    int mindarktime;
-    int inputCurrent;
-    float initialPosition;
-    float inputVelocity;
-    bool isCLIP;
-    float dlpPumpingAction;
+    // A queued job with its plan, built while the job before it printed
+    struct PreparedJob {
+        PrintJob job;
+        PrintPlan plan;
+        bool ok = false;
+    };
+
+    bool waitForStart(); // False if the print was aborted before it started
+    void runQueue(const PrintJob& firstJob);
+    // Starts preparing the first waiting job on its own thread unless one is prepared already. Called with startMutex held.
+    void prepareNextJob();
+
+    std::mutex startMutex;
+    std::condition_variable startCondition; // Wakes process on the start or abort of the print
+    bool readyToRunFull = false; // Guarded by startMutex
+    std::deque<PrintJob> jobs; // Guarded by startMutex, the first one is printed next
+    std::future<PreparedJob> nextJob; // Guarded by startMutex, taken from jobs while the job before it prints
+    sf::Vector2u frameSize; // Guarded by startMutex, resolution the jobs are prepared at
     //sf::RenderWindow* window;
     sf::RenderWindow window;
     void initializeSfmlWindow();
     std::atomic<bool> abortFlag {false};
-    float initialVelocity;
-    int initialExposureCounter;
-    int initialLayers;
-    std::vector<std::pair<LayerSettings, int>> orderedSettings;
-    bool dynamicFlag = false; // Add a flag to indicate dynamic printing
+    LogCallback callback;
 
 };
 
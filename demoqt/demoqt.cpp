@@ -5,10 +5,26 @@
 #include <QDebug>
 #include <QRandomGenerator> // Include this for generating random numbers
 #include <QFileDialog>
+#include <QFileInfo>
 #include "individualCommands.h"
+#include "LightEngineTrace.h"
+#include "LayerSettingsParser.h"
+#include "PlanFile.h"
+#include "LiveAdjustment.h"
+#include "PlanRules.h"
+#include "Metrics.h"
+#include "PrintTrace.h"
 #include <QPixmap>
 #include <QtConcurrent/QtConcurrentRun>
 #include <QTextEdit>
+#include <QScrollBar>
+#include <QInputDialog>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QCheckBox>
 #include "AdvancedSettingsDialog.h"
 #include "instructiondialog.h"
 #include <fstream>
@@ -109,6 +125,35 @@ demoqt::demoqt(QWidget* parent)
     connect(ui->comPortComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(onComPortComboBoxChanged(int)));
     connect(ui->comPortPushButton, SIGNAL(clicked()), this, SLOT(onConfirmComPortButtonClicked()));
 
+    // Output terminal: the list view only lays out the visible lines, the model batches the messages per frame
+    logModel = new LogModel(this);
+    logFilter = new LogFilterModel(this);
+    logFilter->setSourceModel(logModel);
+    ui->outputTerminalListView->setModel(logFilter);
+    ui->logSeverityComboBox->addItem("All messages", static_cast<int>(LogSeverity::Info));
+    ui->logSeverityComboBox->addItem("Warnings and errors", static_cast<int>(LogSeverity::Warning));
+    ui->logSeverityComboBox->addItem("Errors", static_cast<int>(LogSeverity::Error));
+    ui->logSubsystemComboBox->addItem("All subsystems", -1);
+    for (int subsystem = 0; subsystem < static_cast<int>(LogSubsystem::Count); ++subsystem) {
+        ui->logSubsystemComboBox->addItem(logSubsystemName(static_cast<LogSubsystem>(subsystem)), subsystem);
+    }
+    connect(ui->logSeverityComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), [this]() {
+        logFilter->setMinimumSeverity(static_cast<LogSeverity>(ui->logSeverityComboBox->currentData().toInt()));
+        });
+    connect(ui->logSubsystemComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), [this]() {
+        logFilter->setSubsystem(ui->logSubsystemComboBox->currentData().toInt());
+        });
+    // Stays at the newest line unless the user scrolled up to read an older one
+    QScrollBar* logScrollBar = ui->outputTerminalListView->verticalScrollBar();
+    connect(logScrollBar, &QScrollBar::valueChanged, [this, logScrollBar](int value) {
+        followLog = value == logScrollBar->maximum();
+        });
+    connect(logScrollBar, &QScrollBar::rangeChanged, [this, logScrollBar](int, int maximum) {
+        if (followLog) {
+            logScrollBar->setValue(maximum);
+        }
+        });
+
 
     runFullThread = new QThread(this); // Create the thread
     worker = new Worker(); // Create the worker object
@@ -117,25 +162,49 @@ demoqt::demoqt(QWidget* parent)
     worker->moveToThread(runFullThread);
 
     // Connect worker signals to demoqt slots
+    qRegisterMetaType<LogSeverity>();
+    qRegisterMetaType<LogSubsystem>();
     connect(worker, &Worker::logMessage, this, &demoqt::handleLogMessage, Qt::QueuedConnection);
+    connect(worker, &Worker::error, this, [this](const QString& message) {
+        logModel->append(message, LogSeverity::Error, LogSubsystem::Print);
+        }, Qt::QueuedConnection);
     connect(worker, &Worker::finished, this, &demoqt::runFullFinished, Qt::QueuedConnection);
     connect(runFullThread, &QThread::started, worker, &Worker::process);
-    bool success = connect(this, &demoqt::triggerRunFull, worker, &Worker::setReadyToRunFullSlot);
+    // Direct, process blocks the worker thread's event loop until the print starts. The slot only signals its condition variable.
+    bool success = connect(this, &demoqt::triggerRunFull, worker, &Worker::setReadyToRunFullSlot, Qt::DirectConnection);
     if (!success) {
         qDebug() << "Failed to connect signal and slot";
     }
 
 
-    // Clean up
-    connect(worker, &Worker::finished, worker, &QObject::deleteLater);
-    connect(runFullThread, &QThread::finished, runFullThread, &QObject::deleteLater);
+    lightEngineTimer = new QTimer(this);
+    lightEngineTimer->setInterval(1000);
+    connect(lightEngineTimer, &QTimer::timeout, this, &demoqt::updateLightEngineStatus);
+
+    warmUpWatcher = new QFutureWatcher<LightEngineWarmUpResult>(this);
+    connect(warmUpWatcher, &QFutureWatcher<LightEngineWarmUpResult>::finished, this, &demoqt::lightEngineWarmUpFinished);
+
+    compileWatcher = new QFutureWatcher<bool>(this);
+    connect(compileWatcher, &QFutureWatcher<bool>::finished, this, &demoqt::planCompileFinished);
+
+    // The worker and its thread are kept, the thread ends with each batch of jobs and is started again by the next initialization
+    connect(worker, &Worker::finished, runFullThread, &QThread::quit, Qt::DirectConnection);
 
     QString message = QString("When the Light Engine is initializing, you cannot execute any further actions until the light engine has booted up.\n\n")
         + "If the light engine has not been turned on in a while it might take some time.\n\n"
         + "Should the process take longer than five minutes it might be a good idea to unplug the system and retry the process.\n\n"
         + "If this does not work after multiple tries consider running the process for an extended period of time.\n\nThe light engine has shown to be sensitive to temperature. If the temperature is too low it might not turn on.";
 
-    ui->outputTerminalTextEdit->append(message);
+    logModel->append(message);
+
+    // Local dashboards scrape the printer directly, the endpoint only listens on the loopback interface
+    std::string metricsError;
+    if (metricsServer().start(MetricsServer::defaultPort, metricsError)) {
+        logModel->append(QString("Metrics available at http://127.0.0.1:%1/metrics").arg(MetricsServer::defaultPort));
+    }
+    else {
+        logModel->append(QString::fromStdString(metricsError), LogSeverity::Warning);
+    }
 
 
     this->dumpObjectTree();
@@ -143,8 +212,19 @@ demoqt::demoqt(QWidget* parent)
 }
 demoqt::~demoqt()
 {
+    warmUpCancelled = true;
+    hardwareCancelled->store(true);
+    if (stageCheckCancelled) {
+        stageCheckCancelled->store(true);
+    }
+    warmUpWatcher->waitForFinished();
+    hardwareExecutor().waitForDone();
+    compileWatcher->waitForFinished();
+    lightEngineMonitor().stop();
+    metricsServer().stop();
     runFullThread->quit();
     runFullThread->wait();
+    delete worker;
     delete ui;
 }
 
@@ -184,10 +264,7 @@ void demoqt::on_startPrintButton_clicked()
                 // Assuming setParameters method exists and is correctly implemented
                 //worker->setParameters(directoryPath, exposureTime, inputStepSize, minimumDarktime, inputCurrent, initialPosition, inputVelocity);
 
-                qDebug() << "Before invoking setReadyToRunFull, main thread ID:" << QThread::currentThreadId();
-                //emit triggerRunFull();
-                worker->setReadyToRunFullSlot(); // Direct call for testing
-                qDebug() << "After invoking setReadyToRunFull, main thread ID:" << QThread::currentThreadId();
+                emit triggerRunFull();
 
             }
 
@@ -217,90 +294,194 @@ void demoqt::on_abortButton_clicked() {
     }
 }
 
+// Queues a change of the running print, the print loop echoes it to the log once it takes effect
+void demoqt::on_adjustPrintButton_clicked() {
+    if (!parameterChannel().isPrinting()) {
+        logModel->append("No print is running, adjustments apply to a running print only.", LogSeverity::Warning, LogSubsystem::Print);
+        return;
+    }
+    size_t currentLayer = parameterChannel().currentLayer();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Adjust Print"));
+    QFormLayout* form = new QFormLayout(&dialog);
+
+    QSpinBox* fromLayer = new QSpinBox(&dialog);
+    fromLayer->setRange(static_cast<int>(currentLayer) + 1, 1000000);
+    fromLayer->setValue(static_cast<int>(currentLayer) + 1);
+    form->addRow(tr("From layer (now %1):").arg(currentLayer), fromLayer);
+
+    // The lowest value of each box means the setting is left unchanged
+    QSpinBox* exposure = new QSpinBox(&dialog);
+    exposure->setRange(0, 10000);
+    exposure->setSpecialValueText(tr("Unchanged"));
+    exposure->setSuffix(tr(" frames"));
+    form->addRow(tr("Exposure:"), exposure);
+
+    QSpinBox* darkTime = new QSpinBox(&dialog);
+    darkTime->setRange(-1, 600000);
+    darkTime->setValue(-1);
+    darkTime->setSpecialValueText(tr("Unchanged"));
+    darkTime->setSuffix(tr(" ms"));
+    form->addRow(tr("Dark time:"), darkTime);
+
+    QDoubleSpinBox* stepSize = new QDoubleSpinBox(&dialog);
+    stepSize->setRange(0.0, 1.0);
+    stepSize->setDecimals(3);
+    stepSize->setSingleStep(0.005);
+    stepSize->setSpecialValueText(tr("Unchanged"));
+    stepSize->setSuffix(tr(" mm"));
+    form->addRow(tr("Step size:"), stepSize);
+
+    QSpinBox* intensity = new QSpinBox(&dialog);
+    intensity->setRange(-1, 255);
+    intensity->setValue(-1);
+    intensity->setSpecialValueText(tr("Unchanged"));
+    form->addRow(tr("Intensity:"), intensity);
+
+    QCheckBox* reset = new QCheckBox(tr("Return to the planned values first"), &dialog);
+    form->addRow(reset);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
 
+    ParameterAdjustment adjustment;
+    adjustment.fromLayer = static_cast<size_t>(fromLayer->value());
+    adjustment.requestedAtLayer = parameterChannel().currentLayer();
+    if (exposure->value() > 0) adjustment.exposureFrames = exposure->value();
+    if (darkTime->value() >= 0) adjustment.darkTimeMs = darkTime->value();
+    if (stepSize->value() > 0.0) adjustment.stepSize = static_cast<float>(stepSize->value());
+    if (intensity->value() >= 0) adjustment.intensity = intensity->value();
+    adjustment.reset = reset->isChecked();
+    if (!adjustment.exposureFrames && !adjustment.darkTimeMs && !adjustment.stepSize && !adjustment.intensity && !adjustment.reset) {
+        return;
+    }
 
+    if (!parameterChannel().submit(adjustment)) {
+        logModel->append("The adjustment could not be queued, the print has ended or too many are waiting.", LogSeverity::Error,
+            LogSubsystem::Print);
+        return;
+    }
+    logModel->append(QString::fromStdString("Adjustment " + describeAdjustment(adjustment) + " queued from layer " +
+        std::to_string(adjustment.fromLayer)), LogSeverity::Info, LogSubsystem::Print);
+}
 
-void demoqt::on_initializeSystemButton_clicked()
-{
 
-    if (ui != nullptr) {
-        bool ok;
-        int inputCurrent = ui->inputCurrent->text().toInt(&ok);
-        if (!ok) std::cout << "Invalid input for current" << std::endl;
 
-        bool flag;
-        int exposureTime = ui->exposureTime->text().toInt(&flag);
-        if (!flag) std::cout << "Invalid input for exposure time" << std::endl;
 
-        int minimumDarktime = ui->minimumDarktime->text().toInt(&ok);
-        if (!ok) std::cout << "Invalid input for minimum darktime" << std::endl;
+// Job described by the main window, read when it is initialized or queued. False if its settings file was refused.
+bool demoqt::jobFromUi(PrintJob& job)
+{
+    job = PrintJob();
+    bool ok;
+    job.inputCurrent = ui->inputCurrent->text().toInt(&ok);
+    if (!ok) std::cout << "Invalid input for current" << std::endl;
 
-        float initialPosition = ui->initialPosition->text().toFloat(&ok);
-        if (!ok) std::cout << "Invalid input for initial position" << std::endl;
+    bool flag;
+    job.maxImageDisplayCount = ui->exposureTime->text().toInt(&flag);
+    if (!flag) std::cout << "Invalid input for exposure time" << std::endl;
 
-        float inputVelocity = ui->inputVelocity->text().toFloat(&ok);
-        if (!ok) std::cout << "Invalid input for velocity" << std::endl;
+    job.mindarktime = ui->minimumDarktime->text().toInt(&ok);
+    if (!ok) std::cout << "Invalid input for minimum darktime" << std::endl;
 
-        float inputStepSize = ui->inputStepSize->text().toFloat(&ok);
-        if (!ok) std::cout << "Invalid input for step size" << std::endl;
+    job.initialPosition = ui->initialPosition->text().toFloat(&ok);
+    if (!ok) std::cout << "Invalid input for initial position" << std::endl;
 
-        int initialLayers = ui->initialLayerNumber->text().toInt(&ok);
-        if (!ok) std::cout << "Invalid input for step size" << std::endl;
+    job.inputVelocity = ui->inputVelocity->text().toFloat(&ok);
+    if (!ok) std::cout << "Invalid input for velocity" << std::endl;
 
-        int initialExposureCounter = ui->initialExposureTime->text().toInt(&ok);
+    job.stepSize = ui->inputStepSize->text().toFloat(&ok);
+    if (!ok) std::cout << "Invalid input for step size" << std::endl;
 
-        float initialVelocity = ui->initialVelocity->text().toInt(&ok);
+    job.initialLayers = ui->initialLayerNumber->text().toInt(&ok);
+    if (!ok) std::cout << "Invalid input for step size" << std::endl;
 
+    job.initialExposureCounter = ui->initialExposureTime->text().toInt(&ok);
 
-        QString folderPath = ui->label_selectFolder->text();
-        if (folderPath.isEmpty()) {
-            std::cout << "No folder selected" << std::endl;
-        }
-        else {
-            std::cout << "Selected Folder: " << folderPath.toStdString() << std::endl;
-            // Convert QString to std::string
-            
-            // Call InitializeSystemDummy with collected values
-            //InitializeSystemDummy(directoryPath, inputCurrent, initialPosition, inputVelocity, window);
-            
-        }
-        std::string directoryPath = folderPath.toStdString();
+    job.initialVelocity = ui->initialVelocity->text().toInt(&ok);
 
-        bool isCLIP = ui->radioButtonCLIP->isChecked();
 
-        int dlpPumpingAction;
+    QString folderPath = ui->label_selectFolder->text();
+    if (folderPath.isEmpty()) {
+        std::cout << "No folder selected" << std::endl;
+    }
+    else {
+        std::cout << "Selected Folder: " << folderPath.toStdString() << std::endl;
+    }
+    job.jobPath = folderPath.toStdString();
+
+    job.isClip = ui->radioButtonCLIP->isChecked();
+
+    if (!job.isClip) {
+        job.dlpPumpingAction = ui->pumpingLineEdit->text().toFloat(&ok);
+    }
+    else {
+        job.dlpPumpingAction = 0.0f;
+    }
 
-        if (!isCLIP) {
-            dlpPumpingAction = ui->pumpingLineEdit->text().toFloat(&ok);
+    job.sourceSettings.pixelSize = meshPixelSize;
+    job.sourceSettings.streaming = ui->streamingCheckBox->isChecked();
+    job.sourceSettings.streamLead = static_cast<size_t>(ui->streamingLeadSpinBox->value());
+    job.adaptiveSettings.enabled = ui->adaptiveExposureCheckBox->isChecked();
+    job.doseSettings = doseSettings;
+    job.thermalSettings.enabled = ui->thermalGovernorCheckBox->isChecked();
+    job.motionSettings.velocity = job.inputVelocity; // Layers without their own velocity print at the velocity set by InitializeSystem
+
+    if (ui->DynamicCheckBox->isChecked()) {
+        QString filePath = ui->label_selectDynamicFolder->text();
+        if (filePath.endsWith(planFileExtension, Qt::CaseInsensitive)) {
+            // The worker maps the compiled plan itself, nothing is read here
+            job.kind = PrintJobKind::Compiled;
+            job.jobPath = filePath.toStdString();
+        }
+        else if (filePath.endsWith(ruleFileExtension, Qt::CaseInsensitive)) {
+            // Compiled and evaluated by the worker once the slices are open
+            job.kind = PrintJobKind::Rules;
+            job.rulesPath = filePath.toStdString();
+        }
+        else if (!filePath.isEmpty()) {
+            job.kind = PrintJobKind::Dynamic;
+            std::vector<LayerSettingsError> errors;
+            job.orderedSettings = readSettingsOrdered(filePath.toStdString(), errors);
+            if (!errors.empty()) {
+                // Skipping the bad rows would shift every later layer's settings onto the wrong slice
+                logModel->append("Fix the " + QString::number(errors.size()) + " problems in the settings file before printing.",
+                    LogSeverity::Error, LogSubsystem::Slices);
+                return false;
+            }
         }
         else {
-            dlpPumpingAction = 0.0f;
+            qDebug() << "No CSV file selected for dynamic settings.";
         }
+    }
+    return true;
+}
 
+void demoqt::on_initializeSystemButton_clicked()
+{
 
+    if (ui != nullptr) {
+        PrintJob job;
+        if (!jobFromUi(job)) {
+            return;
+        }
+        if (!worker->setJob(job)) {
+            logModel->append("The print has started, queue the job to print it after the running one.", LogSeverity::Warning,
+                LogSubsystem::Print);
+            return;
+        }
 
+        if (!runFullThread->isRunning()) {
+            runFullThread->start();
+            qDebug() << "Worker thread from main thread:" << worker->thread();
+            qDebug() << "Main thread ID:" << QThread::currentThreadId();
 
-        if (worker != nullptr) {
-            worker->setParameters(directoryPath, exposureTime, inputStepSize, minimumDarktime, inputCurrent, initialPosition, inputVelocity, isCLIP, dlpPumpingAction, initialVelocity, initialExposureCounter, initialLayers);
-            
-            if (ui->DynamicCheckBox->isChecked()) {
-                QString filePath = ui->label_selectDynamicFolder->text();
-                if (!filePath.isEmpty()) {
-                    auto orderedSettings = readSettingsOrdered(filePath.toStdString());
-                    worker->setDynamicParameters(orderedSettings);
-                }
-                else {
-                    qDebug() << "No CSV file selected for dynamic settings.";
-                }
-            }
-            
-            
-            if (!runFullThread->isRunning()) {
-                runFullThread->start();
-                qDebug() << "Worker thread from main thread:" << worker->thread();
-                qDebug() << "Main thread ID:" << QThread::currentThreadId();
-
-            }
         }
 
     }
@@ -309,22 +490,62 @@ void demoqt::on_initializeSystemButton_clicked()
     }
 }
 
+// Jobs queued behind the initialized one print back to back without deinitializing in between
+void demoqt::on_queueJobButton_clicked()
+{
+    if (!runFullThread->isRunning()) {
+        logModel->append("Initialize the system with the first job, the jobs queued after it print once it has finished.",
+            LogSeverity::Warning, LogSubsystem::Print);
+        return;
+    }
+    PrintJob job;
+    if (!jobFromUi(job)) {
+        return;
+    }
+    size_t waiting = worker->enqueueJob(job);
+    logModel->append(QString("Queued %1, %2 jobs waiting.").arg(QString::fromStdString(job.jobPath)).arg(waiting), LogSeverity::Info,
+        LogSubsystem::Print);
+}
+
+// Homing and the five queries take seconds, they run on the stage thread. Clicking again while they run cancels the check.
 void demoqt::on_checkStageButton_clicked()
 {
-    StageStatus status = checkStage();
+    if (stageCheckCancelled) {
+        stageCheckCancelled->store(true);
+        ui->engineLabel->setText("Cancelling stage check...");
+        return;
+    }
 
-    // Create a string to display the status
-// Extend the statusMessage QString to include positive and negative limits
-    QString statusMessage = QString("Position: %1 mm\nVelocity: %2 mm/s\nAcceleration: %3 mm/s2\nPositive Limit: %4 mm\nNegative Limit: %5 mm")
-        .arg(status.position)
-        .arg(status.velocity)
-        .arg(status.acceleration)
-        .arg(status.positiveLimit)
-        .arg(status.negativeLimit);
-    // For more values, continue appending with .arg()
+    HardwareCancelToken cancelled = makeHardwareCancelToken();
+    stageCheckCancelled = cancelled;
+    ui->checkStageButton->setText("Cancel Stage Check");
+    ui->engineLabel->setText("Homing and querying the stage...");
+
+    runOnHardware<StageStatus>(this, HardwareLane::Stage, hardwareCancelled,
+        [cancelled]() { return checkStage([cancelled]() { return cancelled->load(); }); },
+        [this, cancelled](const StageStatus& status) {
+            stageCheckCancelled.reset();
+            ui->checkStageButton->setText("Check Stage");
+            if (cancelled->load()) {
+                ui->engineLabel->setText("Stage check cancelled.");
+                return;
+            }
+            if (!status.connected) {
+                ui->engineLabel->setText("The stage controller could not be opened.");
+                return;
+            }
 
-    // Update the status label with the status message
-    ui->engineLabel->setText(statusMessage);
+            // Create a string to display the status
+            QString statusMessage = QString("Position: %1 mm\nVelocity: %2 mm/s\nAcceleration: %3 mm/s2\nPositive Limit: %4 mm\nNegative Limit: %5 mm")
+                .arg(status.position)
+                .arg(status.velocity)
+                .arg(status.acceleration)
+                .arg(status.positiveLimit)
+                .arg(status.negativeLimit);
+
+            // Update the status label with the status message
+            ui->engineLabel->setText(statusMessage);
+        });
 
 }
 void demoqt::on_selectFolderButton_clicked()
@@ -339,28 +560,260 @@ void demoqt::on_selectFolderButton_clicked()
     
 }
 
+void demoqt::on_selectMeshButton_clicked()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Select Mesh or Vector Slices"), QDir::homePath(), tr("Slice Files (*.stl *.svg)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    bool ok;
+    double pixelSizeUm = QInputDialog::getDouble(this, tr("Projector Pixel Size"), tr("Pixel size in the build plane (um):"),
+        meshPixelSize * 1000.0, 1.0, 1000.0, 2, &ok);
+    if (!ok) {
+        return;
+    }
+    meshPixelSize = static_cast<float>(pixelSizeUm / 1000.0);
+
+    // The mesh or vector file takes the place of the slice folder and is rasterized in memory by the worker
+    ui->label_selectFolder->setText(filePath);
+    logModel->append("Mesh selected, slicing at " + QString::number(pixelSizeUm) + " um per pixel.", LogSeverity::Info, LogSubsystem::Slices);
+}
+
 void demoqt::on_selectDynamicFolderButton_clicked() {
-    QString filePath = QFileDialog::getOpenFileName(this, tr("Select CSV File"), QDir::homePath(), tr("CSV Files (*.csv)"));
-    if (!filePath.isEmpty()) {
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Select CSV File"), QDir::homePath(),
+        tr("Layer Settings (*.csv *%1 *%2);;CSV Files (*.csv);;Compiled Plans (*%1);;Rule Files (*%2)")
+            .arg(QString(planFileExtension), QString(ruleFileExtension)));
+    if (filePath.endsWith(planFileExtension, Qt::CaseInsensitive)) {
+        ui->label_selectDynamicFolder->setText(filePath);
+        showPlanFileSummary(filePath);
+    }
+    else if (filePath.endsWith(ruleFileExtension, Qt::CaseInsensitive)) {
+        ui->label_selectDynamicFolder->setText(filePath);
+        showRuleFileSummary(filePath);
+    }
+    else if (!filePath.isEmpty()) {
         qDebug() << filePath;
         ui->label_selectDynamicFolder->setText(filePath);
 
-        auto orderedSettings = readSettingsOrdered(filePath.toStdString());
+        LayerSettingsFile settingsFile;
+        readLayerSettings(filePath.toStdString(), settingsFile);
+
+        // Large files can hold thousands of runs or bad rows, only the first ones are listed
+        const size_t maxListed = 50;
+        for (size_t i = 0; i < settingsFile.errors.size() && i < maxListed; ++i) {
+            logModel->append("Line " + QString::number(settingsFile.errors[i].line) + ": " +
+                QString::fromStdString(settingsFile.errors[i].message), LogSeverity::Error, LogSubsystem::Slices);
+        }
+        if (settingsFile.errors.size() > maxListed) {
+            logModel->append(QString::number(settingsFile.errors.size() - maxListed) + " more problems not listed.", LogSeverity::Error,
+                LogSubsystem::Slices);
+        }
+        for (const LayerSettingsError& warning : settingsFile.warnings) {
+            logModel->append("Line " + QString::number(warning.line) + ": " + QString::fromStdString(warning.message), LogSeverity::Warning,
+                LogSubsystem::Slices);
+        }
+
+        bool usesDose = false;
+        for (size_t i = 0; i < settingsFile.runs.size(); ++i) {
+            const LayerSettingsRun& run = settingsFile.runs[i];
+            const LayerSettings& settings = run.settings;
+            usesDose = usesDose || settings.dose > 0.0;
+            if (i >= maxListed) {
+                continue;
+            }
+            QString layers = "Layers " + QString::number(run.firstLayer) + "-" + QString::number(run.firstLayer + run.layerCount - 1);
+            QString exposure = settings.dose > 0.0
+                ? "Dose: " + QString::number(settings.dose) + " mJ/cm2"
+                : "Intensity: " + QString::number(settings.intensity) + ", Exposure Time: " + QString::number(settings.exposureTime);
+            // Motion values are only listed where the file sets them, the rest use the job settings
+            QString motion;
+            if (settings.stepSize) motion += ", Step: " + QString::number(*settings.stepSize) + " mm";
+            if (settings.motion.velocity) motion += ", Velocity: " + QString::number(*settings.motion.velocity) + " mm/s";
+            if (settings.motion.acceleration) motion += ", Acceleration: " + QString::number(*settings.motion.acceleration) + " mm/s2";
+            if (settings.motion.pumpingDistance) motion += ", Pumping: " + QString::number(*settings.motion.pumpingDistance) + " mm";
+            logModel->append(layers + " (" + exposure + ", Dark Time: " + QString::number(settings.darkTime) + motion + ")",
+                LogSeverity::Info, LogSubsystem::Slices);
+        }
+        if (settingsFile.runs.size() > maxListed) {
+            logModel->append(QString::number(settingsFile.runs.size() - maxListed) + " more setting changes not listed.",
+                LogSeverity::Info, LogSubsystem::Slices);
+        }
+        logModel->append(QString::number(settingsFile.rows) + " layers in " + QString::number(settingsFile.runs.size()) +
+            " runs, " + QString::number(settingsFile.errors.size()) + " problems.",
+            settingsFile.errors.empty() ? LogSeverity::Info : LogSeverity::Error, LogSubsystem::Slices);
 
-        for (const auto& settingPair : orderedSettings) {
-            const LayerSettings& settings = settingPair.first;
-            int count = settingPair.second;
-            ui->outputTerminalTextEdit->append("Layers with settings (Intensity: " + QString::number(settings.intensity) +
-                ", Exposure Time: " + QString::number(settings.exposureTime) +
-                ", Dark Time: " + QString::number(settings.darkTime) + ") = " + QString::number(count));
+        if (usesDose) {
+            selectIntensityCalibration();
         }
     }
 
 }
 
+// A compiled plan is only mapped, its header already holds everything shown here
+void demoqt::showPlanFileSummary(const QString& filePath) {
+    std::string error;
+    std::shared_ptr<PlanFile> file = PlanFile::open(filePath.toStdString(), error);
+    if (!file) {
+        logModel->append(QString::fromStdString(error), LogSeverity::Error, LogSubsystem::Slices);
+        return;
+    }
+    const PlanFileHeader& header = file->header();
+    logModel->append(QString("Compiled plan: %1 layers from %2 slices, %3 empty layers folded, about %4 min.")
+        .arg(header.layerCount)
+        .arg(header.sliceCount)
+        .arg(header.emptyLayers)
+        .arg(header.durationMs / 60000), LogSeverity::Info, LogSubsystem::Slices);
+    if (header.flags & PlanFileAdaptiveExposure) {
+        logModel->append("The exposures include the adaptive overhang adjustment.", LogSeverity::Info, LogSubsystem::Slices);
+    }
+    bool usesDose = false;
+    for (size_t i = 0; i < file->layerCount() && !usesDose; ++i) {
+        usesDose = file->record(i).doseMJ > 0.0;
+    }
+    if (usesDose) {
+        selectIntensityCalibration();
+    }
+}
+
+// Rules are only checked here, they are evaluated once the worker knows the slices
+void demoqt::showRuleFileSummary(const QString& filePath) {
+    std::vector<RuleError> errors;
+    std::shared_ptr<PlanRules> rules = PlanRules::load(filePath.toStdString(), errors);
+    for (const RuleError& error : errors) {
+        logModel->append("Line " + QString::number(error.line) + ": " + QString::fromStdString(error.message), LogSeverity::Error,
+            LogSubsystem::Slices);
+    }
+    if (!rules) {
+        logModel->append(QString::number(errors.size()) + " problems, the rule file cannot be printed.", LogSeverity::Error,
+            LogSubsystem::Slices);
+        return;
+    }
+    QStringList analysed;
+    if (rules->uses(RuleVariable::Area)) analysed << "area";
+    if (rules->uses(RuleVariable::NewArea)) analysed << "new area";
+    if (rules->uses(RuleVariable::Islands) || rules->uses(RuleVariable::NewIslands)) analysed << "islands";
+    logModel->append(QString::number(rules->ruleCount()) + " rules" +
+        (analysed.isEmpty() ? QString(".") : ", the slices are analysed for " + analysed.join(", ") + " before the print."),
+        LogSeverity::Info, LogSubsystem::Slices);
+    if (rules->assigns(RuleSetting::Dose)) {
+        selectIntensityCalibration();
+    }
+}
+
+// Compiling reads every slice once, it runs on a pool thread and reports through the event loop
+void demoqt::on_compilePlanButton_clicked() {
+    if (compileWatcher->isRunning()) {
+        logModel->append("A plan is already being compiled.", LogSeverity::Warning, LogSubsystem::Slices);
+        return;
+    }
+    QString folderPath = ui->label_selectFolder->text();
+    QString settingsPath = ui->label_selectDynamicFolder->text();
+    if (!QFileInfo(folderPath).isDir() ||
+        !(settingsPath.endsWith(".csv", Qt::CaseInsensitive) || settingsPath.endsWith(ruleFileExtension, Qt::CaseInsensitive))) {
+        logModel->append("Choose the slice folder and the CSV or rule file before compiling a plan.", LogSeverity::Warning,
+            LogSubsystem::Slices);
+        return;
+    }
+    QString planPath = QFileDialog::getSaveFileName(this, tr("Save Compiled Plan"),
+        QFileInfo(settingsPath).path() + "/" + QFileInfo(settingsPath).completeBaseName() + planFileExtension,
+        tr("Compiled Plans (*%1)").arg(QString(planFileExtension)));
+    if (planPath.isEmpty()) {
+        return;
+    }
+
+    bool ok;
+    float stepSize = ui->inputStepSize->text().toFloat(&ok);
+    if (!ok) {
+        logModel->append("Invalid input for step size", LogSeverity::Error);
+        return;
+    }
+    SliceSourceSettings sourceSettings;
+    sourceSettings.pixelSize = meshPixelSize;
+    AdaptiveExposureSettings adaptiveSettings;
+    adaptiveSettings.enabled = ui->adaptiveExposureCheckBox->isChecked();
+
+    ui->compilePlanButton->setEnabled(false);
+    compiledPlanPath = planPath;
+    double frameRate = doseSettings.frameRate;
+    compileWatcher->setFuture(QtConcurrent::run([this, folderPath, settingsPath, planPath, stepSize, sourceSettings, adaptiveSettings, frameRate]() {
+        return CompilePlan(folderPath.toStdString(), settingsPath.toStdString(), planPath.toStdString(), stepSize, sourceSettings,
+            adaptiveSettings, frameRate, [this](const std::string& message, LogSeverity severity, LogSubsystem subsystem) {
+                QMetaObject::invokeMethod(this, "handleLogMessage", Qt::QueuedConnection, Q_ARG(QString, QString::fromStdString(message)),
+                    Q_ARG(LogSeverity, severity), Q_ARG(LogSubsystem, subsystem));
+            });
+        }));
+}
+
+void demoqt::planCompileFinished() {
+    ui->compilePlanButton->setEnabled(true);
+    if (compileWatcher->result()) {
+        // The compiled plan replaces the CSV, the print starts from it
+        ui->label_selectDynamicFolder->setText(compiledPlanPath);
+        showPlanFileSummary(compiledPlanPath);
+    }
+}
+
+// Dose-based layer settings need the measured irradiance of the light engine and the highest current the print may use
+void demoqt::selectIntensityCalibration() {
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Select Intensity Calibration"), QDir::homePath(), tr("CSV Files (*.csv)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    auto calibration = std::make_shared<IntensityCalibration>();
+    if (!calibration->loadFromFile(filePath.toStdString())) {
+        logModel->append("Failed to read the intensity calibration " + filePath, LogSeverity::Error, LogSubsystem::LightEngine);
+        return;
+    }
+
+    bool ok;
+    int maxCurrent = QInputDialog::getInt(this, tr("Maximum Current"), tr("Highest safe light engine current:"),
+        doseSettings.maxCurrent, 0, 255, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    doseSettings.calibration = calibration;
+    doseSettings.maxCurrent = maxCurrent;
+    logModel->append("Intensity calibration loaded, up to current " + QString::number(maxCurrent) + ": " +
+        QString::number(calibration->irradiance(maxCurrent, 25.0)) + " mW/cm2 at 25 C.", LogSeverity::Info, LogSubsystem::LightEngine);
+}
+
 void demoqt::on_checkLightEngineButton_clicked() {
 
-    LightEngineStatus status = getLightEngineStatus();
+    // The monitor already polls the light engine, only query it directly when it is not running
+    LightEngineSample sample;
+    if (lightEngineMonitor().latest(sample)) {
+        showLightEngineStatus(sample.status);
+        return;
+    }
+    // The warm-up holds the light engine thread, its progress is already shown
+    if (warmUpWatcher->isRunning()) {
+        logModel->append("Light engine is warming up, its status follows once it is ready.", LogSeverity::Info, LogSubsystem::LightEngine);
+        return;
+    }
+
+    queryLightEngineStatus();
+
+}
+
+// Queries the status on the light engine thread, the button stays disabled until the answer arrives
+void demoqt::queryLightEngineStatus() {
+    if (!ui->checkLightEngineButton->isEnabled()) {
+        return;
+    }
+    ui->checkLightEngineButton->setEnabled(false);
+    ui->lighteEngineLabel->setText("Querying light engine...");
+
+    runOnHardware<LightEngineStatus>(this, HardwareLane::LightEngine, hardwareCancelled, getLightEngineStatus,
+        [this](const LightEngineStatus& status) {
+            ui->checkLightEngineButton->setEnabled(true);
+            showLightEngineStatus(status);
+        });
+}
+
+void demoqt::showLightEngineStatus(const LightEngineStatus& status) {
 
     // Create a string to display the status
     QString statusMessage = QString("Status: %1\nCurrent: %2\nSystem Status: %3\nLED Default Status: %4\nTemperature: %5 Celsius")
@@ -375,49 +828,125 @@ void demoqt::on_checkLightEngineButton_clicked() {
 
 }
 
+void demoqt::updateLightEngineStatus() {
+    LightEngineSample sample;
+    if (lightEngineMonitor().latest(sample)) {
+        showLightEngineStatus(sample.status);
+    }
+}
+
+void demoqt::startLightEngineMonitor() {
+    LightEngineMonitorSettings settings;
+
+    // Alarms are raised on the monitor thread and shown in the terminal through the event loop
+    lightEngineMonitor().start(getLightEngineStatus, settings, [this](const LightEngineAlarm& alarm) {
+        LogSeverity severity = alarm.type == LightEngineAlarmType::OverTemperature ? LogSeverity::Warning : LogSeverity::Info;
+        QMetaObject::invokeMethod(this, "handleLogMessage", Qt::QueuedConnection,
+            Q_ARG(QString, QString::fromStdString(alarm.message)), Q_ARG(LogSeverity, severity),
+            Q_ARG(LogSubsystem, LogSubsystem::LightEngine));
+        });
+    lightEngineTimer->start();
+}
+
 void demoqt::on_SM12onButton_clicked() {
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(2000)); // Wait for text to display
+    if (warmUpWatcher->isRunning()) {
+        logModel->append("Light engine is already warming up.", LogSeverity::Warning, LogSubsystem::LightEngine);
+        return;
+    }
 
+    ui->lighteEngineLabel->setText("Light Engine is warming up...\nPress SM12 off to cancel.");
 
-    TurnLightEngineOn();
+    lightEngineTimer->stop();
+    lightEngineMonitor().stop();
+    warmUpCancelled = false;
 
-    LightEngineStatus status = getLightEngineStatus();
+    // The warm-up can take minutes, it runs on the light engine thread and reports back through the event loop
+    warmUpWatcher->setFuture(hardwareExecutor().run(HardwareLane::LightEngine, [this]() {
+        return TurnLightEngineOn(
+            [this]() { return warmUpCancelled.load(); },
+            [this](const LightEngineWarmUpProgress& progress) {
+                QMetaObject::invokeMethod(this, "showWarmUpProgress", Qt::QueuedConnection,
+                    Q_ARG(int, static_cast<int>(progress.elapsed.count() / 1000)), Q_ARG(int, progress.sysStatus));
+            });
+        }));
 
-    // Create a string to display the status
-    QString statusMessage = QString("Status: %1\nCurrent: %2\nSystem Status: %3\nLED Default Status: %4\nTemperature: %5 Celsius")
-        .arg(status.status)
-        .arg(status.current)
-        .arg(status.sysStatus)
-        .arg(status.ledDefaultStatus ? "On" : "Off") // Assuming true means LED is on
-        .arg(status.temperature);
+}
 
-    // Update the status label with the status message
-    ui->lighteEngineLabel->setText(statusMessage);
+void demoqt::showWarmUpProgress(int elapsedSeconds, int sysStatus) {
+    ui->lighteEngineLabel->setText(QString("Light Engine is warming up... %1 s\nSystem Status: %2\nPress SM12 off to cancel.")
+        .arg(elapsedSeconds)
+        .arg(sysStatus));
+}
 
+void demoqt::lightEngineWarmUpFinished() {
+    LightEngineWarmUpResult result = warmUpWatcher->result();
+    logModel->append(QString::fromStdString(result.message),
+        result.outcome == WarmUpOutcome::Ready ? LogSeverity::Info : LogSeverity::Error, LogSubsystem::LightEngine);
+
+    if (result.outcome != WarmUpOutcome::Ready) {
+        ui->lighteEngineLabel->setText(QString::fromStdString(result.message));
+        return;
+    }
+
+    queryLightEngineStatus();
+
+    // Keep polling temperature and status for the rest of the session
+    startLightEngineMonitor();
 }
 
 void demoqt::on_SM12offButton_clicked() {
 
-    ui->lighteEngineLabel->setText("Light Engine is warming up...\nIf light engine is bugging program may if have to shut down.");
+    // A running warm-up switches the power off itself once it sees the cancel request
+    if (warmUpWatcher->isRunning()) {
+        warmUpCancelled = true;
+        ui->lighteEngineLabel->setText("Cancelling light engine warm-up...");
+        return;
+    }
 
-    TurnLightEngineOff();
-    ui->lighteEngineLabel->setText("Light Engine successfully turned on.");
+    lightEngineTimer->stop();
+    lightEngineMonitor().stop();
 
+    ui->SM12offButton->setEnabled(false);
+    ui->lighteEngineLabel->setText("Turning the light engine off...");
 
-    LightEngineStatus status = getLightEngineStatusDummy();
+    runOnHardware<bool>(this, HardwareLane::LightEngine, hardwareCancelled, []() {
+        TurnLightEngineOff();
+        return true;
+        },
+        [this](const bool&) {
+            ui->SM12offButton->setEnabled(true);
 
-    // Create a string to display the status
-    QString statusMessage = QString("Status: %1\nCurrent: %2\nSystem Status: %3\nLED Default Status: %4\nTemperature: %5 Celsius")
-        .arg(status.status)
-        .arg(status.current)
-        .arg(status.sysStatus)
-        .arg(status.ledDefaultStatus ? "On" : "Off") // Assuming true means LED is on
-        .arg(status.temperature);
+            LightEngineStatus status = getLightEngineStatusDummy();
 
-    // Update the status label with the status message
-    ui->lighteEngineLabel->setText(statusMessage);
+            // Create a string to display the status
+            QString statusMessage = QString("Status: %1\nCurrent: %2\nSystem Status: %3\nLED Default Status: %4\nTemperature: %5 Celsius")
+                .arg(status.status)
+                .arg(status.current)
+                .arg(status.sysStatus)
+                .arg(status.ledDefaultStatus ? "On" : "Off") // Assuming true means LED is on
+                .arg(status.temperature);
+
+            // Update the status label with the status message
+            ui->lighteEngineLabel->setText(statusMessage);
+        });
+
+}
+
+// Tracing can be switched on and off at any time, each print starts with empty statistics
+void demoqt::on_traceLatencyCheckBox_toggled(bool checked) {
+    lightEngineTrace().setEnabled(checked);
+    if (!checked) {
+        QString summary = QString::fromStdString(lightEngineTrace().summary());
+        if (!summary.isEmpty()) {
+            logModel->append("USB latency:\n" + summary.trimmed(), LogSeverity::Info, LogSubsystem::LightEngine);
+        }
+    }
+}
 
+// The next print writes <job>_<start>_print_trace.json, a print already running keeps its setting until it ends
+void demoqt::on_tracePhasesCheckBox_toggled(bool checked) {
+    printTrace().setEnabled(checked);
 }
 
 
@@ -429,8 +958,8 @@ void demoqt::startRunFullProcess() {
         runFullThread->start();
     }
 }
-void demoqt::handleLogMessage(const QString& message) {
-    ui->outputTerminalTextEdit->append(message);
+void demoqt::handleLogMessage(const QString& message, LogSeverity severity, LogSubsystem subsystem) {
+    logModel->append(message, severity, subsystem);
 }  
 
 
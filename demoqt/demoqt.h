@@ -6,7 +6,12 @@
 #include <QWidget>
 #include <QThread>
 #include <QLabel>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <atomic>
 #include "Worker.h"
+#include "LogModel.h"
+#include "HardwareExecutor.h"
 
 class demoqt : public QMainWindow
 {
@@ -25,16 +30,23 @@ private slots:
     void on_startPrintButton_clicked();
     void on_checkStageButton_clicked();
     void on_selectFolderButton_clicked();
+    void on_selectMeshButton_clicked();
     void on_selectDynamicFolderButton_clicked();
+    void on_compilePlanButton_clicked();
+    void planCompileFinished();
     void on_checkLightEngineButton_clicked();
     void on_initializeSystemButton_clicked();
+    void on_queueJobButton_clicked();
     void on_SM12onButton_clicked();
     void on_SM12offButton_clicked();
+    void on_traceLatencyCheckBox_toggled(bool checked);
+    void on_tracePhasesCheckBox_toggled(bool checked);
     void on_abortButton_clicked();
+    void on_adjustPrintButton_clicked();
     // Slot to handle starting the RunFull process
     void startRunFullProcess();
     // Slot to update the GUI based on log messages
-    void handleLogMessage(const QString& message);
+    void handleLogMessage(const QString& message, LogSeverity severity = LogSeverity::Info, LogSubsystem subsystem = LogSubsystem::General);
     // Slot to handle cleanup or further actions after RunFull finishes
     void runFullFinished();
     void on_openAdvancedSettings_clicked();
@@ -42,10 +54,35 @@ private slots:
     void onPrintingMethodChanged();
     void onComPortComboBoxChanged(int index);
     void onConfirmComPortButtonClicked();
+    // Shows the latest sample of the light engine monitor
+    void updateLightEngineStatus();
+    // Progress and result of the asynchronous light engine warm-up
+    void showWarmUpProgress(int elapsedSeconds, int sysStatus);
+    void lightEngineWarmUpFinished();
 
 private:
     Ui::demoqtClass *ui;
    
     QThread* runFullThread; // Pointer to the thread for running RunFull
     Worker* worker; // Pointer to the worker object
+    float meshPixelSize = 0.05f; // mm per projector pixel, asked for when a mesh is selected
+    DoseSettings doseSettings; // Calibration for dose-based layer settings
+    QTimer* lightEngineTimer; // Refreshes the light engine label while the monitor runs
+    QFutureWatcher<LightEngineWarmUpResult>* warmUpWatcher; // Running warm-up, started by the SM12 on button
+    std::atomic<bool> warmUpCancelled{ false };
+    QFutureWatcher<bool>* compileWatcher; // Running plan compilation, started by the compile plan button
+    QString compiledPlanPath; // Output of the running compilation
+    LogModel* logModel; // Contents of the output terminal
+    LogFilterModel* logFilter; // Severity and subsystem shown in the output terminal
+    bool followLog = true; // Output terminal scrolls to new lines while at the bottom
+    HardwareCancelToken hardwareCancelled = makeHardwareCancelToken(); // Set on close, skips the queued hardware commands
+    HardwareCancelToken stageCheckCancelled; // Running stage check, clicking Check Stage again cancels it
+
+    bool jobFromUi(PrintJob& job);
+    void showLightEngineStatus(const LightEngineStatus& status);
+    void queryLightEngineStatus();
+    void startLightEngineMonitor();
+    void selectIntensityCalibration();
+    void showPlanFileSummary(const QString& filePath);
+    void showRuleFileSummary(const QString& filePath);
 };
@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LogCallback.h"
+
+// What happened during a print. The values of each event are listed next to it, formatPrintEvent turns them into the log line.
+enum class PrintEventType : uint16_t {
+	LayerDisplayed,			// i0 slice index
+	DarkPhaseFinished,		// i0 duration in ms
+	LightPhaseFinished,		// i0 duration in ms
+	StagePosition,			// x0 position in mm
+	StagePositionInvalid,	// Reply of the controller held no position
+	LayerExposed,			// i0 slice index, i1 slice count
+	EmptyLayersSkipped,		// i0 folded empty layers in the next move
+	EngineTemperature,		// i0 temperature in °C
+	NextImageLoaded,		// i0 slice index
+	ImageLoadFailed,		// i0 slice index
+	ProfileLate,			// i0 lateness in ms
+	SettingsApplied,		// i0 intensity, i1 exposure frames, i2 dark time in ms
+	DoseResolved,			// x0 dose, i0 temperature, i1 intensity, i2 exposure frames, x1 delivered dose
+	DoseUnreachable,		// i0 highest current allowed
+	GovernorLimit,			// i0 current limit, i1 projected temperature
+	GovernorIntensity,		// i0 requested intensity, i1 governed intensity, i2 exposure frames, i3 governed exposure frames
+	CooldownStarted,
+	CooldownFinished,		// i0 duration in ms
+	WaitingForSlicer,
+	StageVelocity,			// x0 mm/s
+	StageAcceleration,		// x0 mm/s²
+	TemperatureUnavailable,	// i0 last measured temperature in °C, used for the dose until a read succeeds
+	Count
+};
+
+// Fixed-size binary record, written to the ring by the printing threads and to the event file as is
+struct PrintEvent {
+	int64_t timeUs;			// Since EventLog::start
+	uint32_t sequence;		// Order of recording
+	PrintEventType type;
+	uint16_t reserved;
+	int32_t i[4];
+	double x[2];
+};
+static_assert(sizeof(PrintEvent) == 48, "The event file stores PrintEvent as is");
+
+// Start of the event file, followed by the records
+struct EventFileHeader {
+	char magic[8];			// "CLIPEVTS"
+	uint32_t version;
+	uint32_t recordSize;	// sizeof(PrintEvent)
+	int64_t startUnixUs;	// Wall clock of timeUs 0
+};
+static_assert(sizeof(EventFileHeader) == 24, "The event file stores EventFileHeader as is");
+
+constexpr char eventFileMagic[8] = { 'C', 'L', 'I', 'P', 'E', 'V', 'T', 'S' };
+constexpr uint32_t eventFileVersion = 1;
+
+const char* printEventName(PrintEventType type);
+// Level and part of the printer of an event, passed to the sink with its text
+LogSeverity printEventSeverity(PrintEventType type);
+LogSubsystem printEventSubsystem(PrintEventType type);
+std::string formatPrintEvent(const PrintEvent& event);
+// Reads an event file written by EventLog, false and an error if it is not one
+bool readEventFile(const std::string& filePath, std::vector<PrintEvent>& events, std::string& error);
+
+typedef LogCallback::Sink EventSink;
+
+// Structured log of the print loop. Recording only stores a record in a lock-free ring, a background thread appends the records
+// to the event file and formats them for the sink, so no string is built and nothing is flushed on the printing threads.
+// Any number of threads may record, the ring drops events instead of blocking when the writer falls behind.
+class EventLog {
+public:
+	static constexpr size_t capacity = 8192;	// Power of two
+
+	EventLog();
+	~EventLog();
+
+	// Starts the writer thread. The sink receives the formatted events on the writer thread, empty to only write the file.
+	bool start(const std::string& filePath, EventSink sink);
+	// Writes the remaining events, reports dropped events to the sink and stops the writer. Does nothing if not started.
+	void stop();
+	bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+	void record(PrintEventType type, int32_t i0 = 0, int32_t i1 = 0, int32_t i2 = 0, int32_t i3 = 0, double x0 = 0.0, double x1 = 0.0);
+	uint64_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+	// Events recorded but not yet written, approximate while threads record
+	size_t depth() const { return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed); }
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;	// Slot index when free, index + 1 once written
+		PrintEvent event;
+	};
+
+	void writerLoop();
+	// Moves the recorded events to the file and the sink, returns how many there were
+	size_t drain();
+
+	std::array<Slot, capacity> slots;
+	std::atomic<size_t> head{ 0 };		// Next position to claim, shared by the recording threads
+	std::atomic<size_t> tail{ 0 };		// Next position to read, only advanced by the writer thread
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<bool> running{ false };
+	std::chrono::steady_clock::time_point startTime;
+
+	std::vector<PrintEvent> batch;		// Writer thread only
+	std::FILE* file = nullptr;
+	EventSink sink;
+	std::thread writer;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool stopRequested = false;
+};
+
+EventLog& eventLog();
+
+// Runs the event log for the lifetime of a print, also when the print returns early
+class EventLogScope {
+public:
+	EventLogScope(const std::string& filePath, EventSink sink) { eventLog().start(filePath, std::move(sink)); }
+	~EventLogScope() { eventLog().stop(); }
+};
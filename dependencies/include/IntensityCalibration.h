@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Irradiance at the build plane measured for one current and light engine temperature
+struct CalibrationPoint {
+	int current;			// SetCurrent value, 0 to 255
+	double temperature;		// Celsius
+	double irradiance;		// mW/cm²
+};
+
+// Intensity and exposure chosen for a dose
+struct DoseExposure {
+	int intensity;
+	int exposureFrames;
+	double irradiance;		// mW/cm² at the chosen intensity
+	double deliveredDose;	// mJ/cm², at least the requested dose
+};
+
+// Maps current and temperature to irradiance. Between calibration points the irradiance is interpolated linearly in current and
+// temperature, outside the calibrated range the nearest point is used.
+class IntensityCalibration {
+public:
+	// CSV with the header line Current,Temperature,Irradiance
+	bool loadFromFile(const std::string& filePath);
+	void addPoint(const CalibrationPoint& point);
+	bool empty() const { return rows.empty(); }
+
+	double irradiance(int current, double temperature) const;
+	int lowestCalibratedCurrent() const;
+	// Exposure at maxCurrent, false when maxCurrent is below the calibration or emits no light
+	bool exposureForDose(double doseMJ, double temperature, int maxCurrent, double frameRate, DoseExposure& exposure) const;
+
+private:
+	// Points of one temperature, sorted by current
+	struct Row {
+		double temperature;
+		std::vector<std::pair<int, double>> points;
+	};
+
+	double rowIrradiance(const Row& row, int current) const;
+
+	std::vector<Row> rows; // Sorted by temperature
+};
+
+struct DoseSettings {
+	std::shared_ptr<const IntensityCalibration> calibration;	// Required by plans that specify a dose
+	int maxCurrent = 255;		// Highest current that is safe for the light engine and the resin
+	double frameRate = 30.0;	// Exposure frames per second, see setFramerateLimit in RunFull
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Intensity held for a number of milliseconds from the start of the exposure
+struct IntensitySegment {
+	int intensity;
+	int durationMs;
+};
+
+// Piecewise-constant intensity of one exposure, e.g. a short burst followed by a lower tail. The last segment holds until the exposure
+// ends.
+using IntensityProfile = std::vector<IntensitySegment>;
+
+// Parses "intensity:ms;intensity:ms;..." such as "255:400;120:1600", false and an error message for malformed text
+bool parseIntensityProfile(const std::string& text, IntensityProfile& profile, std::string& error);
+int profileDurationMs(const IntensityProfile& profile);
+
+// Sends the SetCurrent commands of a profile on its own thread, so the render loop does not block on USB during the exposure. The
+// profile is armed in the dark phase and started with the first frame of the exposure.
+class IntensityProfilePlayer {
+public:
+	IntensityProfilePlayer();
+	~IntensityProfilePlayer();
+
+	// Queues the segments after the first one, which the caller sets before the exposure like a normal layer intensity
+	void arm(std::shared_ptr<const IntensityProfile> profile);
+	void start(std::chrono::steady_clock::time_point exposureStart);
+	// Waits for the queued commands and returns how far the latest one was behind its schedule
+	std::chrono::milliseconds finish();
+
+private:
+	void run();
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::shared_ptr<const IntensityProfile> armed;
+	bool started = false;
+	bool stopping = false;
+	std::chrono::steady_clock::time_point startTime;
+	std::chrono::milliseconds lateness{ 0 };
+};
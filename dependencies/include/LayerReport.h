@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Condition the dark phase waited for last, the time beyond the planned dark time is idle time of this cause
+enum class DarkPhaseEnd {
+	DarkTime,		// The planned dark time, no idle time
+	StageMove,
+	SliceLoad,		// Decoding or uploading the next slice
+	Slicer,			// A streaming job waited for the slicer to write the next layer
+	Cooldown,		// The thermal governor held the light engine dark
+	LastLayer,
+	Aborted,
+	Count
+};
+
+const char* darkPhaseEndName(DarkPhaseEnd reason);
+
+// Timing of one exposed layer, durations in milliseconds
+struct LayerTiming {
+	size_t sliceIndex = 0;
+	int intensity = -1;				// Current during the exposure, -1 if unknown
+	double plannedExposureMs = 0.0;
+	double actualExposureMs = 0.0;	// First frame on screen to the first dark frame
+	double plannedDarkMs = 0.0;
+	double actualDarkMs = 0.0;		// First dark frame to the next layer's first frame
+	double moveMs = 0.0;			// Stage move after the exposure, including pumping
+	double sliceReadyMs = 0.0;		// End of the exposure until the next slice was uploaded
+	double settingsMs = 0.0;		// Sending the next layer's settings, including the settle time after a current change
+	double positionMm = 0.0;		// Stage position at the end of the exposure
+	bool positionValid = false;
+	DarkPhaseEnd darkPhaseEnd = DarkPhaseEnd::DarkTime;
+};
+
+// Per-layer timing of a print, written as CSV with a summary when the print finishes or is aborted
+class LayerReport {
+public:
+	void clear() { layers.clear(); }
+	void add(const LayerTiming& layer) { layers.push_back(layer); }
+	const std::vector<LayerTiming>& entries() const { return layers; }
+
+	// Milliseconds the dark phases lasted beyond the planned dark time per cause. The settle time of a current change is not
+	// split out by cause, it is idle time of its own returned through settingsIdleMs.
+	std::vector<double> idleByCause(double& settingsIdleMs) const;
+	// Lines of p50, p95 and max per duration followed by the idle time per cause
+	std::vector<std::string> summary() const;
+
+	bool writeCsv(const std::string& filePath, std::string& error) const;
+	bool writeSummary(const std::string& filePath, std::string& error) const;
+
+private:
+	std::vector<LayerTiming> layers;
+};
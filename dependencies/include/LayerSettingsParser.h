@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PrintPlan.h"
+
+// Consecutive layers of the settings file with identical settings
+struct LayerSettingsRun {
+	LayerSettings settings;
+	int firstLayer;		// Layer number of the first row, as written in the file
+	int layerCount;
+};
+
+struct LayerSettingsError {
+	size_t line;		// 1-based, the header is line 1
+	std::string message;
+};
+
+struct LayerSettingsFile {
+	std::vector<LayerSettingsRun> runs;		// In file order, a setting that returns later starts a new run
+	std::vector<LayerSettingsError> errors;	// Rejected rows and other problems, the parse continues after each
+	std::vector<LayerSettingsError> warnings;	// Ignored columns and gaps in the numbering, the layers are unaffected
+	size_t rows = 0;						// Rows accepted
+};
+
+// Columns are found by their header name: Layer and DarkTime, plus Intensity and ExposureTime or Dose, and optionally Profile,
+// StepSize, Velocity, Acceleration and PumpingDistance. Case, spaces and a unit in brackets are ignored, "Dark Time (ms)" is DarkTime.
+// A header without these names is read as Layer,Intensity,ExposureTime,DarkTime[,Profile] by position.
+bool parseLayerSettings(std::string_view text, LayerSettingsFile& result);
+bool readLayerSettings(const std::string& filePath, LayerSettingsFile& result);
@@ -0,0 +1,99 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Commands of the SM12 light engine. Implementations are safe to call from several threads, calls are serialized internally.
+class LightEngineDriver {
+public:
+	virtual ~LightEngineDriver() {}
+
+	virtual unsigned char enumerateDevices() = 0;
+	virtual void selectDevice(unsigned char index) = 0;
+	virtual bool isOnline() = 0;
+
+	virtual bool setPower(bool on) = 0;
+	virtual bool setLed(bool on) = 0;
+	virtual bool setCurrent(unsigned char value) = 0;
+	virtual bool getCurrent(unsigned char& value) = 0;
+	virtual bool getLedDefaultStatus(bool& on) = 0;
+	virtual bool setLedDefaultStatus(bool on) = 0;
+
+	virtual unsigned char getStatus() = 0;
+	virtual unsigned char getSysStatus() = 0;	// 1 ready, 4 warming up
+	virtual bool getTemperature(int16_t& celsius) = 0;
+};
+
+#ifdef _WIN32
+// LibUSB3DPrinter DLL, the real hardware
+class UsbLightEngineDriver : public LightEngineDriver {
+public:
+	unsigned char enumerateDevices() override;
+	void selectDevice(unsigned char index) override;
+	bool isOnline() override;
+
+	bool setPower(bool on) override;
+	bool setLed(bool on) override;
+	bool setCurrent(unsigned char value) override;
+	bool getCurrent(unsigned char& value) override;
+	bool getLedDefaultStatus(bool& on) override;
+	bool setLedDefaultStatus(bool on) override;
+
+	unsigned char getStatus() override;
+	unsigned char getSysStatus() override;
+	bool getTemperature(int16_t& celsius) override;
+
+private:
+	std::mutex mutex;
+};
+#endif
+
+struct SimulatedLightEngineSettings {
+	double warmUpSeconds = 20.0;			// Time from power on until the system status reports ready
+	int commandLatencyMs = 4;				// Round trip of one USB command
+	double ambientTemperature = 25.0;		// Celsius
+	double heatingPerCurrent = 0.15;		// Steady-state rise in Celsius per current step while the LED is lit
+	double thermalTimeConstantSeconds = 90.0;
+};
+
+// Light engine model for development and benchmarks without the hardware
+class SimulatedLightEngineDriver : public LightEngineDriver {
+public:
+	explicit SimulatedLightEngineDriver(const SimulatedLightEngineSettings& settings = SimulatedLightEngineSettings());
+
+	unsigned char enumerateDevices() override;
+	void selectDevice(unsigned char index) override;
+	bool isOnline() override;
+
+	bool setPower(bool on) override;
+	bool setLed(bool on) override;
+	bool setCurrent(unsigned char value) override;
+	bool getCurrent(unsigned char& value) override;
+	bool getLedDefaultStatus(bool& on) override;
+	bool setLedDefaultStatus(bool on) override;
+
+	unsigned char getStatus() override;
+	unsigned char getSysStatus() override;
+	bool getTemperature(int16_t& celsius) override;
+
+private:
+	// Waits for the command latency and advances the thermal model, returns with the lock held
+	std::unique_lock<std::mutex> command();
+	bool isReady() const;
+
+	SimulatedLightEngineSettings settings;
+	std::mutex mutex;
+	bool powered = false;
+	bool ledOn = true;
+	bool ledDefault = true;
+	unsigned char current = 0;
+	double temperature;
+	std::chrono::steady_clock::time_point powerOnTime;
+	std::chrono::steady_clock::time_point lastUpdate;
+};
+
+// Driver used by all light engine commands. The DLL on Windows unless LIGHT_ENGINE_SIMULATED is set, the simulation elsewhere.
+LightEngineDriver& lightEngine();
+// Replaces the driver, only before the light engine is first used
+void setLightEngineDriver(std::unique_ptr<LightEngineDriver> driver);
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+struct LightEngineStatus {
+	unsigned char status;
+	unsigned char current;
+	unsigned char sysStatus;
+	bool ledDefaultStatus;
+	int16_t temperature;
+};
+
+struct LightEngineSample {
+	std::chrono::system_clock::time_point timestamp;
+	LightEngineStatus status;
+};
+
+enum class LightEngineAlarmType {
+	OverTemperature,
+	TemperatureRecovered,
+	StatusChanged
+};
+
+struct LightEngineAlarm {
+	LightEngineAlarmType type;
+	LightEngineSample sample;
+	std::string message;
+};
+
+struct LightEngineMonitorSettings {
+	int pollIntervalMs = 1000;
+	size_t historySize = 3600;			// Samples kept in the ring buffer
+	int16_t maxTemperature = 60;		// Celsius, OverTemperature above this value
+	int16_t temperatureHysteresis = 3;	// TemperatureRecovered once below maxTemperature - hysteresis
+};
+
+// Polls the light engine on its own thread. The latest sample can be read from any thread without locking, the history is a
+// timestamped ring buffer.
+class LightEngineMonitor {
+public:
+	using Query = std::function<LightEngineStatus()>;
+	using AlarmCallback = std::function<void(const LightEngineAlarm&)>;
+
+	~LightEngineMonitor();
+
+	void start(Query query, const LightEngineMonitorSettings& settings, AlarmCallback onAlarm = nullptr);
+	void stop();
+	bool isRunning() const { return running; }
+
+	// False until the first sample has been taken
+	bool latest(LightEngineSample& sample) const;
+	std::vector<LightEngineSample> history() const;
+
+private:
+	void pollLoop();
+	void publish(const LightEngineSample& sample);
+	void checkAlarms(const LightEngineSample& sample);
+
+	Query query;
+	AlarmCallback onAlarm;
+	LightEngineMonitorSettings settings;
+
+	// Latest sample behind a sequence lock, odd while the monitor thread is writing
+	std::atomic<uint32_t> sequence{ 0 };
+	std::atomic<uint64_t> latestStatus{ 0 };
+	std::atomic<int64_t> latestTimestamp{ 0 };
+
+	mutable std::mutex historyMutex;
+	std::vector<LightEngineSample> ring;
+	size_t ringNext = 0;
+	size_t ringCount = 0;
+
+	bool hasPrevious = false;
+	bool overTemperature = false;
+	LightEngineStatus previous{};
+
+	std::atomic<bool> running{ false };
+	std::mutex stopMutex;
+	std::condition_variable stopSignal;
+	std::thread thread;
+};
+
+// Monitor shared by the GUI and the print loop
+LightEngineMonitor& lightEngineMonitor();
@@ -0,0 +1,112 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "LightEngineDriver.h"
+
+enum class LightEngineCommand {
+	EnumerateDevices,
+	SelectDevice,
+	IsOnline,
+	SetPower,
+	SetLed,
+	SetCurrent,
+	GetCurrent,
+	GetLedDefaultStatus,
+	SetLedDefaultStatus,
+	GetStatus,
+	GetSysStatus,
+	GetTemperature,
+	Count
+};
+
+// What the printer was doing when a command was sent
+enum class LightEnginePhase {
+	Idle,
+	WarmUp,
+	Exposure,
+	Dark,
+	Count
+};
+
+const char* lightEngineCommandName(LightEngineCommand command);
+const char* lightEnginePhaseName(LightEnginePhase phase);
+
+// Latency histograms of the light engine commands per command and phase. Recording is lock-free, so the print loop, the monitor
+// thread and the GUI can all be traced at once. The phase belongs to the calling thread: the print loop, the profile player and the
+// warm-up set theirs, the commands of the monitor and the GUI queries are recorded as Idle even while a print runs.
+class LightEngineTrace {
+public:
+	static constexpr int bucketCount = 24;	// Bucket b counts calls below 2^b microseconds, the last one everything slower
+
+	void setEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+	void setPhase(LightEnginePhase phase) { threadPhase = phase; }
+	LightEnginePhase currentPhase() const { return threadPhase; }
+
+	void record(LightEngineCommand command, LightEnginePhase phase, int64_t microseconds, bool ok);
+	void reset();
+
+	// One line per command and phase that was called: count, errors, mean, p50, p95 and max latency
+	std::string summary() const;
+	bool exportCsv(const std::string& filePath) const;
+
+private:
+	struct Stats {
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> errors{ 0 };
+		std::atomic<uint64_t> totalMicroseconds{ 0 };
+		std::atomic<int64_t> maxMicroseconds{ 0 };
+		std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+	};
+
+	// Upper bound in microseconds of the bucket holding the given fraction of the calls
+	static int64_t percentile(const Stats& stats, double fraction);
+
+	std::atomic<bool> enabled{ false };
+	static inline thread_local LightEnginePhase threadPhase = LightEnginePhase::Idle;
+	std::array<std::array<Stats, static_cast<size_t>(LightEnginePhase::Count)>, static_cast<size_t>(LightEngineCommand::Count)> stats;
+};
+
+LightEngineTrace& lightEngineTrace();
+
+// Attributes the light engine commands sent within a scope to a phase
+class LightEnginePhaseScope {
+public:
+	explicit LightEnginePhaseScope(LightEnginePhase phase) : previous(lightEngineTrace().currentPhase()) {
+		lightEngineTrace().setPhase(phase);
+	}
+	~LightEnginePhaseScope() { lightEngineTrace().setPhase(previous); }
+
+private:
+	LightEnginePhase previous;
+};
+
+// Times every command of the wrapped driver into lightEngineTrace() while tracing is enabled
+class TracingLightEngineDriver : public LightEngineDriver {
+public:
+	explicit TracingLightEngineDriver(std::unique_ptr<LightEngineDriver> driver);
+
+	unsigned char enumerateDevices() override;
+	void selectDevice(unsigned char index) override;
+	bool isOnline() override;
+
+	bool setPower(bool on) override;
+	bool setLed(bool on) override;
+	bool setCurrent(unsigned char value) override;
+	bool getCurrent(unsigned char& value) override;
+	bool getLedDefaultStatus(bool& on) override;
+	bool setLedDefaultStatus(bool on) override;
+
+	unsigned char getStatus() override;
+	unsigned char getSysStatus() override;
+	bool getTemperature(int16_t& celsius) override;
+
+private:
+	template <typename Call>
+	auto traced(LightEngineCommand command, Call call);
+
+	std::unique_ptr<LightEngineDriver> driver;
+};
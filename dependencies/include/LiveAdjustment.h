@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+#include "PrintPlan.h"
+
+// Change of the layer settings requested during a print. It applies from the layer with slice index fromLayer on and stays in
+// effect until a later adjustment changes the same value; unset values are left as they are.
+struct ParameterAdjustment {
+	uint32_t id = 0;				// Assigned by ParameterChannel::submit, identifies the change in the log and the journal
+	uint32_t printId = 0;			// Print the change was submitted to, assigned by ParameterChannel::submit
+	size_t fromLayer = 0;			// Slice index of the first layer the change applies to
+	size_t requestedAtLayer = 0;	// Layer being printed when the change was submitted
+	std::optional<int> exposureFrames;
+	std::optional<int> darkTimeMs;
+	std::optional<float> stepSize;	// mm per layer, the direction of the planned move is kept
+	std::optional<int> intensity;
+	bool reset = false;				// Return to the planned values, applied before the values above
+};
+
+// Lock-free single-producer, single-consumer queue from the GUI thread to the print loop. The print loop also publishes the
+// layer it is exposing so the GUI can offer the next one as the default.
+// Each print started with setPrinting(true) gets a new id. A submit that races the end of a print stamps the id of that print,
+// receive drops it, so the next print never applies it from its own layers.
+class ParameterChannel {
+public:
+	static constexpr size_t capacity = 64;
+
+	// GUI thread. Assigns the id, false if no print is running or the queue is full
+	bool submit(ParameterAdjustment& adjustment);
+	// Print thread, false once the queue is empty. Adjustments submitted to an earlier print are skipped.
+	bool receive(ParameterAdjustment& adjustment);
+
+	void setPrinting(bool printing) {
+		if (printing) {
+			printId.fetch_add(1, std::memory_order_release);
+		}
+		this->printing.store(printing, std::memory_order_release);
+	}
+	bool isPrinting() const { return printing.load(std::memory_order_acquire); }
+	void publishLayer(size_t sliceIndex) { layer.store(sliceIndex, std::memory_order_relaxed); }
+	size_t currentLayer() const { return layer.load(std::memory_order_relaxed); }
+	size_t depth() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+private:
+	std::array<ParameterAdjustment, capacity> slots;
+	std::atomic<size_t> head{ 0 };	// Next slot to write, only advanced by the GUI thread
+	std::atomic<size_t> tail{ 0 };	// Next slot to read, only advanced by the print thread
+	std::atomic<uint32_t> nextId{ 1 };
+	std::atomic<uint32_t> printId{ 0 };	// Of the running or last print, only advanced by the print thread
+	std::atomic<bool> printing{ false };
+	std::atomic<size_t> layer{ 0 };
+};
+
+ParameterChannel& parameterChannel();
+
+// Appends every received, applied or unused adjustment to a CSV file, so a recovered print can be reproduced
+class ParameterJournal {
+public:
+	explicit ParameterJournal(const std::string& filePath);
+	void record(const char* event, const ParameterAdjustment& adjustment, size_t layer);
+
+private:
+	std::ofstream file;
+};
+
+// Print thread side of the channel: keeps the received adjustments until their layer and applies the active values to each layer
+class LayerOverrides {
+public:
+	void add(const ParameterAdjustment& adjustment);
+	// Applies the adjustments due at this layer and the values still in effect. Adjustments taking effect here are appended to
+	// activated.
+	void apply(PlannedLayer& layer, std::vector<ParameterAdjustment>& activated);
+	// Adjustments whose layer was never reached
+	const std::vector<ParameterAdjustment>& pending() const { return waiting; }
+
+private:
+	std::vector<ParameterAdjustment> waiting;	// Ordered by fromLayer, then by id
+	ParameterAdjustment active;					// Values in effect
+};
+
+std::string describeAdjustment(const ParameterAdjustment& adjustment);
@@ -0,0 +1,52 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+enum class LogSeverity {
+	Info,
+	Warning,
+	Error
+};
+
+enum class LogSubsystem {
+	General,
+	Print,
+	Stage,
+	LightEngine,
+	Slices,
+	Count
+};
+
+// Log output of the print functions. The caller states severity and subsystem with the message, a plain message is General info.
+// Sinks that only take the text, such as a console printer, can be assigned directly and drop the classification.
+class LogCallback {
+public:
+	using Sink = std::function<void(const std::string&, LogSeverity, LogSubsystem)>;
+
+	LogCallback() = default;
+	LogCallback(std::nullptr_t) {}
+	template <typename Function, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Function>, LogCallback> &&
+		(std::is_invocable_v<Function&, const std::string&, LogSeverity, LogSubsystem> ||
+		std::is_invocable_v<Function&, const std::string&>)>>
+	LogCallback(Function function) {
+		if constexpr (std::is_invocable_v<Function&, const std::string&, LogSeverity, LogSubsystem>) {
+			sink = std::move(function);
+		}
+		else {
+			sink = [function](const std::string& message, LogSeverity, LogSubsystem) mutable { function(message); };
+		}
+	}
+
+	void operator()(const std::string& message, LogSeverity severity = LogSeverity::Info,
+		LogSubsystem subsystem = LogSubsystem::General) const {
+		if (sink) {
+			sink(message, severity, subsystem);
+		}
+	}
+	explicit operator bool() const { return static_cast<bool>(sink); }
+
+private:
+	Sink sink;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "SliceSource.h"
+#include "SliceRasterizer.h"
+
+struct MeshTriangle {
+	float v[3][3];	// Three vertices, x y z in mm
+};
+
+bool loadStl(const std::string& filePath, std::vector<MeshTriangle>& triangles, std::string& error);
+
+// Slices a triangle mesh in memory, each layer is rasterized on demand at projector resolution
+class MeshSliceSource : public SliceSource {
+public:
+	MeshSliceSource(const std::vector<MeshTriangle>& triangles, const SliceSourceSettings& settings, const std::string& name);
+
+	static std::shared_ptr<MeshSliceSource> open(const std::string& filePath, const SliceSourceSettings& settings, std::string& error);
+
+	size_t layerCount() const override { return layerTriangles.size(); }
+	std::string layerName(size_t index) const override;
+	bool loadLayer(size_t index, sf::Image& image) const override;
+	SliceInfo inspectLayer(size_t index) const override;
+
+	// Contour edges of a layer in pixel coordinates
+	void sliceLayer(size_t index, std::vector<EdgeSegment>& edges) const;
+
+private:
+	std::vector<MeshTriangle> triangles;
+	std::vector<std::vector<uint32_t>> layerTriangles;	// Triangles crossing the sampling plane of each layer
+	SliceSourceSettings settings;
+	std::string name;
+	float minZ = 0.0f;
+	float centerX = 0.0f;
+	float centerY = 0.0f;
+};
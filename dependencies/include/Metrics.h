@@ -0,0 +1,134 @@
+#pragma once
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Value that only increases, such as the number of exposed layers
+class MetricCounter {
+public:
+	void add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+	uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value{ 0 };
+};
+
+// Value that is replaced, such as a temperature
+class MetricGauge {
+public:
+	void set(double value) { this->value.store(value, std::memory_order_relaxed); }
+	double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> value{ 0.0 };
+};
+
+// Distribution over fixed buckets, observing is a few relaxed atomic increments
+class MetricHistogram {
+public:
+	explicit MetricHistogram(std::vector<double> upperBounds);
+
+	void observe(double value);
+
+	const std::vector<double>& upperBounds() const { return bounds; }
+	uint64_t bucket(size_t index) const { return buckets[index].load(std::memory_order_relaxed); }	// Not cumulative, index bounds.size() is +Inf
+	uint64_t count() const { return total.load(std::memory_order_relaxed); }
+	double sum() const { return valueSum.load(std::memory_order_relaxed); }
+
+private:
+	std::vector<double> bounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+	std::atomic<uint64_t> total{ 0 };
+	std::atomic<double> valueSum{ 0.0 };
+};
+
+// Named metrics of the process in the Prometheus text format. Registering takes a lock and returns a metric that lives as long
+// as the registry, updating it never does.
+class MetricsRegistry {
+public:
+	// Registering an existing name returns the metric registered first
+	MetricCounter& counter(const std::string& name, const std::string& help);
+	MetricGauge& gauge(const std::string& name, const std::string& help);
+	MetricHistogram& histogram(const std::string& name, const std::string& help, std::vector<double> upperBounds);
+
+	// Called before every exposition, for gauges that are sampled rather than updated
+	void addCollector(std::function<void()> collect);
+
+	std::string exposition() const;
+	bool writeFile(const std::string& filePath, std::string& error) const;
+
+private:
+	enum class Type {
+		Counter,
+		Gauge,
+		Histogram
+	};
+	struct Family {
+		std::string name;
+		std::string help;
+		Type type;
+		std::unique_ptr<MetricCounter> counter;
+		std::unique_ptr<MetricGauge> gauge;
+		std::unique_ptr<MetricHistogram> histogram;
+	};
+
+	Family* find(const std::string& name, Type type);
+
+	mutable std::mutex mutex;
+	std::vector<std::unique_ptr<Family>> families;
+	std::vector<std::function<void()>> collectors;
+};
+
+MetricsRegistry& metricsRegistry();
+
+// Metrics of the print loop, registered on first use
+struct PrinterMetrics {
+	MetricHistogram& layerCycle;		// Start of one exposure to the start of the next
+	MetricHistogram& lightPhaseError;	// Measured minus planned exposure
+	MetricHistogram& darkPhaseError;	// Measured minus planned dark time
+	MetricHistogram& moveDuration;		// Stage move between two layers, including pumping
+	MetricHistogram& serialRoundTrip;	// Position query to the stage controller
+	MetricHistogram& sliceDecode;		// Loading and uploading the next slice
+	MetricCounter& layersExposed;
+	MetricCounter& printsStarted;
+	MetricCounter& printsAborted;
+	MetricGauge& currentLayer;
+	MetricGauge& layerCount;
+	MetricGauge& engineTemperature;		// Latest light engine monitor sample
+	MetricGauge& eventQueueDepth;		// Events waiting for the event log writer
+	MetricGauge& eventsDropped;
+	MetricGauge& adjustmentQueueDepth;	// Operator adjustments not yet received by the print loop
+
+	explicit PrinterMetrics(MetricsRegistry& registry);
+};
+
+PrinterMetrics& printerMetrics();
+
+// Serves the registry on http://127.0.0.1:port/metrics from its own thread, only to the local machine
+class MetricsServer {
+public:
+	static constexpr unsigned short defaultPort = 9464;
+
+	~MetricsServer();
+
+	bool start(unsigned short port, std::string& error);
+	void stop();
+	bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+private:
+	void serveLoop();
+	void respond(sf::TcpSocket& client);
+
+	sf::TcpListener listener;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+};
+
+MetricsServer& metricsServer();
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "PrintPlan.h"
+#include "SliceSource.h"
+
+// Compiled print plan: a versioned binary file holding one fixed-size record per planned layer, the slice file names and the
+// intensity profiles. It is written once by writePlanFile and mapped into memory by PlanFile, reading it needs no parsing.
+
+constexpr uint32_t planFileVersion = 2;
+constexpr char planFileExtension[] = ".clipplan";
+
+enum PlanFileFlags : uint32_t {
+	PlanFileEmptyLayersFolded = 1u << 0,	// Empty slices are already folded into the moves
+	PlanFileAdaptiveExposure = 1u << 1		// Exposures already include the adaptive overhang adjustment
+};
+
+// All offsets are in bytes from the start of the file and multiples of 8
+struct PlanFileHeader {
+	char magic[8];				// "CLIPPLAN"
+	uint32_t version;			// planFileVersion
+	uint32_t headerSize;		// sizeof(PlanFileHeader)
+	uint32_t recordSize;		// sizeof(PlanFileRecord)
+	uint32_t flags;				// PlanFileFlags
+	uint64_t fileSize;
+	uint64_t layerCount;
+	uint64_t recordsOffset;
+	uint64_t sliceCount;
+	uint64_t slicesOffset;
+	uint64_t segmentCount;
+	uint64_t segmentsOffset;
+	uint64_t namesOffset;		// Slice file names, UTF-8 without terminators
+	uint64_t namesSize;
+	uint64_t emptyLayers;		// Slices removed by foldEmptyLayers
+	float leadingMove;			// Travel before the first exposure
+	float frameRate;			// Display rate the timing below was computed for
+	int64_t durationMs;			// Estimated exposure and dark time of the whole plan, without stage moves and dose layers
+};
+
+struct PlanFileRecord {
+	uint32_t sliceIndex;		// Index into the slice table
+	int32_t exposureFrames;
+	int32_t darkTimeMs;
+	int32_t intensity;			// -1 keeps the current value
+	float moveDistance;
+	int32_t foldedEmptyLayers;
+	double doseMJ;
+	float velocity;				// NaN when the layer uses the job's motion
+	float acceleration;
+	float pumpingDistance;
+	uint32_t profileFirst;		// Index into the segment table
+	uint32_t profileCount;		// 0 for a constant intensity
+	int32_t exposureMs;			// Exposure at frameRate, at least the profile duration
+	int64_t startMs;			// Estimated start of the exposure from the start of the print
+};
+
+struct PlanFileSlice {
+	uint64_t nameOffset;		// Relative to namesOffset
+	uint32_t nameLength;
+	uint32_t reserved;
+	uint64_t fileSize;			// Of the slice file when the plan was compiled
+	int64_t modifiedTime;		// Last write time of the slice file when the plan was compiled, ns since the file clock's epoch
+};
+
+struct PlanFileSegment {
+	int32_t intensity;
+	int32_t durationMs;
+};
+
+static_assert(sizeof(PlanFileHeader) == 120, "PlanFileHeader layout is part of the file format");
+static_assert(sizeof(PlanFileRecord) == 64, "PlanFileRecord layout is part of the file format");
+static_assert(sizeof(PlanFileSlice) == 32, "PlanFileSlice layout is part of the file format");
+static_assert(sizeof(PlanFileSegment) == 8, "PlanFileSegment layout is part of the file format");
+
+// Writes the plan and the names of all slices of its source, false and an error message if the file could not be written
+bool writePlanFile(const std::string& filePath, const PrintPlan& plan, uint32_t flags, float frameRate, std::string& error);
+
+// Read-only memory mapping of a compiled plan. open checks the header and that every table lies within the file, the records are
+// then used in place.
+class PlanFile {
+public:
+	static std::shared_ptr<PlanFile> open(const std::string& filePath, std::string& error);
+	~PlanFile();
+
+	PlanFile(const PlanFile&) = delete;
+	PlanFile& operator=(const PlanFile&) = delete;
+
+	const PlanFileHeader& header() const { return *reinterpret_cast<const PlanFileHeader*>(data); }
+	size_t layerCount() const { return static_cast<size_t>(header().layerCount); }
+	const PlanFileRecord& record(size_t index) const { return records[index]; }
+	size_t sliceCount() const { return static_cast<size_t>(header().sliceCount); }
+	// Empty for a slice whose name lies outside the name table
+	std::string_view sliceName(size_t index) const;
+	// False and the reason if the slice file is gone or its size or write time differ from when the plan was compiled
+	bool sliceUnchanged(size_t index, std::string& error) const;
+	// Empty for a constant intensity or a segment range outside the table
+	IntensityProfile profile(const PlanFileRecord& record) const;
+
+private:
+	PlanFile() = default;
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	const PlanFileRecord* records = nullptr;
+	const PlanFileSlice* slices = nullptr;
+	const PlanFileSegment* segments = nullptr;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+// Slice images named in a compiled plan. A slice that changed since compiling is not loaded, its layer settings were derived from
+// the old image.
+class PlanFileSliceSource : public SliceSource {
+public:
+	explicit PlanFileSliceSource(std::shared_ptr<const PlanFile> file) : file(file) {}
+
+	size_t layerCount() const override { return file->sliceCount(); }
+	std::string layerName(size_t index) const override { return std::string(file->sliceName(index)); }
+	bool loadLayer(size_t index, sf::Image& image) const override;
+
+private:
+	std::shared_ptr<const PlanFile> file;
+};
+
+// Print plan of a compiled file, the layers reference the file's slices. False if a record references a slice or profile the file
+// does not contain, or if a slice changed after compiling.
+bool buildPlanFromFile(std::shared_ptr<const PlanFile> file, PrintPlan& plan, std::string& error);
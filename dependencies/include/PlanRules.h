@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PrintPlan.h"
+#include "SliceAnalysis.h"
+
+// Layer settings written as rules instead of one CSV row per layer, one rule per line:
+//
+//     exposure = 12, dark = 800, intensity = 180
+//     when layer < 10: exposure = 40 - 2.5 * layer
+//     when area > 400 && layer >= 10: dark = 800 + area, intensity = ramp(height, 5, 20, 180, 220)
+//
+// A rule without a condition applies to every layer. Later rules override the settings they assign for the layers they match.
+// Settings: exposure (frames), dark (ms), intensity, dose (mJ/cm²), step (mm), velocity, acceleration, pumping
+// Variables: layer (slice index), layers (slice count), progress (0 to 1), height (mm below the layer), area (lit mm²),
+//            newarea (unsupported new mm²), islands, newislands
+// Functions: min, max, abs, floor, round, sqrt, clamp(x, lo, hi), ramp(x, x0, x1, y0, y1)
+// Operators: + - * / < <= > >= == != && || ! and parentheses, # starts a comment
+
+constexpr char ruleFileExtension[] = ".rules";
+
+enum class RuleSetting {
+	Exposure,
+	Dark,
+	Intensity,
+	Dose,
+	Step,
+	Velocity,
+	Acceleration,
+	Pumping,
+	Count
+};
+
+enum class RuleVariable {
+	Layer,
+	Layers,
+	Progress,
+	Height,
+	Area,
+	NewArea,
+	Islands,
+	NewIslands,
+	Count
+};
+
+struct RuleError {
+	size_t line;
+	std::string message;
+};
+
+// Per-slice inputs of the rules, the analytics are only filled when a rule uses them
+struct RuleInputs {
+	std::vector<SliceInfo> slices;		// For area
+	std::vector<SliceDiff> diffs;		// For newarea, islands and newislands
+	float pixelSize = 0.05f;			// mm per pixel in the build plane
+};
+
+// Rules compiled into postfix programs over a small value stack, evaluated without any allocation per layer
+class PlanRules {
+public:
+	static std::shared_ptr<PlanRules> compile(const std::string& text, std::vector<RuleError>& errors);
+	static std::shared_ptr<PlanRules> load(const std::string& filePath, std::vector<RuleError>& errors);
+
+	bool uses(RuleVariable variable) const { return (usedVariables >> static_cast<int>(variable)) & 1; }
+	bool assigns(RuleSetting setting) const;
+	size_t ruleCount() const { return rules.size(); }
+
+	// Plans every slice of the source, the layers are evaluated on all hardware threads. False and an error naming the first
+	// layer with an invalid result, such as a non-positive exposure.
+	bool buildPlan(std::shared_ptr<SliceSource> source, float stepSize, const RuleInputs& inputs, PrintPlan& plan,
+		std::string& error) const;
+
+private:
+	enum class Op : uint8_t {
+		Constant, Variable, Add, Subtract, Multiply, Divide, Negate, Not,
+		Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or,
+		Min, Max, Abs, Floor, Round, Sqrt, Clamp, Ramp
+	};
+	struct Instruction {
+		Op op;
+		RuleVariable variable;
+		double value;
+	};
+	using Program = std::vector<Instruction>;
+
+	struct Assignment {
+		RuleSetting setting;
+		Program program;
+	};
+	struct Rule {
+		Program condition;		// Empty for an unconditional rule
+		std::vector<Assignment> assignments;
+	};
+
+	static constexpr size_t maxStackDepth = 32;
+	using Variables = double[static_cast<size_t>(RuleVariable::Count)];
+
+	static double run(const Program& program, const Variables& variables);
+	// Settings of one layer, NaN for settings no matching rule assigns
+	void evaluate(const Variables& variables, double (&settings)[static_cast<size_t>(RuleSetting::Count)], bool stepOnly) const;
+
+	std::vector<Rule> rules;
+	uint32_t usedVariables = 0;
+
+	friend class RuleParser;
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <memory>
+#include <functional>
+#include <optional>
+#include "SliceSource.h"
+#include "IntensityCalibration.h"
+#include "ThermalGovernor.h"
+#include "IntensityProfile.h"
+
+// Stage motion of a layer, unset values fall back to the job's settings
+struct LayerMotion {
+	std::optional<float> velocity;			// mm/s of the peel and return moves
+	std::optional<float> acceleration;		// mm/s²
+	std::optional<float> pumpingDistance;	// DLP pumping travel in mm, unused for CLIP
+
+	bool operator==(const LayerMotion& other) const = default;
+	auto operator<=>(const LayerMotion& other) const = default;
+};
+
+struct LayerSettings {
+	int intensity;
+	int exposureTime;
+	int darkTime;
+	double dose;	// mJ/cm², when set intensity and exposureTime are chosen from the intensity calibration
+	std::string profile;	// Intensity profile of the exposure, see parseIntensityProfile, empty for a constant intensity
+	std::optional<float> stepSize;	// Layer thickness in mm, unset uses the job's step size
+	LayerMotion motion;
+
+	LayerSettings(int i, int e, int d, double dose = 0.0, const std::string& profile = "");
+
+
+	bool operator<(const LayerSettings& other) const {
+		return std::tie(intensity, exposureTime, darkTime, dose, profile, stepSize, motion) <
+			std::tie(other.intensity, other.exposureTime, other.darkTime, other.dose, other.profile, other.stepSize, other.motion);
+	};
+
+	bool operator==(const LayerSettings& other) const {
+		return intensity == other.intensity && exposureTime == other.exposureTime && darkTime == other.darkTime && dose == other.dose &&
+			profile == other.profile && stepSize == other.stepSize && motion == other.motion;
+	};
+};
+
+// One exposure of the print, in the order it is executed
+struct PlannedLayer {
+	size_t sliceIndex;		// Layer index in PrintPlan::source
+	int exposureFrames;		// Number of frames the slice stays on screen
+	int darkTimeMs;			// Minimum dark time after the exposure
+	int intensity;			// SetCurrent value for this layer, -1 keeps the current value
+	float moveDistance;		// Stage travel after the exposure, including folded empty slices
+	int foldedEmptyLayers;	// Number of empty slices merged into moveDistance
+	double doseMJ = 0.0;	// mJ/cm², when set RunPlan picks intensity and exposureFrames from PrintPlan::dose before the exposure
+	std::shared_ptr<const IntensityProfile> profile;	// Intensity over the exposure, overrides intensity and doseMJ
+	LayerMotion motion;		// Stage motion of the move after the exposure, unset values use PrintPlan::motion
+};
+
+// Stage motion of the job, used by the layers that do not set their own
+struct MotionSettings {
+	float velocity = 0.0f;		// mm/s, 0 keeps the velocity the controller had when the print started
+	float acceleration = 0.0f;	// mm/s², 0 keeps the controller's acceleration
+};
+
+// Settings of the layer printing a slice index, false once the job has no layer for that slice
+using LayerSettingsFunction = std::function<bool(size_t sliceIndex, PlannedLayer& layer)>;
+
+struct PrintPlan {
+	std::string name;			// Job name, the files the print writes are named after it
+	std::shared_ptr<SliceSource> source;
+	std::vector<PlannedLayer> layers;
+	float leadingMove = 0.0f;	// Travel before the first exposure when the job starts with empty slices
+	size_t emptyLayers = 0;		// Total number of slices removed by foldEmptyLayers
+	DoseSettings dose;			// Calibration for layers with a dose
+	ThermalGovernorSettings thermal;
+	MotionSettings motion;
+
+	// Set for sources that are still being written: appends the layers that became available, false once no more will follow
+	std::function<bool(PrintPlan&)> extend;
+};
+
+// The ingest stages started from the calling thread use at most this many threads, 0 uses every hardware thread. With 1 they run
+// on the calling thread itself.
+void setIngestThreadLimit(unsigned int threads);
+unsigned int ingestThreadCount(size_t tasks);
+
+std::vector<SliceInfo> ingestSlices(const SliceSource& source);
+
+LayerSettingsFunction staticLayerSettings(int maxImageDisplayCount, int mindarktime, float stepSize, int initialExposureCounter,
+	int initialLayers);
+LayerSettingsFunction dynamicLayerSettings(float stepSize, const std::vector<std::pair<LayerSettings, int>>& orderedSettings);
+
+PrintPlan buildPlan(std::shared_ptr<SliceSource> source, const LayerSettingsFunction& layerSettings);
+PrintPlan buildStreamingPlan(std::shared_ptr<SliceSource> source, size_t lead, LayerSettingsFunction layerSettings);
+PrintPlan buildStaticPlan(std::shared_ptr<SliceSource> source, int maxImageDisplayCount, int mindarktime, float stepSize,
+	int initialExposureCounter, int initialLayers);
+PrintPlan buildDynamicPlan(std::shared_ptr<SliceSource> source, float stepSize,
+	const std::vector<std::pair<LayerSettings, int>>& orderedSettings);
+
+void foldEmptyLayers(PrintPlan& plan, const std::vector<SliceInfo>& slices);
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline of the print as Chrome trace-event JSON, opened in ui.perfetto.dev or chrome://tracing. Every thread records into its
+// own buffer, so the print loop, the stage thread, the slice loaders and the serial I/O show up as parallel tracks.
+struct TraceZoneRecord {
+	const char* name;		// String literals, only the pointers are stored
+	const char* category;
+	const char* detail;		// Optional literal shown as an argument, such as the serial command
+	int64_t startUs;		// Since PrintTrace::restart
+	int64_t durationUs;
+	int64_t layer;			// Slice index, -1 for zones that belong to no layer
+};
+
+class PrintTrace {
+public:
+	static constexpr size_t chunkSize = 4096;
+	static constexpr size_t maxChunks = 256;	// Zones per thread and trace: chunkSize * maxChunks, later ones are dropped
+
+	void setEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	// Discards the recorded zones and starts the time at 0, each thread clears its buffer with its next zone
+	void restart();
+	int64_t now() const;
+	void record(const TraceZoneRecord& zone);
+	// Names the calling thread's track. Threads of the same name share a track, so the stage moves of a print, each started on
+	// a new thread, line up on one. Call before the thread's first zone.
+	void nameThread(const char* name);
+	uint64_t droppedZones() const { return dropped.load(std::memory_order_relaxed); }
+
+	bool exportChromeTrace(const std::string& filePath, std::string& error) const;
+
+private:
+	struct ThreadBuffer {
+		uint32_t trackId = 0;
+		const char* name = nullptr;
+		bool owned = true;										// Guarded by PrintTrace::mutex
+		std::atomic<uint32_t> generation{ 0 };					// Trace the zones belong to, only changed by the owner
+		std::atomic<size_t> count{ 0 };							// Zones readable by the export
+		std::array<std::atomic<TraceZoneRecord*>, maxChunks> chunks{};
+		~ThreadBuffer();
+	};
+	struct ThreadHandle {
+		std::shared_ptr<ThreadBuffer> buffer;
+		~ThreadHandle();
+	};
+
+	ThreadBuffer& threadBuffer(const char* name);
+	static ThreadHandle& threadHandle();
+
+	std::atomic<bool> enabled{ false };
+	std::atomic<uint32_t> generation{ 1 };
+	std::atomic<int64_t> epochUs{ 0 };		// Steady clock time of the last restart
+	std::atomic<uint64_t> dropped{ 0 };
+
+	mutable std::mutex mutex;				// Guards the buffer list and the owned flags
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	uint32_t nextTrackId = 1;
+};
+
+PrintTrace& printTrace();
+
+// Records the time between its construction and destruction. With tracing disabled it only reads one flag.
+class TraceZone {
+public:
+	TraceZone(const char* name, const char* category, int64_t layer = -1, const char* detail = nullptr)
+		: active(printTrace().isEnabled()) {
+		if (active) {
+			zone = TraceZoneRecord{ name, category, detail, printTrace().now(), 0, layer };
+		}
+	}
+	~TraceZone() {
+		if (active) {
+			zone.durationUs = printTrace().now() - zone.startUs;
+			printTrace().record(zone);
+		}
+	}
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	bool active;
+	TraceZoneRecord zone;
+};
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "serial.h"
+#include "PrintTrace.h"
 
 class SMC100C {
  public:
@@ -141,6 +142,7 @@ class SMC100C {
 
 
   char* SerialRead() {
+      TraceZone zone("Serial read", "serial");
       static char receivedString[64]; // Adjust size as needed
       char finalChar = '\n';
       unsigned int maxNbBytes = sizeof(receivedString) - 1; // Buffer size minus space for null terminator
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "SliceSource.h"
+#include "PrintPlan.h"
+
+// Lit cells of a slice on a coarse grid, one bit per cell, rows padded to whole words
+struct SliceMask {
+	unsigned int width = 0;
+	unsigned int height = 0;
+	size_t wordsPerRow = 0;
+	std::vector<uint64_t> bits;
+
+	bool test(unsigned int x, unsigned int y) const { return (bits[y * wordsPerRow + x / 64] >> (x % 64)) & 1; }
+};
+
+// Difference of a slice to the slice below it
+struct SliceDiff {
+	size_t newCells = 0;		// Mask cells lit in this slice but not in the previous one
+	float newAreaMm2 = 0.0f;	// newCells in the build plane
+	size_t islands = 0;			// Connected lit regions of the slice
+	size_t newIslands = 0;		// Regions that do not overlap the previous slice at all
+};
+
+struct AdaptiveExposureSettings {
+	bool enabled = false;
+	unsigned int downsample = 4;			// Projector pixels per mask cell along each axis
+	float minOverhangAreaMm2 = 1.0f;		// Unsupported new area that triggers the overhang exposure
+	float overhangExposureFactor = 1.5f;	// Exposure multiplier for overhang layers
+	float newIslandExposureFactor = 2.0f;	// Exposure multiplier for layers that start a new island
+	int extraDarkTimeMs = 1000;				// Added dark time after an adjusted layer
+};
+
+void buildSliceMask(const sf::Image& image, unsigned int downsample, SliceMask& mask);
+size_t andNotCount(const SliceMask& current, const SliceMask& previous);
+SliceDiff diffSlices(const SliceMask& current, const SliceMask& previous, float cellAreaMm2);
+
+std::vector<SliceDiff> analyzeSliceDiffs(const SliceSource& source, unsigned int downsample, float pixelSize,
+	std::vector<SliceInfo>* slices = nullptr);
+size_t applySliceDiffs(PrintPlan& plan, const std::vector<SliceDiff>& diffs, const AdaptiveExposureSettings& settings);
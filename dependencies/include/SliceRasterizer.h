@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Contour edge in pixel coordinates, the direction does not matter for even-odd filling
+struct EdgeSegment {
+	float x0, y0;
+	float x1, y1;
+};
+
+// RGBA buffer of a rasterized slice, one 32 bit pixel per entry
+struct SliceBitmap {
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<uint32_t> pixels;
+
+	const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(pixels.data()); }
+};
+
+void rasterizeEvenOdd(const std::vector<EdgeSegment>& edges, unsigned int width, unsigned int height, SliceBitmap& bitmap);
+size_t countEvenOdd(const std::vector<EdgeSegment>& edges, unsigned int width, unsigned int height);
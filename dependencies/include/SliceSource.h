@@ -0,0 +1,116 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// Result of inspecting one slice image during ingest
+struct SliceInfo {
+	size_t litPixels;	// Pixels with any non-zero colour channel
+	bool isEmpty;		// All-black slice, nothing to cure
+	bool decoded;		// False if the image could not be read
+};
+
+// Lit pixel count of a decoded slice, shared by the ingest and the slice analysis
+SliceInfo inspectSliceImage(const sf::Image& image);
+
+struct SliceSourceSettings {
+	unsigned int width = 3840;		// Projector resolution the slices are produced at
+	unsigned int height = 2160;
+	float layerHeight = 0.0f;		// mm, used by sources that slice geometry themselves
+	float pixelSize = 0.05f;		// mm per projector pixel in the build plane
+
+	bool streaming = false;						// Print while the slicer is still writing the job folder
+	size_t streamLead = 3;						// Layers the print stays behind the slicer
+	std::string streamEndMarker = "slicing.done";	// File the slicer writes once the job is complete
+	int streamIdleTimeoutMs = 120000;			// Job counts as complete after this long without new slices, 0 waits for the marker
+};
+
+// Provides the slice images of a job by index. loadLayer must be safe to call from several threads at once.
+class SliceSource {
+public:
+	virtual ~SliceSource() {}
+
+	virtual size_t layerCount() const = 0;
+	virtual std::string layerName(size_t index) const = 0;
+	virtual bool loadLayer(size_t index, sf::Image& image) const = 0;
+
+	// Lit pixel count of a layer, sources that know a layer is empty without rendering it override this
+	virtual SliceInfo inspectLayer(size_t index) const;
+
+	// False while further layers may still be added, layerCount then only covers the layers available so far
+	virtual bool isComplete() const { return true; }
+};
+
+// Slices exported by an external slicer as one image per layer
+class ImageDirectorySource : public SliceSource {
+public:
+	explicit ImageDirectorySource(const std::vector<std::string>& imagePaths) : imagePaths(imagePaths) {}
+
+	size_t layerCount() const override { return imagePaths.size(); }
+	std::string layerName(size_t index) const override { return imagePaths[index]; }
+	bool loadLayer(size_t index, sf::Image& image) const override { return image.loadFromFile(imagePaths[index]); }
+
+private:
+	std::vector<std::string> imagePaths;
+};
+
+// Ready-frame queue: worker threads produce the slices of the plan a few layers ahead of the print loop
+class SlicePrefetcher {
+public:
+	SlicePrefetcher(const SliceSource& source, const std::vector<size_t>& order, size_t depth, unsigned int threadCount);
+	~SlicePrefetcher();
+
+	// Blocks until the frame at the given position of the order is ready, nullptr if it could not be produced
+	const sf::Image* acquire(size_t position);
+	// Hands the slot of an acquired frame back to the workers
+	void release(size_t position);
+	// Adds a layer to the end of the order, for plans that grow during the print
+	void append(size_t layerIndex);
+
+private:
+	struct Slot {
+		sf::Image image;
+		size_t position = 0;
+		bool ready = false;
+		bool ok = false;
+	};
+
+	void workerLoop();
+
+	const SliceSource& source;
+	std::vector<size_t> order;
+	std::vector<Slot> slots;
+	size_t nextToProduce = 0;
+	size_t released = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::thread> workers;
+};
+
+// Serves the first layers of a job from memory and the others from the wrapped source. A queued job's first layers are decoded while
+// the job before it prints, so its ready-frame queue starts full.
+class PreloadedSliceSource : public SliceSource {
+public:
+	// Decodes the given layers right away, on the calling thread
+	PreloadedSliceSource(std::shared_ptr<SliceSource> source, const std::vector<size_t>& layers);
+
+	size_t layerCount() const override { return source->layerCount(); }
+	std::string layerName(size_t index) const override { return source->layerName(index); }
+	bool loadLayer(size_t index, sf::Image& image) const override;
+	SliceInfo inspectLayer(size_t index) const override { return source->inspectLayer(index); }
+	bool isComplete() const override { return source->isComplete(); }
+
+	size_t preloadedCount() const;
+
+private:
+	std::shared_ptr<SliceSource> source;
+	mutable std::map<size_t, sf::Image> preloaded; // Dropped once served, a layer is only printed once
+	mutable std::mutex mutex;
+};
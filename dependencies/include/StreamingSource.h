@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "SliceSource.h"
+
+// Job folder that is still being written by the slicer. A watcher thread picks up new slice images as they appear, the newest file
+// only counts once a later one exists or the job is complete, since the slicer may still be writing it.
+class StreamingDirectorySource : public SliceSource {
+public:
+	using PathOrder = std::function<bool(const std::string&, const std::string&)>;
+
+	StreamingDirectorySource(const std::string& directoryPath, const SliceSourceSettings& settings, PathOrder order);
+	~StreamingDirectorySource();
+
+	size_t layerCount() const override;
+	std::string layerName(size_t index) const override;
+	bool loadLayer(size_t index, sf::Image& image) const override;
+	bool isComplete() const override;
+
+private:
+	void watchLoop();
+	void rescan();
+
+	std::string directoryPath;
+	SliceSourceSettings settings;
+	PathOrder order;
+
+	mutable std::mutex mutex;
+	std::vector<std::string> imagePaths;		// Completely written slices, in print order
+	std::unordered_set<std::string> accepted;
+	size_t filesSeen = 0;						// Slice files listed by the last scan, accepted or not
+	bool complete = false;
+	std::chrono::steady_clock::time_point lastChange;
+
+	std::atomic<bool> stopping{ false };
+	std::thread watcher;
+};
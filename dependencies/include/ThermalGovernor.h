@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include "IntensityCalibration.h"
+
+struct ThermalGovernorSettings {
+	bool enabled = false;
+	double targetTemperature = 50.0;	// Celsius, the projected temperature is kept below this value
+	double hysteresis = 3.0;			// The current limit is raised again once the projection is this far below the target
+	double cooldownTemperature = 57.0;	// Celsius, dark phases are extended above this value
+	int trendWindowSeconds = 60;		// Samples used for the temperature slope
+	int lookaheadSeconds = 60;			// How far the slope is projected
+	int adjustIntervalSeconds = 20;		// Minimum time between two changes of the current limit, each change costs a settle time
+	int currentStep = 10;				// Change of the current limit per adjustment
+	int minCurrent = 60;				// The limit never drops below this current, cooldown takes over from there
+	int maxCooldownMs = 30000;			// Longest extension of a single dark phase
+};
+
+// Exposure of one layer after the governor
+struct GovernedExposure {
+	int intensity;
+	int exposureFrames;
+};
+
+// Limits the light engine current when the temperature trend approaches the target. Layers above the limit are exposed at the limit
+// for proportionally more frames, so the dose stays the same.
+class ThermalGovernor {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit ThermalGovernor(const ThermalGovernorSettings& settings = ThermalGovernorSettings());
+
+	void addSample(Clock::time_point time, double temperature);
+	// Temperature projected lookaheadSeconds ahead from the recent slope
+	double projectedTemperature() const;
+	// Moves the current limit one step if the projection requires it and the last change is long enough ago, true if it changed
+	bool update(Clock::time_point now);
+	int currentLimit() const { return limit; }
+
+	// calibration may be null, the irradiance is then taken as proportional to the current
+	GovernedExposure govern(int intensity, int exposureFrames, double temperature, const IntensityCalibration* calibration) const;
+	// Dark phases are extended from needsCooldown until cooledDown
+	bool needsCooldown() const;
+	bool cooledDown() const;
+
+private:
+	ThermalGovernorSettings settings;
+	std::deque<std::pair<Clock::time_point, double>> samples;
+	int limit = 255;
+	Clock::time_point lastChange;
+	bool changed = false;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "SliceSource.h"
+#include "SliceRasterizer.h"
+
+// Closed contours of one layer, x y pairs in mm
+struct VectorLayer {
+	std::vector<uint32_t> contourStarts;	// Index of the first point of each contour
+	std::vector<float> points;
+};
+
+bool loadSvgLayers(const std::string& filePath, std::vector<VectorLayer>& layers, std::string& error);
+
+// Per-layer polygons (e.g. an SVG export with one group per layer) rasterized at projector resolution on demand
+class VectorSliceSource : public SliceSource {
+public:
+	VectorSliceSource(std::vector<VectorLayer> layers, const SliceSourceSettings& settings, const std::string& name);
+
+	static std::shared_ptr<VectorSliceSource> open(const std::string& filePath, const SliceSourceSettings& settings, std::string& error);
+
+	size_t layerCount() const override { return layers.size(); }
+	std::string layerName(size_t index) const override;
+	bool loadLayer(size_t index, sf::Image& image) const override;
+	SliceInfo inspectLayer(size_t index) const override;
+
+	// Contour edges of a layer in pixel coordinates
+	void layerEdges(size_t index, std::vector<EdgeSegment>& edges) const;
+
+private:
+	std::vector<VectorLayer> layers;
+	SliceSourceSettings settings;
+	std::string name;
+	float centerX = 0.0f;
+	float centerY = 0.0f;
+};
@@ -3,8 +3,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <chrono>
 #include <cstdint> // For uint8_t, int16_t types
 #include "SMC100C.h"
+#include "PrintPlan.h"
+#include "SliceAnalysis.h"
+#include "LayerSettingsParser.h"
+#include "LightEngineMonitor.h"
+#include "LogCallback.h"
 #include <QString>
 #include <QMutex>
 
@@ -12,10 +18,9 @@ extern QString globalComPort; // Declaration
 extern QMutex mutexForComPort; // For thread-safe access if needed
 
 
-typedef std::function<void(const std::string&)> LogCallback;
-
 struct StageStatus {
 
+	bool connected;		// False if the controller could not be opened, the values are then zero
 	float position;
 	float velocity;
 	float acceleration;
@@ -25,50 +30,101 @@ struct StageStatus {
 
 
 
-struct LightEngineStatus {
-	unsigned char status;
-	unsigned char current;
-	unsigned char sysStatus;
-	bool ledDefaultStatus;
-	int16_t temperature;
+enum class WarmUpOutcome {
+	Ready,
+	Cancelled,
+	TimedOut,
+	PowerOnFailed
 };
 
-struct LayerSettings {
-	int intensity;
-	int exposureTime;
-	int darkTime;
+struct LightEngineWarmUpProgress {
+	std::chrono::milliseconds elapsed;
+	unsigned char sysStatus;
+};
 
-	LayerSettings(int i, int e, int d);
+struct LightEngineWarmUpResult {
+	WarmUpOutcome outcome;
+	std::chrono::milliseconds elapsed;
+	unsigned char lastSysStatus;
+	std::string message;
+};
 
+typedef std::function<void(const LightEngineWarmUpProgress&)> WarmUpProgressCallback;
 
-	bool operator<(const LayerSettings& other) const {
-		return std::tie(intensity, exposureTime, darkTime) < std::tie(other.intensity, other.exposureTime, other.darkTime);
-	};
+enum class PrintJobKind {
+	Static,		// Exposure and dark time from maxImageDisplayCount and mindarktime, see RunFull
+	Dynamic,	// Layer settings from orderedSettings, see RunFullDynamic
+	Rules,		// Layer settings from the rule file rulesPath, see RunFullRules
+	Compiled	// Plan file jobPath, see RunCompiledPlan
+};
 
-	bool operator==(const LayerSettings& other) const {
-		return intensity == other.intensity && exposureTime == other.exposureTime && darkTime == other.darkTime;
-	};
+// Everything needed to initialize the printer for a job and to build its plan, so jobs can be queued and prepared ahead
+struct PrintJob {
+	PrintJobKind kind = PrintJobKind::Static;
+	std::string jobPath;	// Slice folder, mesh or vector file, the plan file of a compiled job
+	std::string rulesPath;
+	std::vector<std::pair<LayerSettings, int>> orderedSettings;
+	int maxImageDisplayCount = 0;
+	int mindarktime = 0;
+	int initialExposureCounter = 0;
+	int initialLayers = 0;
+	float stepSize = 0.0f;
+	bool isClip = true;
+	float dlpPumpingAction = 0.0f;
+
+	// InitializeSystem
+	int inputCurrent = 0;
+	float initialPosition = 0.0f;
+	float inputVelocity = 0.0f;
+	float initialVelocity = 0.0f;
+
+	SliceSourceSettings sourceSettings;	// Width and height are those of the projector window
+	AdaptiveExposureSettings adaptiveSettings;
+	DoseSettings doseSettings;
+	ThermalGovernorSettings thermalSettings;
+	MotionSettings motionSettings;
 };
 
-std::vector<std::pair<LayerSettings, int>> readSettingsOrdered(const std::string& filePath);
+std::vector<std::pair<LayerSettings, int>> readSettingsOrdered(const std::string& filePath, std::vector<LayerSettingsError>& errors);
 
 
-void TurnLightEngineOn();
+LightEngineWarmUpResult TurnLightEngineOn(std::function<bool()> isCancelled = nullptr, WarmUpProgressCallback onProgress = nullptr,
+	std::chrono::seconds timeout = std::chrono::seconds(600));
 void TurnLightEngineOff();
-void InitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window,float initialVelocity);
+bool InitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window,float initialVelocity);
 void InitializeSystemDummy(const std::string& directoryPath, int inputCurrent, float initialPosition, float initialVelocity, sf::RenderWindow& window);
-void DeinitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity);
+void moveToJobStart(SMC100C& controller, float initialPosition, float velocity, float initialVelocity);
+bool DeinitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity);
 
 void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
 	float dlpPumpingAction,
-	int initialExposureCounter, int initialLayers);
+	int initialExposureCounter, int initialLayers, SliceSourceSettings sourceSettings = SliceSourceSettings(),
+	AdaptiveExposureSettings adaptiveSettings = AdaptiveExposureSettings(), ThermalGovernorSettings thermalSettings = ThermalGovernorSettings());
+void ingestPlan(PrintPlan& plan, const AdaptiveExposureSettings& adaptiveSettings, float pixelSize, LogCallback logCallback,
+	const std::vector<SliceInfo>* slices = nullptr, const std::vector<SliceDiff>* diffs = nullptr);
+std::shared_ptr<SliceSource> openSliceSource(const std::string& jobPath, const SliceSourceSettings& settings, LogCallback logCallback);
+void RunPlan(PrintPlan& plan, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+	float dlpPumpingAction, bool closeWindow = true, SMC100C* stage = nullptr);
+bool preparePrintJob(const PrintJob& job, LogCallback logCallback, PrintPlan& plan, size_t preloadLayers = 0);
 void RunFullDummy(const std::string& directoryPath, sf::RenderWindow& window);
-StageStatus checkStage();
+StageStatus checkStage(std::function<bool()> cancelled = nullptr);
 StageStatus checkStageDummy();
 LightEngineStatus getLightEngineStatus();
 LightEngineStatus getLightEngineStatusDummy();
 void RunFullDynamic(const std::string& directoryPath, float stepSize, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
 	float dlpPumpingAction,
-	const std::vector<std::pair<LayerSettings, int>>& orderedSettings);
+	const std::vector<std::pair<LayerSettings, int>>& orderedSettings, SliceSourceSettings sourceSettings = SliceSourceSettings(),
+	AdaptiveExposureSettings adaptiveSettings = AdaptiveExposureSettings(), DoseSettings doseSettings = DoseSettings(),
+	ThermalGovernorSettings thermalSettings = ThermalGovernorSettings(), MotionSettings motionSettings = MotionSettings());
+void RunFullRules(const std::string& directoryPath, const std::string& rulesPath, float stepSize, sf::RenderWindow& window,
+	LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction,
+	SliceSourceSettings sourceSettings = SliceSourceSettings(), AdaptiveExposureSettings adaptiveSettings = AdaptiveExposureSettings(),
+	DoseSettings doseSettings = DoseSettings(), ThermalGovernorSettings thermalSettings = ThermalGovernorSettings(),
+	MotionSettings motionSettings = MotionSettings());
+bool CompilePlan(const std::string& directoryPath, const std::string& settingsPath, const std::string& planPath, float stepSize,
+	SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings, double frameRate, LogCallback logCallback);
+void RunCompiledPlan(const std::string& planPath, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag,
+	bool isClip, float dlpPumpingAction, DoseSettings doseSettings = DoseSettings(),
+	ThermalGovernorSettings thermalSettings = ThermalGovernorSettings(), MotionSettings motionSettings = MotionSettings());
 
 bool initializeController(SMC100C& controller);
@@ -0,0 +1,363 @@
+
+#include "EventLog.h"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+//--------------------------------------------------------Formatting-----------------------------------------------------------------
+
+const char* printEventName(PrintEventType type) {
+    switch (type) {
+    case PrintEventType::LayerDisplayed: return "LayerDisplayed";
+    case PrintEventType::DarkPhaseFinished: return "DarkPhaseFinished";
+    case PrintEventType::LightPhaseFinished: return "LightPhaseFinished";
+    case PrintEventType::StagePosition: return "StagePosition";
+    case PrintEventType::StagePositionInvalid: return "StagePositionInvalid";
+    case PrintEventType::LayerExposed: return "LayerExposed";
+    case PrintEventType::EmptyLayersSkipped: return "EmptyLayersSkipped";
+    case PrintEventType::EngineTemperature: return "EngineTemperature";
+    case PrintEventType::NextImageLoaded: return "NextImageLoaded";
+    case PrintEventType::ImageLoadFailed: return "ImageLoadFailed";
+    case PrintEventType::ProfileLate: return "ProfileLate";
+    case PrintEventType::SettingsApplied: return "SettingsApplied";
+    case PrintEventType::DoseResolved: return "DoseResolved";
+    case PrintEventType::DoseUnreachable: return "DoseUnreachable";
+    case PrintEventType::GovernorLimit: return "GovernorLimit";
+    case PrintEventType::GovernorIntensity: return "GovernorIntensity";
+    case PrintEventType::CooldownStarted: return "CooldownStarted";
+    case PrintEventType::CooldownFinished: return "CooldownFinished";
+    case PrintEventType::WaitingForSlicer: return "WaitingForSlicer";
+    case PrintEventType::StageVelocity: return "StageVelocity";
+    case PrintEventType::StageAcceleration: return "StageAcceleration";
+    case PrintEventType::TemperatureUnavailable: return "TemperatureUnavailable";
+    default: return "Unknown";
+    }
+}
+
+LogSeverity printEventSeverity(PrintEventType type) {
+    switch (type) {
+    case PrintEventType::StagePositionInvalid:
+    case PrintEventType::ImageLoadFailed:
+        return LogSeverity::Error;
+    case PrintEventType::ProfileLate:
+    case PrintEventType::DoseUnreachable:
+    case PrintEventType::GovernorLimit:
+    case PrintEventType::GovernorIntensity:
+    case PrintEventType::CooldownStarted:
+    case PrintEventType::TemperatureUnavailable:
+        return LogSeverity::Warning;
+    default:
+        return LogSeverity::Info;
+    }
+}
+
+LogSubsystem printEventSubsystem(PrintEventType type) {
+    switch (type) {
+    case PrintEventType::StagePosition:
+    case PrintEventType::StagePositionInvalid:
+    case PrintEventType::StageVelocity:
+    case PrintEventType::StageAcceleration:
+        return LogSubsystem::Stage;
+    case PrintEventType::EngineTemperature:
+    case PrintEventType::ProfileLate:
+    case PrintEventType::SettingsApplied:
+    case PrintEventType::DoseResolved:
+    case PrintEventType::DoseUnreachable:
+    case PrintEventType::GovernorLimit:
+    case PrintEventType::GovernorIntensity:
+    case PrintEventType::CooldownStarted:
+    case PrintEventType::CooldownFinished:
+    case PrintEventType::TemperatureUnavailable:
+        return LogSubsystem::LightEngine;
+    case PrintEventType::EmptyLayersSkipped:
+    case PrintEventType::NextImageLoaded:
+    case PrintEventType::ImageLoadFailed:
+    case PrintEventType::WaitingForSlicer:
+        return LogSubsystem::Slices;
+    default:
+        return LogSubsystem::Print;
+    }
+}
+
+std::string formatPrintEvent(const PrintEvent& event) {
+    const int32_t* i = event.i;
+    const double* x = event.x;
+    std::ostringstream text;
+    switch (event.type) {
+    case PrintEventType::LayerDisplayed:
+        text << "Displaying slice " << i[0];
+        break;
+    case PrintEventType::DarkPhaseFinished:
+        text << "Dark phase duration: " << i[0] << " ms";
+        break;
+    case PrintEventType::LightPhaseFinished:
+        text << "Light phase duration: " << i[0] << " ms";
+        break;
+    case PrintEventType::StagePosition:
+        text << "Position: " << std::fixed << std::setprecision(3) << x[0] << " mm";
+        break;
+    case PrintEventType::StagePositionInvalid:
+        text << "Error: Position string too short or in unexpected format.";
+        break;
+    case PrintEventType::LayerExposed:
+        text << "Current Image Index: " << i[0] << " / " << i[1];
+        break;
+    case PrintEventType::EmptyLayersSkipped:
+        text << "Skipping " << i[0] << " empty layers in the next move.";
+        break;
+    case PrintEventType::EngineTemperature:
+        text << "Light engine temperature: " << i[0] << " C";
+        break;
+    case PrintEventType::NextImageLoaded:
+        text << "Next Image Loaded.";
+        break;
+    case PrintEventType::ImageLoadFailed:
+        text << "Failed to load image of slice " << i[0];
+        break;
+    case PrintEventType::ProfileLate:
+        text << "Intensity profile ran " << i[0] << " ms behind schedule.";
+        break;
+    case PrintEventType::SettingsApplied:
+        text << "Applying settings: Intensity " << i[0] << ", Exposure Time: " << i[1] << ", Dark Time: " << i[2];
+        break;
+    case PrintEventType::DoseResolved:
+        text << "Dose " << x[0] << " mJ/cm2 at " << i[0] << " C: intensity " << i[1] << ", " << i[2] << " frames, " << x[1] <<
+            " mJ/cm2 delivered";
+        break;
+    case PrintEventType::DoseUnreachable:
+        text << "Dose unreachable: current " << i[0] << " is below the intensity calibration or gives no light, keeping the layer settings.";
+        break;
+    case PrintEventType::GovernorLimit:
+        text << "Thermal governor: current limit " << i[0] << ", projected temperature " << i[1] << " C";
+        break;
+    case PrintEventType::GovernorIntensity:
+        text << "Thermal governor: intensity " << i[0] << " -> " << i[1] << ", exposure " << i[2] << " -> " << i[3] << " frames";
+        break;
+    case PrintEventType::CooldownStarted:
+        text << "Light engine near its thermal limit, extending the dark phase to cool down.";
+        break;
+    case PrintEventType::CooldownFinished:
+        text << "Cooldown finished after " << i[0] << " ms";
+        break;
+    case PrintEventType::WaitingForSlicer:
+        text << "Waiting for the slicer to write the next layer...";
+        break;
+    case PrintEventType::StageVelocity:
+        text << "Stage velocity: " << x[0] << " mm/s";
+        break;
+    case PrintEventType::StageAcceleration:
+        text << "Stage acceleration: " << x[0] << " mm/s2";
+        break;
+    case PrintEventType::TemperatureUnavailable:
+        text << "Warning: light engine temperature could not be read, the thermal governor keeps its limit, dose uses " << i[0] << " C";
+        break;
+    default:
+        text << "Unknown event " << static_cast<int>(event.type);
+        break;
+    }
+    return text.str();
+}
+
+bool readEventFile(const std::string& filePath, std::vector<PrintEvent>& events, std::string& error) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        error = "Failed to open event file: " + filePath;
+        return false;
+    }
+    EventFileHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, eventFileMagic, sizeof(eventFileMagic)) != 0) {
+        error = filePath + " is not an event file";
+        return false;
+    }
+    if (header.version != eventFileVersion || header.recordSize != sizeof(PrintEvent)) {
+        error = filePath + " was written by another version, version " + std::to_string(header.version);
+        return false;
+    }
+    events.clear();
+    PrintEvent event;
+    while (file.read(reinterpret_cast<char*>(&event), sizeof(event))) {
+        events.push_back(event);
+    }
+    return true; // A record cut off by a crash is ignored
+}
+
+//--------------------------------------------------------Event Log-----------------------------------------------------------------
+
+EventLog::EventLog() {
+    for (size_t index = 0; index < capacity; ++index) {
+        slots[index].sequence.store(index, std::memory_order_relaxed);
+    }
+    batch.reserve(capacity);
+}
+
+EventLog::~EventLog() {
+    stop();
+}
+
+/**************************************************************************************************************************************
+Function:
+    EventLog::start
+Parameters:
+    const std::string& filePath: Event file to create, empty for no file
+    EventSink sink: Receives every event as text with its severity and subsystem on the writer thread
+Returns:
+    bool: False if already running or the file could not be created, the sink still receives the events in the latter case
+Description:
+    Events left in the ring by a previous print are discarded, the event times start at 0.
+***************************************************************************************************************************************/
+
+bool EventLog::start(const std::string& filePath, EventSink sink) {
+    if (isRunning()) {
+        return false;
+    }
+    this->sink = nullptr;
+    drain(); // Recorded after the last stop
+
+    bool ok = true;
+    if (!filePath.empty()) {
+        file = std::fopen(filePath.c_str(), "wb");
+        if (file) {
+            EventFileHeader header{};
+            std::memcpy(header.magic, eventFileMagic, sizeof(eventFileMagic));
+            header.version = eventFileVersion;
+            header.recordSize = sizeof(PrintEvent);
+            header.startUnixUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            std::fwrite(&header, sizeof(header), 1, file);
+        }
+        else {
+            std::cerr << "Failed to create event file: " << filePath << std::endl;
+            ok = false;
+        }
+    }
+
+    this->sink = std::move(sink);
+    dropped.store(0, std::memory_order_relaxed);
+    stopRequested = false;
+    startTime = std::chrono::steady_clock::now();
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&EventLog::writerLoop, this);
+    return ok;
+}
+
+void EventLog::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    running.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    uint64_t lost = droppedEvents();
+    if (lost > 0 && sink) {
+        sink(std::to_string(lost) + " log events were dropped, the log writer fell behind.", LogSeverity::Warning, LogSubsystem::Print);
+    }
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    sink = nullptr;
+}
+
+/**************************************************************************************************************************************
+Function:
+    EventLog::record
+Parameters:
+    PrintEventType type, int32_t i0..i3, double x0, x1: Event and its values, see PrintEventType
+Returns:
+    void
+Description:
+    Claims the next slot of the ring and fills it. Never blocks and never allocates; when the ring is full the event is counted as
+    dropped. Events recorded while the log is stopped are ignored.
+***************************************************************************************************************************************/
+
+void EventLog::record(PrintEventType type, int32_t i0, int32_t i1, int32_t i2, int32_t i3, double x0, double x1) {
+    if (!isRunning()) {
+        return;
+    }
+    size_t position = head.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[position & (capacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (sequence < position) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // The writer has not read this slot yet, the ring is full
+            return;
+        }
+        else {
+            position = head.load(std::memory_order_relaxed); // Claimed by another thread
+        }
+    }
+
+    PrintEvent& event = slot->event;
+    event.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    event.sequence = static_cast<uint32_t>(position);
+    event.type = type;
+    event.reserved = 0;
+    event.i[0] = i0;
+    event.i[1] = i1;
+    event.i[2] = i2;
+    event.i[3] = i3;
+    event.x[0] = x0;
+    event.x[1] = x1;
+    slot->sequence.store(position + 1, std::memory_order_release); // Publishes the event to the writer
+}
+
+size_t EventLog::drain() {
+    batch.clear();
+    size_t position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[position & (capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+        }
+        batch.push_back(slot.event);
+        slot.sequence.store(position + capacity, std::memory_order_release); // Free for the next round of the ring
+        ++position;
+    }
+    tail.store(position, std::memory_order_relaxed);
+    if (batch.empty()) {
+        return 0;
+    }
+    if (file) {
+        std::fwrite(batch.data(), sizeof(PrintEvent), batch.size(), file);
+    }
+    if (sink) {
+        for (const PrintEvent& event : batch) {
+            sink(formatPrintEvent(event), printEventSeverity(event.type), printEventSubsystem(event.type));
+        }
+    }
+    return batch.size();
+}
+
+void EventLog::writerLoop() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (!stopRequested) {
+        // Often enough for the log view to follow the print, rarely enough to cost nothing measurable
+        wake.wait_for(lock, std::chrono::milliseconds(50));
+        lock.unlock();
+        if (drain() > 0 && file) {
+            std::fflush(file); // The events of a crashed print are on disk up to the last 50 ms
+        }
+        lock.lock();
+    }
+    lock.unlock();
+    drain();
+}
+
+EventLog& eventLog() {
+    static EventLog log;
+    return log;
+}
@@ -0,0 +1,157 @@
+
+#include "IntensityCalibration.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+/**************************************************************************************************************************************
+Function:
+    IntensityCalibration::loadFromFile
+Parameters:
+    const std::string& filePath: CSV file with one measurement per line, Current,Temperature,Irradiance
+Returns:
+    bool: True if at least one point was read
+Description:
+    Reads the radiometer measurements of the light engine. The irradiance is measured in the build plane in mW/cm² for each current at
+    one or more light engine temperatures. Lines that cannot be parsed are reported and skipped.
+***************************************************************************************************************************************/
+
+bool IntensityCalibration::loadFromFile(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to open calibration file: " << filePath << std::endl;
+        return false;
+    }
+
+    rows.clear();
+    std::string line;
+
+    // Skip header
+    std::getline(file, line);
+
+    int lineNumber = 1;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream iss(line);
+        CalibrationPoint point;
+        char delim; // For the commas
+        if (!(iss >> point.current >> delim >> point.temperature >> delim >> point.irradiance) ||
+            point.current < 0 || point.current > 255 || point.irradiance < 0.0) {
+            std::cerr << "Skipping invalid calibration line " << lineNumber << ": " << line << std::endl;
+            continue;
+        }
+        addPoint(point);
+    }
+
+    return !rows.empty();
+}
+
+void IntensityCalibration::addPoint(const CalibrationPoint& point) {
+    auto row = std::find_if(rows.begin(), rows.end(), [&](const Row& r) { return r.temperature == point.temperature; });
+    if (row == rows.end()) {
+        row = rows.insert(std::upper_bound(rows.begin(), rows.end(), point.temperature,
+            [](double temperature, const Row& r) { return temperature < r.temperature; }), Row{ point.temperature, {} });
+    }
+
+    auto entry = std::lower_bound(row->points.begin(), row->points.end(), point.current,
+        [](const std::pair<int, double>& p, int current) { return p.first < current; });
+    if (entry != row->points.end() && entry->first == point.current) {
+        entry->second = point.irradiance; // A repeated measurement replaces the earlier one
+    }
+    else {
+        row->points.insert(entry, { point.current, point.irradiance });
+    }
+}
+
+double IntensityCalibration::rowIrradiance(const Row& row, int current) const {
+    const auto& points = row.points;
+    if (current <= points.front().first) {
+        return points.front().second;
+    }
+    if (current >= points.back().first) {
+        return points.back().second;
+    }
+
+    auto upper = std::upper_bound(points.begin(), points.end(), current,
+        [](int c, const std::pair<int, double>& p) { return c < p.first; });
+    auto lower = upper - 1;
+    double t = static_cast<double>(current - lower->first) / (upper->first - lower->first);
+    return lower->second + (upper->second - lower->second) * t;
+}
+
+// Every temperature row is measured from here on, below it at least one row would be extrapolated
+int IntensityCalibration::lowestCalibratedCurrent() const {
+    int lowest = 0;
+    for (const Row& row : rows) {
+        lowest = std::max(lowest, row.points.front().first);
+    }
+    return lowest;
+}
+
+double IntensityCalibration::irradiance(int current, double temperature) const {
+    if (rows.empty()) {
+        return 0.0;
+    }
+    if (temperature <= rows.front().temperature) {
+        return rowIrradiance(rows.front(), current);
+    }
+    if (temperature >= rows.back().temperature) {
+        return rowIrradiance(rows.back(), current);
+    }
+
+    auto upper = std::upper_bound(rows.begin(), rows.end(), temperature,
+        [](double temp, const Row& r) { return temp < r.temperature; });
+    auto lower = upper - 1;
+    double t = (temperature - lower->temperature) / (upper->temperature - lower->temperature);
+    double low = rowIrradiance(*lower, current);
+    return low + (rowIrradiance(*upper, current) - low) * t;
+}
+
+/**************************************************************************************************************************************
+Function:
+    IntensityCalibration::exposureForDose
+Parameters:
+    double doseMJ: Required dose in mJ/cm²
+    double temperature: Current light engine temperature in Celsius
+    int maxCurrent: Highest current allowed for this print
+    double frameRate: Exposure frames per second
+    DoseExposure& exposure: Receives the chosen intensity and frame count
+Returns:
+    bool: False if the dose is unreachable: maxCurrent is below the lowest calibrated current or emits no light
+Description:
+    The shortest exposure is reached at the highest safe current, so the intensity is maxCurrent and the frame count is the number of
+    frames it needs for the dose. The current is not lowered to trim the overshoot of the last frame, every current change costs the
+    settle time of the light engine during the print.
+Notes:
+    - The irradiance below the calibrated currents is not known, a maxCurrent there is reported as unreachable instead of being
+      extrapolated.
+***************************************************************************************************************************************/
+
+bool IntensityCalibration::exposureForDose(double doseMJ, double temperature, int maxCurrent, double frameRate,
+    DoseExposure& exposure) const {
+    maxCurrent = std::clamp(maxCurrent, 0, 255);
+    if (maxCurrent < lowestCalibratedCurrent()) {
+        return false;
+    }
+    double peak = irradiance(maxCurrent, temperature);
+    if (peak <= 0.0 || frameRate <= 0.0) {
+        return false;
+    }
+    double frameTime = 1.0 / frameRate;
+
+    // mW/cm² times seconds is mJ/cm²
+    int frames = std::max(1, static_cast<int>(std::ceil(doseMJ / (peak * frameTime) - 1e-9)));
+    double exposureSeconds = frames * frameTime;
+
+    exposure.intensity = maxCurrent;
+    exposure.exposureFrames = frames;
+    exposure.irradiance = peak;
+    exposure.deliveredDose = peak * exposureSeconds;
+    return true;
+}
@@ -0,0 +1,141 @@
+
+#include "IntensityProfile.h"
+#include "LightEngineDriver.h"
+#include "LightEngineTrace.h"
+#include <algorithm>
+#include <sstream>
+
+/**************************************************************************************************************************************
+Function:
+    parseIntensityProfile
+Parameters:
+    const std::string& text: Segments separated by ';', each "intensity:milliseconds"
+    IntensityProfile& profile: Receives the segments
+    std::string& error: Reason the text was rejected
+Returns:
+    bool: True if every segment has an intensity from 0 to 255 and a positive duration
+***************************************************************************************************************************************/
+
+bool parseIntensityProfile(const std::string& text, IntensityProfile& profile, std::string& error) {
+    profile.clear();
+    std::istringstream segments(text);
+    std::string segment;
+    while (std::getline(segments, segment, ';')) {
+        if (segment.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream iss(segment);
+        IntensitySegment parsed;
+        char delim;
+        std::string rest;
+        if (!(iss >> parsed.intensity >> delim >> parsed.durationMs) || delim != ':' || (iss >> rest)) {
+            error = "expected intensity:milliseconds, got \"" + segment + "\"";
+            return false;
+        }
+        if (parsed.intensity < 0 || parsed.intensity > 255 || parsed.durationMs <= 0) {
+            error = "intensity must be 0 to 255 and the duration positive in \"" + segment + "\"";
+            return false;
+        }
+        profile.push_back(parsed);
+    }
+    if (profile.empty()) {
+        error = "profile has no segments";
+        return false;
+    }
+    return true;
+}
+
+int profileDurationMs(const IntensityProfile& profile) {
+    int total = 0;
+    for (const IntensitySegment& segment : profile) {
+        total += segment.durationMs;
+    }
+    return total;
+}
+
+//--------------------------------------------------------Profile Player-----------------------------------------------------------------
+
+IntensityProfilePlayer::IntensityProfilePlayer() {
+    thread = std::thread(&IntensityProfilePlayer::run, this);
+}
+
+IntensityProfilePlayer::~IntensityProfilePlayer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void IntensityProfilePlayer::arm(std::shared_ptr<const IntensityProfile> profile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    armed = profile;
+    started = false;
+    lateness = std::chrono::milliseconds(0);
+}
+
+void IntensityProfilePlayer::start(std::chrono::steady_clock::time_point exposureStart) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!armed) {
+            return;
+        }
+        startTime = exposureStart;
+        started = true;
+    }
+    wake.notify_all();
+}
+
+std::chrono::milliseconds IntensityProfilePlayer::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!started) {
+        armed.reset(); // Never started, nothing was sent
+    }
+    wake.wait(lock, [this]() { return !armed; });
+    started = false;
+    return lateness;
+}
+
+/**************************************************************************************************************************************
+Function:
+    IntensityProfilePlayer::run
+Parameters:
+    None
+Returns:
+    void
+Description:
+    Player thread. Once a profile is armed and started it sleeps until the start of each following segment and sends its current.
+    The offsets are measured from the exposure start rather than from the previous command, so a slow USB round trip delays only
+    its own segment and does not shift the rest of the profile.
+***************************************************************************************************************************************/
+
+void IntensityProfilePlayer::run() {
+    lightEngineTrace().setPhase(LightEnginePhase::Exposure); // The player only sends commands within an exposure
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || (armed && started); });
+        if (stopping) {
+            return;
+        }
+
+        std::shared_ptr<const IntensityProfile> profile = armed;
+        auto due = startTime;
+        for (size_t i = 1; i < profile->size() && !stopping; ++i) {
+            due += std::chrono::milliseconds((*profile)[i - 1].durationMs);
+            wake.wait_until(lock, due, [this]() { return stopping; });
+            if (stopping) {
+                break;
+            }
+
+            lock.unlock();
+            lightEngine().setCurrent(static_cast<unsigned char>((*profile)[i].intensity));
+            auto late = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - due);
+            lock.lock();
+            lateness = std::max(lateness, late);
+        }
+
+        armed.reset();
+        wake.notify_all();
+    }
+}
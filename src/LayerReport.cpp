@@ -0,0 +1,163 @@
+
+#include "LayerReport.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+const char* darkPhaseEndName(DarkPhaseEnd reason) {
+    switch (reason) {
+    case DarkPhaseEnd::DarkTime: return "DarkTime";
+    case DarkPhaseEnd::StageMove: return "StageMove";
+    case DarkPhaseEnd::SliceLoad: return "SliceLoad";
+    case DarkPhaseEnd::Slicer: return "Slicer";
+    case DarkPhaseEnd::Cooldown: return "Cooldown";
+    case DarkPhaseEnd::LastLayer: return "LastLayer";
+    case DarkPhaseEnd::Aborted: return "Aborted";
+    default: return "Unknown";
+    }
+}
+
+namespace {
+
+// Nearest rank, so every reported value is one a layer actually had
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(fraction * values.size()));
+    return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+}
+
+std::vector<double> LayerReport::idleByCause(double& settingsIdleMs) const {
+    std::vector<double> idle(static_cast<size_t>(DarkPhaseEnd::Count), 0.0);
+    settingsIdleMs = 0.0;
+    for (const LayerTiming& layer : layers) {
+        if (layer.darkPhaseEnd == DarkPhaseEnd::LastLayer || layer.darkPhaseEnd == DarkPhaseEnd::Aborted) {
+            continue; // The print ended within this dark phase
+        }
+        double beyondPlan = std::max(0.0, layer.actualDarkMs - layer.plannedDarkMs);
+        double settings = std::min(beyondPlan, layer.settingsMs);
+        settingsIdleMs += settings;
+        idle[static_cast<size_t>(layer.darkPhaseEnd)] += beyondPlan - settings;
+    }
+    return idle;
+}
+
+/**************************************************************************************************************************************
+Function:
+    LayerReport::summary
+Parameters:
+    None
+Returns:
+    std::vector<std::string>: e.g. "Dark time: p50 1203.4 ms, p95 2210.0 ms, max 2305.1 ms" and "Idle StageMove: 15321.0 ms"
+Description:
+    The exposure and the dark time are compared to the plan, the move, the slice and the settings are reported as measured. The
+    last layer and an aborted layer have no complete dark phase and are left out of the dark time statistics.
+***************************************************************************************************************************************/
+
+std::vector<std::string> LayerReport::summary() const {
+    std::vector<std::string> lines;
+    if (layers.empty()) {
+        return lines;
+    }
+
+    auto statistic = [&](const std::string& name, std::function<double(const LayerTiming&)> value, bool completeDarkPhase) {
+        std::vector<double> values;
+        for (const LayerTiming& layer : layers) {
+            if (!completeDarkPhase || (layer.darkPhaseEnd != DarkPhaseEnd::LastLayer && layer.darkPhaseEnd != DarkPhaseEnd::Aborted)) {
+                values.push_back(value(layer));
+            }
+        }
+        if (values.empty()) {
+            return;
+        }
+        std::ostringstream line;
+        line.setf(std::ios::fixed);
+        line.precision(1);
+        line << name << ": p50 " << percentile(values, 0.5) << " ms, p95 " << percentile(values, 0.95) << " ms, max "
+            << *std::max_element(values.begin(), values.end()) << " ms";
+        lines.push_back(line.str());
+    };
+
+    lines.push_back(std::to_string(layers.size()) + " layers exposed");
+    statistic("Exposure", [](const LayerTiming& layer) { return layer.actualExposureMs; }, false);
+    statistic("Exposure beyond plan", [](const LayerTiming& layer) { return layer.actualExposureMs - layer.plannedExposureMs; }, false);
+    statistic("Dark time", [](const LayerTiming& layer) { return layer.actualDarkMs; }, true);
+    statistic("Dark time beyond plan", [](const LayerTiming& layer) { return layer.actualDarkMs - layer.plannedDarkMs; }, true);
+    statistic("Stage move", [](const LayerTiming& layer) { return layer.moveMs; }, true);
+    statistic("Slice ready", [](const LayerTiming& layer) { return layer.sliceReadyMs; }, true);
+    statistic("Settings", [](const LayerTiming& layer) { return layer.settingsMs; }, true);
+
+    double settingsIdleMs = 0.0;
+    std::vector<double> idle = idleByCause(settingsIdleMs);
+    double totalIdleMs = settingsIdleMs;
+    for (size_t cause = 0; cause < idle.size(); ++cause) {
+        totalIdleMs += idle[cause];
+    }
+    std::ostringstream line;
+    line.setf(std::ios::fixed);
+    line.precision(1);
+    line << "Idle beyond the planned dark time: " << totalIdleMs << " ms";
+    lines.push_back(line.str());
+    auto idleLine = [&](const char* cause, double ms) {
+        if (ms <= 0.0) {
+            return;
+        }
+        std::ostringstream text;
+        text.setf(std::ios::fixed);
+        text.precision(1);
+        text << "Idle " << cause << ": " << ms << " ms";
+        lines.push_back(text.str());
+    };
+    for (size_t cause = 0; cause < idle.size(); ++cause) {
+        idleLine(darkPhaseEndName(static_cast<DarkPhaseEnd>(cause)), idle[cause]);
+    }
+    idleLine("Settings", settingsIdleMs);
+    return lines;
+}
+
+bool LayerReport::writeCsv(const std::string& filePath, std::string& error) const {
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file) {
+        error = "Failed to open layer timing file: " + filePath;
+        return false;
+    }
+    file << "Slice,Intensity,PlannedExposureMs,ExposureMs,PlannedDarkMs,DarkMs,MoveMs,SliceReadyMs,SettingsMs,PositionMm,DarkPhaseEnd\n";
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (const LayerTiming& layer : layers) {
+        file << layer.sliceIndex << "," << layer.intensity << "," << layer.plannedExposureMs << "," << layer.actualExposureMs << ","
+            << layer.plannedDarkMs << "," << layer.actualDarkMs << "," << layer.moveMs << "," << layer.sliceReadyMs << ","
+            << layer.settingsMs << ",";
+        if (layer.positionValid) {
+            file << layer.positionMm;
+        }
+        file << "," << darkPhaseEndName(layer.darkPhaseEnd) << "\n";
+    }
+    if (!file) {
+        error = "Failed to write layer timing file: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+bool LayerReport::writeSummary(const std::string& filePath, std::string& error) const {
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file) {
+        error = "Failed to open layer timing summary: " + filePath;
+        return false;
+    }
+    for (const std::string& line : summary()) {
+        file << line << "\n";
+    }
+    if (!file) {
+        error = "Failed to write layer timing summary: " + filePath;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,287 @@
+
+#include "LayerSettingsParser.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    std::string_view trim(std::string_view text) {
+        size_t begin = 0, end = text.size();
+        while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+            begin++;
+        }
+        while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+            end--;
+        }
+        return text.substr(begin, end - begin);
+    }
+
+    // Splits a row at the commas without allocating, the fields point into the row
+    void splitFields(std::string_view row, std::vector<std::string_view>& fields) {
+        fields.clear();
+        size_t start = 0;
+        while (true) {
+            size_t comma = row.find(',', start);
+            if (comma == std::string_view::npos) {
+                fields.push_back(trim(row.substr(start)));
+                return;
+            }
+            fields.push_back(trim(row.substr(start, comma - start)));
+            start = comma + 1;
+        }
+    }
+
+    template <typename T>
+    bool parseNumber(std::string_view field, T& value) {
+        const char* end = field.data() + field.size();
+        auto result = std::from_chars(field.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    // Lower case letters and digits of a header name up to its unit, "Dark Time (ms)" becomes darktime
+    std::string columnName(std::string_view text) {
+        std::string result;
+        for (char c : text.substr(0, text.find_first_of("(["))) {
+            if (std::isalnum(static_cast<unsigned char>(c))) {
+                result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+            }
+        }
+        return result;
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    parseLayerSettings
+Parameters:
+    std::string_view text: Contents of the settings CSV
+    LayerSettingsFile& result: Receives the runs, the rejected rows and the warnings
+Returns:
+    bool: True if the header is usable, the rows may still contain errors
+Description:
+    Single pass over the rows. Each row is checked on its own: field count, numbers that parse completely, intensity 0 to 255,
+    positive exposure or dose, non-negative dark time, a valid intensity profile, positive step size, velocity and acceleration, a
+    non-negative pumping distance and a layer number following the previous one. Empty motion fields fall back to the job settings. A
+    rejected row is reported with its line number and skipped. An accepted row extends the last run if the settings are unchanged and
+    the layer follows directly, otherwise it starts a new run, so settings that return later in the file stay at their own layers.
+    Unknown columns and gaps in the layer numbering only produce warnings, they do not change which settings a layer gets.
+Notes:
+    - Rows are split in place and numbers read with from_chars, a file with a million rows parses in a fraction of a second.
+***************************************************************************************************************************************/
+
+bool parseLayerSettings(std::string_view text, LayerSettingsFile& result) {
+    result = LayerSettingsFile();
+
+    size_t lineNumber = 0;
+    size_t position = 0;
+    auto nextLine = [&](std::string_view& line) {
+        if (position >= text.size()) {
+            return false;
+        }
+        size_t newline = text.find('\n', position);
+        size_t end = newline == std::string_view::npos ? text.size() : newline;
+        line = text.substr(position, end - position);
+        position = end + 1;
+        lineNumber++;
+        return true;
+    };
+    auto error = [&](const std::string& message) {
+        result.errors.push_back({ lineNumber, message });
+    };
+    auto warning = [&](const std::string& message) {
+        result.warnings.push_back({ lineNumber, message });
+    };
+
+    // Header
+    std::string_view line;
+    if (!nextLine(line)) {
+        result.errors.push_back({ 1, "File is empty" });
+        return false;
+    }
+    std::vector<std::string_view> fields;
+    splitFields(line, fields);
+    int layerColumn = -1, intensityColumn = -1, exposureColumn = -1, darkColumn = -1, doseColumn = -1, profileColumn = -1;
+    int stepColumn = -1, velocityColumn = -1, accelerationColumn = -1, pumpingColumn = -1;
+    std::vector<size_t> unknownColumns;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        std::string name = columnName(fields[i]);
+        int column = static_cast<int>(i);
+        if (name == "layer") layerColumn = column;
+        else if (name == "intensity") intensityColumn = column;
+        else if (name == "exposuretime" || name == "exposure") exposureColumn = column;
+        else if (name == "darktime" || name == "dark") darkColumn = column;
+        else if (name == "dose") doseColumn = column;
+        else if (name == "profile") profileColumn = column;
+        else if (name == "stepsize" || name == "step") stepColumn = column;
+        else if (name == "velocity") velocityColumn = column;
+        else if (name == "acceleration") accelerationColumn = column;
+        else if (name == "pumpingdistance" || name == "pumping") pumpingColumn = column;
+        else unknownColumns.push_back(i);
+    }
+    bool doseMode = doseColumn >= 0;
+    bool named = layerColumn >= 0 && darkColumn >= 0 && (doseMode || (intensityColumn >= 0 && exposureColumn >= 0));
+    if (!named && !doseMode && fields.size() >= 4) {
+        // Older files were read by position, their header was only skipped
+        warning("Header names not recognised, reading Layer, Intensity, ExposureTime and DarkTime from the first four columns");
+        layerColumn = 0;
+        intensityColumn = 1;
+        exposureColumn = 2;
+        darkColumn = 3;
+        profileColumn = fields.size() > 4 ? 4 : -1;
+        stepColumn = velocityColumn = accelerationColumn = pumpingColumn = -1;
+        unknownColumns.clear();
+        named = true;
+    }
+    for (size_t i : unknownColumns) {
+        warning("Unknown column \"" + std::string(fields[i]) + "\" is ignored");
+    }
+    if (!named) {
+        error("Header needs Layer, DarkTime and either Intensity and ExposureTime or Dose");
+        return false;
+    }
+    size_t columnCount = fields.size();
+    if (profileColumn < 0) {
+        profileColumn = static_cast<int>(columnCount++); // An unnamed trailing column holds the profile
+    }
+    size_t requiredColumns = static_cast<size_t>(std::max({ layerColumn, darkColumn, doseMode ? doseColumn : std::max(intensityColumn, exposureColumn) })) + 1;
+
+    int previousLayer = 0;
+    bool hasPrevious = false;
+    bool gapReported = false;
+    std::string lastProfile;
+    bool lastProfileValid = true;
+
+    while (nextLine(line)) {
+        if (trim(line).empty()) {
+            continue;
+        }
+        splitFields(line, fields);
+        if (fields.size() < requiredColumns || fields.size() > columnCount) {
+            error("Expected " + std::to_string(columnCount) + " fields, found " + std::to_string(fields.size()));
+            continue;
+        }
+        auto field = [&](int column) { return column >= 0 && static_cast<size_t>(column) < fields.size() ? fields[column] : std::string_view(); };
+
+        int layer = 0, intensity = -1, exposureTime = 0, darkTime = 0;
+        double dose = 0.0;
+        if (!parseNumber(field(layerColumn), layer)) {
+            error("Layer is not a number");
+            continue;
+        }
+        if (!parseNumber(field(darkColumn), darkTime) || darkTime < 0) {
+            error("DarkTime must be a non-negative number of milliseconds");
+            continue;
+        }
+        if (doseMode) {
+            if (!parseNumber(field(doseColumn), dose) || !(dose > 0.0)) {
+                error("Dose must be a positive number of mJ/cm2");
+                continue;
+            }
+        }
+        else {
+            if (!parseNumber(field(intensityColumn), intensity) || intensity < 0 || intensity > 255) {
+                error("Intensity must be a number from 0 to 255");
+                continue;
+            }
+            if (!parseNumber(field(exposureColumn), exposureTime) || exposureTime <= 0) {
+                error("ExposureTime must be a positive number of frames");
+                continue;
+            }
+        }
+
+        // Optional motion values, an empty field keeps the job setting
+        auto optionalNumber = [&](int column, std::optional<float>& value, bool allowZero) {
+            std::string_view text = field(column);
+            if (text.empty()) {
+                return true;
+            }
+            float number = 0.0f;
+            if (!parseNumber(text, number) || !std::isfinite(number) || number < 0.0f || (number == 0.0f && !allowZero)) {
+                return false;
+            }
+            value = number;
+            return true;
+        };
+        std::optional<float> stepSize;
+        LayerMotion motion;
+        if (!optionalNumber(stepColumn, stepSize, false)) {
+            error("StepSize must be a positive number of mm");
+            continue;
+        }
+        if (!optionalNumber(velocityColumn, motion.velocity, false)) {
+            error("Velocity must be a positive number of mm/s");
+            continue;
+        }
+        if (!optionalNumber(accelerationColumn, motion.acceleration, false)) {
+            error("Acceleration must be a positive number of mm/s2");
+            continue;
+        }
+        if (!optionalNumber(pumpingColumn, motion.pumpingDistance, true)) {
+            error("PumpingDistance must be a non-negative number of mm");
+            continue;
+        }
+
+        std::string_view profile = field(profileColumn);
+        if (!profile.empty() && profile != lastProfile) {
+            IntensityProfile parsed;
+            std::string profileError;
+            lastProfile = std::string(profile);
+            lastProfileValid = parseIntensityProfile(lastProfile, parsed, profileError);
+            if (!lastProfileValid) {
+                error("Invalid profile: " + profileError);
+                continue;
+            }
+        }
+        else if (!profile.empty() && !lastProfileValid) {
+            error("Invalid profile");
+            continue;
+        }
+
+        if (hasPrevious && layer <= previousLayer) {
+            error("Layer " + std::to_string(layer) + " does not follow layer " + std::to_string(previousLayer));
+            continue;
+        }
+        bool follows = !hasPrevious || layer == previousLayer + 1;
+        if (!follows && !gapReported) {
+            // Layers are printed in file order, a gap in the numbering does not leave slices unexposed
+            warning("Layers " + std::to_string(previousLayer + 1) + " to " + std::to_string(layer - 1) + " are missing, numbering continues");
+            gapReported = true;
+        }
+        previousLayer = layer;
+        hasPrevious = true;
+        result.rows++;
+
+        if (!result.runs.empty()) {
+            LayerSettingsRun& last = result.runs.back();
+            const LayerSettings& s = last.settings;
+            if (follows && s.intensity == intensity && s.exposureTime == exposureTime && s.darkTime == darkTime && s.dose == dose &&
+                s.profile == profile && s.stepSize == stepSize && s.motion == motion) {
+                last.layerCount++;
+                continue;
+            }
+        }
+        LayerSettings settings(intensity, exposureTime, darkTime, dose, std::string(profile));
+        settings.stepSize = stepSize;
+        settings.motion = motion;
+        result.runs.push_back({ settings, layer, 1 });
+    }
+
+    return true;
+}
+
+bool readLayerSettings(const std::string& filePath, LayerSettingsFile& result) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        result = LayerSettingsFile();
+        result.errors.push_back({ 0, "Failed to open " + filePath });
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    return parseLayerSettings(text, result);
+}
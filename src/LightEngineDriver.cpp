@@ -0,0 +1,252 @@
+
+#include "LightEngineDriver.h"
+#include "LightEngineTrace.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX // Windows.h would otherwise replace std::max
+#include "LibUSB3DPrinter.h" // Include the provided header file
+#endif
+
+namespace {
+    std::unique_ptr<LightEngineDriver>& driverInstance() {
+        static std::unique_ptr<LightEngineDriver> driver;
+        return driver;
+    }
+
+    std::mutex& driverInstanceMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    lightEngine
+Parameters:
+    None
+Returns:
+    LightEngineDriver&: Driver all light engine commands go through
+Description:
+    Creates the driver on first use. On Windows the LibUSB3DPrinter DLL drives the SM12 unless the environment variable
+    LIGHT_ENGINE_SIMULATED is set, on other platforms the light engine is always simulated so intensity and exposure code can be run
+    without the SM12. The driver is wrapped in TracingLightEngineDriver, so latency tracing can be switched on
+    at any time through lightEngineTrace().
+***************************************************************************************************************************************/
+
+LightEngineDriver& lightEngine() {
+    std::lock_guard<std::mutex> lock(driverInstanceMutex());
+    std::unique_ptr<LightEngineDriver>& driver = driverInstance();
+    if (!driver) {
+#ifdef _WIN32
+        if (std::getenv("LIGHT_ENGINE_SIMULATED") == nullptr) {
+            driver = std::make_unique<UsbLightEngineDriver>();
+        }
+#endif
+        if (!driver) {
+            std::cout << "Using the simulated light engine." << std::endl;
+            driver = std::make_unique<SimulatedLightEngineDriver>();
+        }
+        driver = std::make_unique<TracingLightEngineDriver>(std::move(driver));
+    }
+    return *driver;
+}
+
+void setLightEngineDriver(std::unique_ptr<LightEngineDriver> driver) {
+    std::lock_guard<std::mutex> lock(driverInstanceMutex());
+    driverInstance() = std::make_unique<TracingLightEngineDriver>(std::move(driver));
+}
+
+#ifdef _WIN32
+//------------------------------------------------------------USB Driver------------------------------------------------------------------
+
+unsigned char UsbLightEngineDriver::enumerateDevices() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return EnumUsbDevice();
+}
+
+void UsbLightEngineDriver::selectDevice(unsigned char index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SetUsbDeviceIndex(index);
+}
+
+bool UsbLightEngineDriver::isOnline() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return CheckUSBOnline() != 0;
+}
+
+bool UsbLightEngineDriver::setPower(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return PowerOnOff(on ? 1 : 0) == 1;
+}
+
+bool UsbLightEngineDriver::setLed(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return LedOnOff(0, on ? 1 : 0);
+}
+
+bool UsbLightEngineDriver::setCurrent(unsigned char value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return SetCurrent(0, static_cast<U8>(value)); // Assuming index 0 for simplicity
+}
+
+bool UsbLightEngineDriver::getCurrent(unsigned char& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    U8 current = 0;
+    bool ok = GetCurrent(0, &current);
+    value = current;
+    return ok;
+}
+
+bool UsbLightEngineDriver::getLedDefaultStatus(bool& on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    U8 flag = 0;
+    bool ok = GetLedDefaultStatus(&flag);
+    on = flag != 0;
+    return ok;
+}
+
+bool UsbLightEngineDriver::setLedDefaultStatus(bool on) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return SetLedDefaultStatus(on ? 1 : 0);
+}
+
+unsigned char UsbLightEngineDriver::getStatus() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return GetStatus();
+}
+
+unsigned char UsbLightEngineDriver::getSysStatus() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return GetSysStatus();
+}
+
+bool UsbLightEngineDriver::getTemperature(int16_t& celsius) {
+    std::lock_guard<std::mutex> lock(mutex);
+    S16 temperature = 0;
+    bool ok = GetTemperature(&temperature);
+    celsius = temperature;
+    return ok;
+}
+#endif
+
+//---------------------------------------------------------Simulated Driver---------------------------------------------------------------
+
+SimulatedLightEngineDriver::SimulatedLightEngineDriver(const SimulatedLightEngineSettings& settings)
+    : settings(settings), temperature(settings.ambientTemperature),
+    powerOnTime(std::chrono::steady_clock::now()), lastUpdate(std::chrono::steady_clock::now()) {
+}
+
+/**************************************************************************************************************************************
+Function:
+    SimulatedLightEngineDriver::command
+Parameters:
+    None
+Returns:
+    std::unique_lock<std::mutex>: Lock on the simulated state, held by the caller for the rest of the command
+Description:
+    Every simulated command holds the lock for the configured USB round trip, so commands from several threads queue up behind each
+    other as they do on the single USB handle, then advances the thermal model to the current time. The
+    temperature follows a first-order lag towards ambient plus heatingPerCurrent times the current while the lit LED is powered, so
+    long high-intensity runs drift upwards and cool down again during idle periods.
+***************************************************************************************************************************************/
+
+std::unique_lock<std::mutex> SimulatedLightEngineDriver::command() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (settings.commandLatencyMs > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(settings.commandLatencyMs));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - lastUpdate).count();
+    lastUpdate = now;
+
+    double target = settings.ambientTemperature;
+    if (powered && ledOn && isReady()) {
+        target += settings.heatingPerCurrent * current;
+    }
+    double alpha = 1.0 - std::exp(-dt / std::max(1e-3, settings.thermalTimeConstantSeconds));
+    temperature += (target - temperature) * alpha;
+
+    return lock;
+}
+
+bool SimulatedLightEngineDriver::isReady() const {
+    return powered &&
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - powerOnTime).count() >= settings.warmUpSeconds;
+}
+
+unsigned char SimulatedLightEngineDriver::enumerateDevices() {
+    auto lock = command();
+    return 1;
+}
+
+void SimulatedLightEngineDriver::selectDevice(unsigned char) {
+    auto lock = command();
+}
+
+bool SimulatedLightEngineDriver::isOnline() {
+    auto lock = command();
+    return true;
+}
+
+bool SimulatedLightEngineDriver::setPower(bool on) {
+    auto lock = command();
+    if (on && !powered) {
+        powerOnTime = std::chrono::steady_clock::now();
+    }
+    powered = on;
+    return true;
+}
+
+bool SimulatedLightEngineDriver::setLed(bool on) {
+    auto lock = command();
+    ledOn = on;
+    return true;
+}
+
+bool SimulatedLightEngineDriver::setCurrent(unsigned char value) {
+    auto lock = command();
+    current = value;
+    return true;
+}
+
+bool SimulatedLightEngineDriver::getCurrent(unsigned char& value) {
+    auto lock = command();
+    value = current;
+    return true;
+}
+
+bool SimulatedLightEngineDriver::getLedDefaultStatus(bool& on) {
+    auto lock = command();
+    on = ledDefault;
+    return true;
+}
+
+bool SimulatedLightEngineDriver::setLedDefaultStatus(bool on) {
+    auto lock = command();
+    ledDefault = on;
+    return true;
+}
+
+unsigned char SimulatedLightEngineDriver::getStatus() {
+    auto lock = command();
+    return powered ? 1 : 0;
+}
+
+unsigned char SimulatedLightEngineDriver::getSysStatus() {
+    auto lock = command();
+    if (!powered) {
+        return 0;
+    }
+    return isReady() ? 1 : 4;
+}
+
+bool SimulatedLightEngineDriver::getTemperature(int16_t& celsius) {
+    auto lock = command();
+    celsius = static_cast<int16_t>(std::lround(temperature));
+    return true;
+}
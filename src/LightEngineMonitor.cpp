@@ -0,0 +1,192 @@
+
+#include "LightEngineMonitor.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    uint64_t packStatus(const LightEngineStatus& status) {
+        return static_cast<uint64_t>(status.status) |
+            (static_cast<uint64_t>(status.current) << 8) |
+            (static_cast<uint64_t>(status.sysStatus) << 16) |
+            (static_cast<uint64_t>(status.ledDefaultStatus ? 1 : 0) << 24) |
+            (static_cast<uint64_t>(static_cast<uint16_t>(status.temperature)) << 32);
+    }
+
+    LightEngineStatus unpackStatus(uint64_t packed) {
+        LightEngineStatus status;
+        status.status = static_cast<unsigned char>(packed & 0xFF);
+        status.current = static_cast<unsigned char>((packed >> 8) & 0xFF);
+        status.sysStatus = static_cast<unsigned char>((packed >> 16) & 0xFF);
+        status.ledDefaultStatus = ((packed >> 24) & 1) != 0;
+        status.temperature = static_cast<int16_t>(static_cast<uint16_t>((packed >> 32) & 0xFFFF));
+        return status;
+    }
+}
+
+LightEngineMonitor& lightEngineMonitor() {
+    static LightEngineMonitor monitor;
+    return monitor;
+}
+
+LightEngineMonitor::~LightEngineMonitor() {
+    stop();
+}
+
+/**************************************************************************************************************************************
+Function:
+    LightEngineMonitor::start
+Parameters:
+    Query query: Reads the status of the light engine, called on the monitor thread only
+    const LightEngineMonitorSettings& settings: Poll rate, history length and alarm thresholds
+    AlarmCallback onAlarm: Called on the monitor thread when an alarm is raised, may be empty
+Returns:
+    void
+Description:
+    Starts polling the light engine. A running monitor is stopped first, so the settings can be changed by calling start again.
+Notes:
+    - The alarm callback must not block, GUI code should queue the alarm to its own thread.
+***************************************************************************************************************************************/
+
+void LightEngineMonitor::start(Query query, const LightEngineMonitorSettings& settings, AlarmCallback onAlarm) {
+    stop();
+
+    this->query = query;
+    this->onAlarm = onAlarm;
+    this->settings = settings;
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        ring.assign(std::max<size_t>(1, settings.historySize), LightEngineSample{});
+        ringNext = 0;
+        ringCount = 0;
+    }
+    hasPrevious = false;
+    overTemperature = false;
+
+    running = true;
+    thread = std::thread(&LightEngineMonitor::pollLoop, this);
+}
+
+void LightEngineMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        running = false;
+    }
+    stopSignal.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void LightEngineMonitor::pollLoop() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (running) {
+        lock.unlock();
+        LightEngineSample sample{ std::chrono::system_clock::now(), query() };
+        publish(sample);
+        checkAlarms(sample);
+        lock.lock();
+
+        stopSignal.wait_for(lock, std::chrono::milliseconds(settings.pollIntervalMs), [this]() { return !running; });
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    LightEngineMonitor::publish
+Parameters:
+    const LightEngineSample& sample: New sample
+Returns:
+    void
+Description:
+    Stores the sample as the latest snapshot and appends it to the ring buffer. The snapshot is written under a sequence lock: the
+    counter is odd while the fields change, and readers retry until they saw the same even value before and after reading.
+***************************************************************************************************************************************/
+
+void LightEngineMonitor::publish(const LightEngineSample& sample) {
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    latestStatus.store(packStatus(sample.status), std::memory_order_relaxed);
+    latestTimestamp.store(sample.timestamp.time_since_epoch().count(), std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(historyMutex);
+    ring[ringNext] = sample;
+    ringNext = (ringNext + 1) % ring.size();
+    ringCount = std::min(ringCount + 1, ring.size());
+}
+
+bool LightEngineMonitor::latest(LightEngineSample& sample) const {
+    uint32_t before, after;
+    uint64_t status;
+    int64_t timestamp;
+    do {
+        before = sequence.load(std::memory_order_acquire);
+        status = latestStatus.load(std::memory_order_relaxed);
+        timestamp = latestTimestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+
+    if (before == 0) {
+        return false;
+    }
+    sample.status = unpackStatus(status);
+    sample.timestamp = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(timestamp));
+    return true;
+}
+
+std::vector<LightEngineSample> LightEngineMonitor::history() const {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    std::vector<LightEngineSample> samples;
+    samples.reserve(ringCount);
+    size_t first = (ringNext + ring.size() - ringCount) % std::max<size_t>(1, ring.size());
+    for (size_t i = 0; i < ringCount; ++i) {
+        samples.push_back(ring[(first + i) % ring.size()]);
+    }
+    return samples;
+}
+
+/**************************************************************************************************************************************
+Function:
+    LightEngineMonitor::checkAlarms
+Parameters:
+    const LightEngineSample& sample: New sample
+Returns:
+    void
+Description:
+    Raises OverTemperature once the temperature exceeds the limit and TemperatureRecovered once it has fallen below the limit minus the
+    hysteresis, so a temperature hovering at the limit does not flood the log. StatusChanged is raised whenever the status or system
+    status byte differs from the previous sample.
+***************************************************************************************************************************************/
+
+void LightEngineMonitor::checkAlarms(const LightEngineSample& sample) {
+    std::vector<LightEngineAlarm> alarms;
+    const LightEngineStatus& status = sample.status;
+
+    if (!overTemperature && status.temperature > settings.maxTemperature) {
+        overTemperature = true;
+        alarms.push_back({ LightEngineAlarmType::OverTemperature, sample,
+            "Light engine over temperature: " + std::to_string(status.temperature) + " C" });
+    }
+    else if (overTemperature && status.temperature < settings.maxTemperature - settings.temperatureHysteresis) {
+        overTemperature = false;
+        alarms.push_back({ LightEngineAlarmType::TemperatureRecovered, sample,
+            "Light engine temperature back to " + std::to_string(status.temperature) + " C" });
+    }
+
+    if (hasPrevious && (status.status != previous.status || status.sysStatus != previous.sysStatus)) {
+        alarms.push_back({ LightEngineAlarmType::StatusChanged, sample,
+            "Light engine status changed: status " + std::to_string(previous.status) + " -> " + std::to_string(status.status) +
+            ", system status " + std::to_string(previous.sysStatus) + " -> " + std::to_string(status.sysStatus) });
+    }
+    previous = status;
+    hasPrevious = true;
+
+    for (const LightEngineAlarm& alarm : alarms) {
+        std::cerr << alarm.message << std::endl;
+        if (onAlarm) {
+            onAlarm(alarm);
+        }
+    }
+}
@@ -0,0 +1,145 @@
+
+#include "LiveAdjustment.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+//--------------------------------------------------------Parameter Channel-----------------------------------------------------------------
+
+bool ParameterChannel::submit(ParameterAdjustment& adjustment) {
+    uint32_t print = printId.load(std::memory_order_acquire); // Before the check, a print starting in between drops the adjustment
+    if (!isPrinting()) {
+        return false;
+    }
+    size_t write = head.load(std::memory_order_relaxed);
+    if (write - tail.load(std::memory_order_acquire) >= capacity) {
+        return false;
+    }
+    adjustment.id = nextId.fetch_add(1, std::memory_order_relaxed);
+    adjustment.printId = print;
+    slots[write % capacity] = adjustment;
+    head.store(write + 1, std::memory_order_release); // Publishes the slot
+    return true;
+}
+
+bool ParameterChannel::receive(ParameterAdjustment& adjustment) {
+    uint32_t print = printId.load(std::memory_order_relaxed);
+    size_t read = tail.load(std::memory_order_relaxed);
+    while (read != head.load(std::memory_order_acquire)) {
+        adjustment = slots[read % capacity];
+        tail.store(++read, std::memory_order_release); // Hands the slot back to the GUI
+        if (adjustment.printId == print) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ParameterChannel& parameterChannel() {
+    static ParameterChannel channel;
+    return channel;
+}
+
+//--------------------------------------------------------Journal-----------------------------------------------------------------
+
+ParameterJournal::ParameterJournal(const std::string& filePath) {
+    bool exists = std::filesystem::exists(filePath);
+    file.open(filePath, std::ios::app);
+    if (file && !exists) {
+        file << "Time,Event,Id,Layer,FromLayer,RequestedAtLayer,ExposureFrames,DarkTimeMs,StepSize,Intensity,Reset\n";
+    }
+}
+
+void ParameterJournal::record(const char* event, const ParameterAdjustment& adjustment, size_t layer) {
+    if (!file) {
+        return;
+    }
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    auto value = [](const auto& optional) {
+        std::ostringstream text;
+        if (optional) {
+            text << *optional;
+        }
+        return text.str();
+    };
+    file << std::put_time(&local, "%Y-%m-%d %H:%M:%S") << "," << event << "," << adjustment.id << "," << layer << "," <<
+        adjustment.fromLayer << "," << adjustment.requestedAtLayer << "," << value(adjustment.exposureFrames) << "," <<
+        value(adjustment.darkTimeMs) << "," << value(adjustment.stepSize) << "," << value(adjustment.intensity) << "," <<
+        (adjustment.reset ? 1 : 0) << std::endl; // Flushed, the journal must survive a crash of the print
+}
+
+//--------------------------------------------------------Layer Overrides-----------------------------------------------------------------
+
+void LayerOverrides::add(const ParameterAdjustment& adjustment) {
+    auto position = std::upper_bound(waiting.begin(), waiting.end(), adjustment,
+        [](const ParameterAdjustment& a, const ParameterAdjustment& b) { return a.fromLayer < b.fromLayer; });
+    waiting.insert(position, adjustment);
+}
+
+/**************************************************************************************************************************************
+Function:
+    LayerOverrides::apply
+Parameters:
+    PlannedLayer& layer: Layer about to be exposed, changed in place
+    std::vector<ParameterAdjustment>& activated: Receives the adjustments that take effect at this layer
+Returns:
+    void
+Description:
+    Merges the adjustments whose fromLayer has been reached into the active values, in the order they were submitted, and applies
+    the active values to the layer. An intensity or exposure override turns a dose or profile layer into a constant one, so the
+    operator's value is what the light engine receives; the thermal governor still limits it afterwards.
+***************************************************************************************************************************************/
+
+void LayerOverrides::apply(PlannedLayer& layer, std::vector<ParameterAdjustment>& activated) {
+    size_t due = 0;
+    while (due < waiting.size() && waiting[due].fromLayer <= layer.sliceIndex) {
+        const ParameterAdjustment& adjustment = waiting[due++];
+        if (adjustment.reset) {
+            active = ParameterAdjustment();
+        }
+        if (adjustment.exposureFrames) active.exposureFrames = adjustment.exposureFrames;
+        if (adjustment.darkTimeMs) active.darkTimeMs = adjustment.darkTimeMs;
+        if (adjustment.stepSize) active.stepSize = adjustment.stepSize;
+        if (adjustment.intensity) active.intensity = adjustment.intensity;
+        activated.push_back(adjustment);
+    }
+    waiting.erase(waiting.begin(), waiting.begin() + due);
+
+    if (active.intensity) {
+        layer.intensity = *active.intensity;
+        layer.doseMJ = 0.0;
+        layer.profile.reset();
+    }
+    if (active.exposureFrames) {
+        layer.exposureFrames = *active.exposureFrames;
+        layer.doseMJ = 0.0;
+    }
+    if (active.darkTimeMs) {
+        layer.darkTimeMs = *active.darkTimeMs;
+    }
+    if (active.stepSize) {
+        // Folded empty layers are travelled at the new thickness as well
+        layer.moveDistance = std::copysign(*active.stepSize, layer.moveDistance) * static_cast<float>(1 + layer.foldedEmptyLayers);
+    }
+}
+
+std::string describeAdjustment(const ParameterAdjustment& adjustment) {
+    std::ostringstream text;
+    text << "#" << adjustment.id;
+    if (adjustment.reset) text << " plan values";
+    if (adjustment.exposureFrames) text << " exposure " << *adjustment.exposureFrames << " frames";
+    if (adjustment.darkTimeMs) text << " dark time " << *adjustment.darkTimeMs << " ms";
+    if (adjustment.stepSize) text << " step " << *adjustment.stepSize << " mm";
+    if (adjustment.intensity) text << " intensity " << *adjustment.intensity;
+    return text.str();
+}
@@ -0,0 +1,227 @@
+
+#include "MeshSlicer.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+/**************************************************************************************************************************************
+Function:
+    loadStl
+Parameters:
+    const std::string& filePath: STL file, binary or ASCII
+    std::vector<MeshTriangle>& triangles: Receives the triangles of the mesh
+    std::string& error: Reason of the failure if the function returns false
+Returns:
+    bool: True if the mesh was read
+Description:
+    Reads an STL mesh. A file whose size matches the triangle count in its header is treated as binary, otherwise it is parsed as
+    ASCII STL by collecting the "vertex" lines. Normals are ignored, the slicer only needs the vertex positions.
+Notes:
+    - Binary files may also start with "solid", so the size check decides the format and not the header text.
+***************************************************************************************************************************************/
+
+bool loadStl(const std::string& filePath, std::vector<MeshTriangle>& triangles, std::string& error) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        error = "Cannot open mesh file: " + filePath;
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    triangles.clear();
+
+    if (data.size() >= 84) {
+        uint32_t count;
+        std::memcpy(&count, data.data() + 80, sizeof(count));
+        if (84 + static_cast<uint64_t>(count) * 50 == data.size()) {
+            triangles.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                // 12 bytes normal, 36 bytes vertices, 2 bytes attribute count
+                std::memcpy(triangles[i].v, data.data() + 84 + static_cast<size_t>(i) * 50 + 12, sizeof(triangles[i].v));
+            }
+            return true;
+        }
+    }
+
+    if (data.size() < 5 || std::string(data.data(), 5) != "solid") {
+        error = "Not a valid STL file: " + filePath;
+        return false;
+    }
+
+    std::istringstream text(std::string(data.begin(), data.end()));
+    std::string token;
+    MeshTriangle triangle;
+    int vertex = 0;
+    while (text >> token) {
+        if (token != "vertex") {
+            continue;
+        }
+        if (!(text >> triangle.v[vertex][0] >> triangle.v[vertex][1] >> triangle.v[vertex][2])) {
+            error = "Malformed vertex in STL file: " + filePath;
+            return false;
+        }
+        if (++vertex == 3) {
+            triangles.push_back(triangle);
+            vertex = 0;
+        }
+    }
+
+    if (triangles.empty()) {
+        error = "STL file contains no triangles: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************************************************************************************
+Function:
+    MeshSliceSource::MeshSliceSource
+Parameters:
+    const std::vector<MeshTriangle>& triangles, const SliceSourceSettings& settings, const std::string& name
+Returns:
+    None
+Description:
+    Prepares the mesh for slicing. The mesh is centred on the projector image and its lowest point becomes the bottom of the first
+    layer. Every layer is sampled at its mid-height, and each triangle is registered with all layers whose sampling plane it crosses,
+    so slicing a layer only touches the triangles that actually contribute to it.
+***************************************************************************************************************************************/
+
+MeshSliceSource::MeshSliceSource(const std::vector<MeshTriangle>& triangles, const SliceSourceSettings& settings, const std::string& name)
+    : triangles(triangles), settings(settings), name(name) {
+
+    float lo[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float hi[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+    for (const MeshTriangle& t : triangles) {
+        for (int v = 0; v < 3; ++v) {
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], t.v[v][a]);
+                hi[a] = std::max(hi[a], t.v[v][a]);
+            }
+        }
+    }
+    if (triangles.empty() || settings.layerHeight <= 0.0f) {
+        return;
+    }
+
+    minZ = lo[2];
+    centerX = 0.5f * (lo[0] + hi[0]);
+    centerY = 0.5f * (lo[1] + hi[1]);
+
+    const float h = settings.layerHeight;
+    size_t layers = static_cast<size_t>(std::ceil((hi[2] - lo[2]) / h));
+    layerTriangles.resize(layers);
+
+    for (uint32_t i = 0; i < triangles.size(); ++i) {
+        const MeshTriangle& t = triangles[i];
+        float zLo = std::min({ t.v[0][2], t.v[1][2], t.v[2][2] });
+        float zHi = std::max({ t.v[0][2], t.v[1][2], t.v[2][2] });
+
+        // Layers whose sampling plane z = minZ + (layer + 0.5) * h lies in [zLo, zHi)
+        long first = static_cast<long>(std::ceil((zLo - minZ) / h - 0.5f));
+        long last = static_cast<long>(std::ceil((zHi - minZ) / h - 0.5f)) - 1;
+        first = std::max(first, 0L);
+        last = std::min(last, static_cast<long>(layers) - 1);
+        for (long layer = first; layer <= last; ++layer) {
+            layerTriangles[layer].push_back(i);
+        }
+    }
+}
+
+std::shared_ptr<MeshSliceSource> MeshSliceSource::open(const std::string& filePath, const SliceSourceSettings& settings, std::string& error) {
+    std::string extension = fs::path(filePath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".3mf") {
+        error = "3MF meshes are not supported, export the mesh as STL: " + filePath;
+        return nullptr;
+    }
+    if (settings.layerHeight <= 0.0f || settings.pixelSize <= 0.0f) {
+        error = "Layer height and pixel size must be positive to slice a mesh.";
+        return nullptr;
+    }
+
+    std::vector<MeshTriangle> triangles;
+    if (!loadStl(filePath, triangles, error)) {
+        return nullptr;
+    }
+    return std::make_shared<MeshSliceSource>(triangles, settings, fs::path(filePath).filename().string());
+}
+
+std::string MeshSliceSource::layerName(size_t index) const {
+    return name + " layer " + std::to_string(index);
+}
+
+/**************************************************************************************************************************************
+Function:
+    MeshSliceSource::sliceLayer
+Parameters:
+    size_t index: Layer to slice
+    std::vector<EdgeSegment>& edges: Receives the contour edges in pixel coordinates
+Returns:
+    void
+Description:
+    Intersects every triangle registered with the layer with its sampling plane. Each triangle crossing the plane contributes exactly
+    one edge, and the set of edges forms the closed contours of the layer. Millimetres are converted to pixels around the image centre,
+    with y pointing down as in the exported slice images.
+***************************************************************************************************************************************/
+
+void MeshSliceSource::sliceLayer(size_t index, std::vector<EdgeSegment>& edges) const {
+    edges.clear();
+    if (index >= layerTriangles.size()) {
+        return;
+    }
+
+    const float z = minZ + (static_cast<float>(index) + 0.5f) * settings.layerHeight;
+    const float scale = 1.0f / settings.pixelSize;
+    const float offsetX = 0.5f * settings.width;
+    const float offsetY = 0.5f * settings.height;
+
+    edges.reserve(layerTriangles[index].size());
+    for (uint32_t triangleIndex : layerTriangles[index]) {
+        const MeshTriangle& t = triangles[triangleIndex];
+        float points[2][2];
+        int found = 0;
+        for (int e = 0; e < 3 && found < 2; ++e) {
+            const float* a = t.v[e];
+            const float* b = t.v[(e + 1) % 3];
+            if ((a[2] < z) == (b[2] < z)) {
+                continue;
+            }
+            float s = (z - a[2]) / (b[2] - a[2]);
+            points[found][0] = (a[0] + s * (b[0] - a[0]) - centerX) * scale + offsetX;
+            points[found][1] = offsetY - (a[1] + s * (b[1] - a[1]) - centerY) * scale;
+            found++;
+        }
+        if (found == 2) {
+            edges.push_back(EdgeSegment{ points[0][0], points[0][1], points[1][0], points[1][1] });
+        }
+    }
+}
+
+bool MeshSliceSource::loadLayer(size_t index, sf::Image& image) const {
+    std::vector<EdgeSegment> edges;
+    SliceBitmap bitmap;
+    sliceLayer(index, edges);
+    rasterizeEvenOdd(edges, settings.width, settings.height, bitmap);
+    image.create(bitmap.width, bitmap.height, bitmap.data());
+    return true;
+}
+
+SliceInfo MeshSliceSource::inspectLayer(size_t index) const {
+    // A layer no triangle crosses is empty without rasterizing it
+    if (index >= layerTriangles.size() || layerTriangles[index].empty()) {
+        return SliceInfo{ 0, true, true };
+    }
+    // The lit pixels are counted from the spans of the scanlines, the layer's image is only built for the print
+    std::vector<EdgeSegment> edges;
+    sliceLayer(index, edges);
+    size_t lit = countEvenOdd(edges, settings.width, settings.height);
+    return SliceInfo{ lit, lit == 0, true };
+}
@@ -0,0 +1,280 @@
+
+#include "Metrics.h"
+#include "EventLog.h"
+#include "LightEngineMonitor.h"
+#include "LiveAdjustment.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+//--------------------------------------------------------Metrics-----------------------------------------------------------------
+
+MetricHistogram::MetricHistogram(std::vector<double> upperBounds)
+    : bounds(std::move(upperBounds)), buckets(new std::atomic<uint64_t>[bounds.size() + 1]) {
+    std::sort(bounds.begin(), bounds.end());
+    for (size_t index = 0; index <= bounds.size(); ++index) {
+        buckets[index].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value) {
+    size_t index = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin(); // Buckets include their upper bound
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    valueSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+MetricsRegistry::Family* MetricsRegistry::find(const std::string& name, Type type) {
+    for (auto& family : families) {
+        if (family->name == name) {
+            if (family->type != type) {
+                std::cerr << "Metric " << name << " is already registered with another type" << std::endl;
+            }
+            return family->type == type ? family.get() : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Family* family = find(name, Type::Counter)) {
+        return *family->counter;
+    }
+    families.push_back(std::make_unique<Family>(Family{ name, help, Type::Counter, std::make_unique<MetricCounter>(), nullptr, nullptr }));
+    return *families.back()->counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Family* family = find(name, Type::Gauge)) {
+        return *family->gauge;
+    }
+    families.push_back(std::make_unique<Family>(Family{ name, help, Type::Gauge, nullptr, std::make_unique<MetricGauge>(), nullptr }));
+    return *families.back()->gauge;
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, std::vector<double> upperBounds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Family* family = find(name, Type::Histogram)) {
+        return *family->histogram;
+    }
+    families.push_back(std::make_unique<Family>(Family{ name, help, Type::Histogram, nullptr, nullptr,
+        std::make_unique<MetricHistogram>(std::move(upperBounds)) }));
+    return *families.back()->histogram;
+}
+
+void MetricsRegistry::addCollector(std::function<void()> collect) {
+    std::lock_guard<std::mutex> lock(mutex);
+    collectors.push_back(std::move(collect));
+}
+
+/**************************************************************************************************************************************
+Function:
+    MetricsRegistry::exposition
+Parameters:
+    void
+Returns:
+    std::string: All metrics in the Prometheus text exposition format, version 0.0.4
+Description:
+    Runs the collectors, then writes HELP and TYPE of each metric followed by its samples. Histograms are written as cumulative
+    _bucket samples with an le label, _sum and _count.
+***************************************************************************************************************************************/
+
+std::string MetricsRegistry::exposition() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& collect : collectors) {
+        collect();
+    }
+
+    auto number = [](double value) {
+        if (std::isinf(value)) {
+            return std::string(value > 0 ? "+Inf" : "-Inf");
+        }
+        std::ostringstream text;
+        text.precision(15);
+        text << value;
+        return text.str();
+    };
+
+    std::ostringstream text;
+    for (const auto& family : families) {
+        static const char* typeNames[] = { "counter", "gauge", "histogram" };
+        text << "# HELP " << family->name << " " << family->help << "\n";
+        text << "# TYPE " << family->name << " " << typeNames[static_cast<int>(family->type)] << "\n";
+        switch (family->type) {
+        case Type::Counter:
+            text << family->name << " " << family->counter->get() << "\n";
+            break;
+        case Type::Gauge:
+            text << family->name << " " << number(family->gauge->get()) << "\n";
+            break;
+        case Type::Histogram: {
+            const MetricHistogram& histogram = *family->histogram;
+            uint64_t cumulative = 0;
+            for (size_t index = 0; index <= histogram.upperBounds().size(); ++index) {
+                cumulative += histogram.bucket(index);
+                double bound = index < histogram.upperBounds().size() ? histogram.upperBounds()[index] : INFINITY;
+                text << family->name << "_bucket{le=\"" << number(bound) << "\"} " << cumulative << "\n";
+            }
+            // Read after the buckets, so a concurrent observation never makes _count smaller than the +Inf bucket
+            text << family->name << "_sum " << number(histogram.sum()) << "\n";
+            text << family->name << "_count " << std::max(cumulative, histogram.count()) << "\n";
+            break;
+        }
+        }
+    }
+    return text.str();
+}
+
+bool MetricsRegistry::writeFile(const std::string& filePath, std::string& error) const {
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file) {
+        error = "Failed to open metrics file: " + filePath;
+        return false;
+    }
+    file << exposition();
+    if (!file) {
+        error = "Failed to write metrics file: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+MetricsRegistry& metricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+//--------------------------------------------------------Printer Metrics-----------------------------------------------------------------
+
+namespace {
+
+// Seconds, from a few ms for the serial and USB calls to the minutes a slow move with pumping can take
+const std::vector<double> durationBounds = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60 };
+// Seconds either side of the plan, a frame at 30 fps is 0.033 s
+const std::vector<double> phaseErrorBounds = { -0.1, -0.05, -0.033, -0.01, 0, 0.01, 0.033, 0.05, 0.1, 0.25, 0.5, 1 };
+
+}
+
+PrinterMetrics::PrinterMetrics(MetricsRegistry& registry)
+    : layerCycle(registry.histogram("clip_layer_cycle_seconds", "Start of one exposure to the start of the next", durationBounds)),
+    lightPhaseError(registry.histogram("clip_light_phase_error_seconds", "Measured minus planned exposure time", phaseErrorBounds)),
+    darkPhaseError(registry.histogram("clip_dark_phase_error_seconds", "Measured minus planned dark time", phaseErrorBounds)),
+    moveDuration(registry.histogram("clip_stage_move_seconds", "Stage move between two layers including pumping", durationBounds)),
+    serialRoundTrip(registry.histogram("clip_stage_serial_rtt_seconds", "Position query round trip to the stage controller", durationBounds)),
+    sliceDecode(registry.histogram("clip_slice_decode_seconds", "Loading and uploading the next slice", durationBounds)),
+    layersExposed(registry.counter("clip_layers_exposed_total", "Layers exposed since the program started")),
+    printsStarted(registry.counter("clip_prints_started_total", "Prints started since the program started")),
+    printsAborted(registry.counter("clip_prints_aborted_total", "Prints aborted by the operator")),
+    currentLayer(registry.gauge("clip_current_layer", "Slice index of the layer being printed")),
+    layerCount(registry.gauge("clip_layer_count", "Slices of the running print")),
+    engineTemperature(registry.gauge("clip_light_engine_temperature_celsius", "Latest light engine temperature")),
+    eventQueueDepth(registry.gauge("clip_event_queue_depth", "Print events waiting for the event log writer")),
+    eventsDropped(registry.gauge("clip_events_dropped", "Print events dropped by the running event log")),
+    adjustmentQueueDepth(registry.gauge("clip_adjustment_queue_depth", "Parameter adjustments waiting for the print loop")) {
+    registry.addCollector([this]() {
+        LightEngineSample sample;
+        if (lightEngineMonitor().latest(sample)) {
+            engineTemperature.set(sample.status.temperature);
+        }
+        eventQueueDepth.set(static_cast<double>(eventLog().depth()));
+        eventsDropped.set(static_cast<double>(eventLog().droppedEvents()));
+        adjustmentQueueDepth.set(static_cast<double>(parameterChannel().depth()));
+    });
+}
+
+PrinterMetrics& printerMetrics() {
+    static PrinterMetrics metrics(metricsRegistry());
+    return metrics;
+}
+
+//--------------------------------------------------------Server-----------------------------------------------------------------
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(unsigned short port, std::string& error) {
+    if (isRunning()) {
+        return true;
+    }
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done) {
+        error = "Failed to listen for metrics on port " + std::to_string(port);
+        return false;
+    }
+    printerMetrics(); // Registered before the first scrape, so every metric is listed from the start
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&MetricsServer::serveLoop, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    running.store(false, std::memory_order_release);
+    thread.join();
+    listener.close();
+}
+
+void MetricsServer::serveLoop() {
+    sf::SocketSelector selector;
+    selector.add(listener);
+    while (isRunning()) {
+        // The timeout bounds how long stop waits for this thread
+        if (!selector.wait(sf::milliseconds(200)) || !selector.isReady(listener)) {
+            continue;
+        }
+        sf::TcpSocket client;
+        if (listener.accept(client) == sf::Socket::Done) {
+            respond(client);
+        }
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    MetricsServer::respond
+Parameters:
+    sf::TcpSocket& client: Accepted connection
+Returns:
+    void
+Description:
+    Reads the request head and answers GET /metrics with the exposition, anything else with 404. One request per connection,
+    a client that sends nothing for a second is dropped so a stuck scraper cannot block the next one.
+***************************************************************************************************************************************/
+
+void MetricsServer::respond(sf::TcpSocket& client) {
+    sf::SocketSelector selector;
+    selector.add(client);
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        std::size_t received = 0;
+        if (!selector.wait(sf::seconds(1)) || client.receive(buffer, sizeof(buffer), received) != sf::Socket::Done) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    std::string status = "404 Not Found";
+    std::string body = "Metrics are served at /metrics\n";
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET /metrics?", 0) == 0) {
+        status = "200 OK";
+        body = metricsRegistry().exposition();
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+    client.send(response.data(), response.size());
+    client.disconnect();
+}
+
+MetricsServer& metricsServer() {
+    static MetricsServer server;
+    return server;
+}
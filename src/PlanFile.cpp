@@ -0,0 +1,412 @@
+
+#include "PlanFile.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char planFileMagic[8] = { 'C', 'L', 'I', 'P', 'P', 'L', 'A', 'N' };
+
+    uint64_t alignTo8(uint64_t value) {
+        return (value + 7) & ~uint64_t(7);
+    }
+
+    // True if count elements of the given size starting at offset lie within a file of fileSize bytes
+    bool tableFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+        return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    }
+
+    float optionalValue(const std::optional<float>& value) {
+        return value ? *value : std::numeric_limits<float>::quiet_NaN();
+    }
+
+    std::optional<float> optionalValue(float value) {
+        return std::isnan(value) ? std::optional<float>() : std::optional<float>(value);
+    }
+
+    // Size and last write time of a slice file as stored in PlanFileSlice, false if the file cannot be read
+    bool sliceFileStatus(const std::string& path, uint64_t& size, int64_t& modifiedTime) {
+        std::error_code status;
+        size = fs::file_size(path, status);
+        if (status) {
+            return false;
+        }
+        fs::file_time_type written = fs::last_write_time(path, status);
+        if (status) {
+            return false;
+        }
+        modifiedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(written.time_since_epoch()).count();
+        return true;
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    writePlanFile
+Parameters:
+    const std::string& filePath: File to create, an existing file is replaced
+    const PrintPlan& plan: Complete plan, streaming plans cannot be compiled
+    uint32_t flags: PlanFileFlags describing how the plan was prepared
+    float frameRate: Display rate used for the timing estimates
+    std::string& error: Reason the plan could not be written
+Returns:
+    bool: True once the file is complete
+Description:
+    Lays the file out as header, layer records, slice table, profile segments and slice names. Identical profile pointers share
+    their segments, so a profile used by a whole group of layers is stored once. The file is written under a temporary name and
+    renamed when complete, a reader never maps a half-written plan.
+***************************************************************************************************************************************/
+
+bool writePlanFile(const std::string& filePath, const PrintPlan& plan, uint32_t flags, float frameRate, std::string& error) {
+    if (!plan.source) {
+        error = "Plan has no slice source";
+        return false;
+    }
+    if (plan.extend) {
+        error = "A plan that is still being sliced cannot be compiled";
+        return false;
+    }
+    const SliceSource& source = *plan.source;
+    size_t sliceCount = source.layerCount();
+
+    std::vector<PlanFileRecord> records;
+    records.reserve(plan.layers.size());
+    std::vector<PlanFileSegment> segments;
+    std::unordered_map<const IntensityProfile*, uint32_t> profileOffsets;
+    int64_t startMs = 0;
+
+    for (const PlannedLayer& layer : plan.layers) {
+        if (layer.sliceIndex >= sliceCount) {
+            error = "Layer references slice " + std::to_string(layer.sliceIndex) + " of " + std::to_string(sliceCount);
+            return false;
+        }
+
+        PlanFileRecord record{};
+        record.sliceIndex = static_cast<uint32_t>(layer.sliceIndex);
+        record.exposureFrames = layer.exposureFrames;
+        record.darkTimeMs = layer.darkTimeMs;
+        record.intensity = layer.intensity;
+        record.moveDistance = layer.moveDistance;
+        record.foldedEmptyLayers = layer.foldedEmptyLayers;
+        record.doseMJ = layer.doseMJ;
+        record.velocity = optionalValue(layer.motion.velocity);
+        record.acceleration = optionalValue(layer.motion.acceleration);
+        record.pumpingDistance = optionalValue(layer.motion.pumpingDistance);
+        record.exposureMs = static_cast<int32_t>(std::lround(layer.exposureFrames * 1000.0 / frameRate));
+
+        if (layer.profile) {
+            auto known = profileOffsets.find(layer.profile.get());
+            if (known == profileOffsets.end()) {
+                known = profileOffsets.emplace(layer.profile.get(), static_cast<uint32_t>(segments.size())).first;
+                for (const IntensitySegment& segment : *layer.profile) {
+                    segments.push_back({ segment.intensity, segment.durationMs });
+                }
+            }
+            record.profileFirst = known->second;
+            record.profileCount = static_cast<uint32_t>(layer.profile->size());
+            record.exposureMs = std::max(record.exposureMs, profileDurationMs(*layer.profile));
+        }
+
+        record.startMs = startMs;
+        startMs += record.exposureMs + std::max(0, record.darkTimeMs);
+        records.push_back(record);
+    }
+
+    std::vector<PlanFileSlice> slices(sliceCount);
+    std::string names;
+    for (size_t i = 0; i < sliceCount; ++i) {
+        std::string name = source.layerName(i);
+        slices[i] = PlanFileSlice{ names.size(), static_cast<uint32_t>(name.size()), 0, 0, 0 };
+        if (!sliceFileStatus(name, slices[i].fileSize, slices[i].modifiedTime)) {
+            error = "Failed to read slice " + name;
+            return false;
+        }
+        names += name;
+    }
+
+    PlanFileHeader header{};
+    std::memcpy(header.magic, planFileMagic, sizeof(header.magic));
+    header.version = planFileVersion;
+    header.headerSize = sizeof(PlanFileHeader);
+    header.recordSize = sizeof(PlanFileRecord);
+    header.flags = flags;
+    header.layerCount = records.size();
+    header.recordsOffset = alignTo8(sizeof(PlanFileHeader));
+    header.sliceCount = slices.size();
+    header.slicesOffset = alignTo8(header.recordsOffset + records.size() * sizeof(PlanFileRecord));
+    header.segmentCount = segments.size();
+    header.segmentsOffset = alignTo8(header.slicesOffset + slices.size() * sizeof(PlanFileSlice));
+    header.namesOffset = alignTo8(header.segmentsOffset + segments.size() * sizeof(PlanFileSegment));
+    header.namesSize = names.size();
+    header.fileSize = header.namesOffset + names.size();
+    header.emptyLayers = plan.emptyLayers;
+    header.leadingMove = plan.leadingMove;
+    header.frameRate = frameRate;
+    header.durationMs = startMs;
+
+    std::string temporaryPath = filePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            error = "Failed to create " + temporaryPath;
+            return false;
+        }
+        // Every table starts at a multiple of 8, the gaps are zero
+        auto writeTable = [&](uint64_t offset, const void* table, size_t bytes) {
+            static const char padding[8] = {};
+            file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+            file.write(static_cast<const char*>(table), static_cast<std::streamsize>(bytes));
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeTable(header.recordsOffset, records.data(), records.size() * sizeof(PlanFileRecord));
+        writeTable(header.slicesOffset, slices.data(), slices.size() * sizeof(PlanFileSlice));
+        writeTable(header.segmentsOffset, segments.data(), segments.size() * sizeof(PlanFileSegment));
+        writeTable(header.namesOffset, names.data(), names.size());
+        if (!file) {
+            error = "Failed to write " + temporaryPath;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temporaryPath, filePath, ec);
+    if (ec) {
+        fs::remove(temporaryPath, ec);
+        error = "Failed to replace " + filePath + ", it may still be open";
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------Plan File-----------------------------------------------------------------
+
+/**************************************************************************************************************************************
+Function:
+    PlanFile::open
+Parameters:
+    const std::string& filePath: Compiled plan written by writePlanFile
+    std::string& error: Reason the file was rejected
+Returns:
+    std::shared_ptr<PlanFile>: Mapped plan, nullptr if the file cannot be mapped or is not a plan of this version
+Description:
+    Maps the whole file read-only and checks the header: magic, version, record layout, the recorded size against the actual size and
+    that every table lies within the file. Nothing else is read, so opening takes the same time for ten layers as for a million.
+***************************************************************************************************************************************/
+
+std::shared_ptr<PlanFile> PlanFile::open(const std::string& filePath, std::string& error) {
+    std::shared_ptr<PlanFile> file(new PlanFile());
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(fs::path(filePath).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        error = "Failed to open " + filePath;
+        return nullptr;
+    }
+    file->fileHandle = handle;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(PlanFileHeader))) {
+        error = filePath + " is not a compiled plan";
+        return nullptr;
+    }
+    file->size = static_cast<size_t>(fileSize.QuadPart);
+    file->mappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->mappingHandle == nullptr) {
+        error = "Failed to map " + filePath;
+        return nullptr;
+    }
+    file->data = static_cast<const unsigned char*>(MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    int descriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        error = "Failed to open " + filePath;
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(PlanFileHeader))) {
+        ::close(descriptor);
+        error = filePath + " is not a compiled plan";
+        return nullptr;
+    }
+    file->size = static_cast<size_t>(status.st_size);
+    void* mapped = mmap(nullptr, file->size, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor); // The mapping keeps the file open
+    file->data = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(mapped);
+#endif
+    if (file->data == nullptr) {
+        error = "Failed to map " + filePath;
+        return nullptr;
+    }
+
+    const PlanFileHeader& header = file->header();
+    if (std::memcmp(header.magic, planFileMagic, sizeof(header.magic)) != 0) {
+        error = filePath + " is not a compiled plan";
+        return nullptr;
+    }
+    if (header.version != planFileVersion || header.headerSize != sizeof(PlanFileHeader) ||
+        header.recordSize != sizeof(PlanFileRecord)) {
+        error = filePath + " was compiled by a different version (format " + std::to_string(header.version) + "), compile it again";
+        return nullptr;
+    }
+    if (header.fileSize != file->size) {
+        error = filePath + " is truncated or was modified after compiling";
+        return nullptr;
+    }
+    if (!tableFits(header.recordsOffset, header.layerCount, sizeof(PlanFileRecord), file->size) ||
+        !tableFits(header.slicesOffset, header.sliceCount, sizeof(PlanFileSlice), file->size) ||
+        !tableFits(header.segmentsOffset, header.segmentCount, sizeof(PlanFileSegment), file->size) ||
+        header.namesOffset > file->size || header.namesSize > file->size - header.namesOffset) {
+        error = filePath + " has a table outside the file";
+        return nullptr;
+    }
+
+    file->records = reinterpret_cast<const PlanFileRecord*>(file->data + header.recordsOffset);
+    file->slices = reinterpret_cast<const PlanFileSlice*>(file->data + header.slicesOffset);
+    file->segments = reinterpret_cast<const PlanFileSegment*>(file->data + header.segmentsOffset);
+    return file;
+}
+
+PlanFile::~PlanFile() {
+#ifdef _WIN32
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+#else
+    if (data != nullptr) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+}
+
+std::string_view PlanFile::sliceName(size_t index) const {
+    const PlanFileHeader& h = header();
+    if (index >= h.sliceCount) {
+        return std::string_view();
+    }
+    const PlanFileSlice& slice = slices[index];
+    if (slice.nameOffset > h.namesSize || slice.nameLength > h.namesSize - slice.nameOffset) {
+        return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char*>(data + h.namesOffset + slice.nameOffset), slice.nameLength);
+}
+
+bool PlanFile::sliceUnchanged(size_t index, std::string& error) const {
+    std::string name(sliceName(index));
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    if (name.empty() || !sliceFileStatus(name, size, modifiedTime)) {
+        error = "Slice " + std::to_string(index) + " of the plan cannot be read: " + name;
+        return false;
+    }
+    const PlanFileSlice& slice = slices[index];
+    if (size != slice.fileSize || modifiedTime != slice.modifiedTime) {
+        error = "Slice " + name + " changed after the plan was compiled, compile it again";
+        return false;
+    }
+    return true;
+}
+
+IntensityProfile PlanFile::profile(const PlanFileRecord& record) const {
+    IntensityProfile profile;
+    uint64_t segmentCount = header().segmentCount;
+    if (record.profileCount == 0 || record.profileFirst > segmentCount || record.profileCount > segmentCount - record.profileFirst) {
+        return profile;
+    }
+    for (uint32_t i = 0; i < record.profileCount; ++i) {
+        const PlanFileSegment& segment = segments[record.profileFirst + i];
+        profile.push_back({ segment.intensity, segment.durationMs });
+    }
+    return profile;
+}
+
+/**************************************************************************************************************************************
+Function:
+    buildPlanFromFile
+Parameters:
+    std::shared_ptr<const PlanFile> file: Mapped plan, kept alive by the plan's slice source
+    PrintPlan& plan: Receives the layers
+    std::string& error: First record that references data outside the file, or the first slice that changed
+Returns:
+    bool: True if every record is usable
+Description:
+    Copies the records into the PlannedLayer list RunPlan works on. Records sharing a profile share one IntensityProfile, as in a plan
+    built from the settings CSV. Every slice is checked against the size and write time recorded when compiling first, a re-exported
+    folder would otherwise print with the empty-layer folding and exposures of the old slices.
+***************************************************************************************************************************************/
+
+bool buildPlanFromFile(std::shared_ptr<const PlanFile> file, PrintPlan& plan, std::string& error) {
+    plan = PrintPlan();
+    for (size_t i = 0; i < file->sliceCount(); ++i) {
+        if (!file->sliceUnchanged(i, error)) {
+            return false;
+        }
+    }
+    plan.source = std::make_shared<PlanFileSliceSource>(file);
+    plan.leadingMove = file->header().leadingMove;
+    plan.emptyLayers = static_cast<size_t>(file->header().emptyLayers);
+    plan.layers.reserve(file->layerCount());
+
+    std::unordered_map<uint32_t, std::shared_ptr<const IntensityProfile>> profiles;
+    for (size_t i = 0; i < file->layerCount(); ++i) {
+        const PlanFileRecord& record = file->record(i);
+        if (record.sliceIndex >= file->sliceCount()) {
+            error = "Layer " + std::to_string(i + 1) + " references slice " + std::to_string(record.sliceIndex) + " outside the plan";
+            return false;
+        }
+
+        std::shared_ptr<const IntensityProfile> profile;
+        if (record.profileCount > 0) {
+            auto known = profiles.find(record.profileFirst);
+            if (known == profiles.end()) {
+                auto segments = std::make_shared<IntensityProfile>(file->profile(record));
+                if (segments->empty()) {
+                    error = "Layer " + std::to_string(i + 1) + " references an intensity profile outside the plan";
+                    return false;
+                }
+                known = profiles.emplace(record.profileFirst, segments).first;
+            }
+            profile = known->second;
+        }
+
+        LayerMotion motion;
+        motion.velocity = optionalValue(record.velocity);
+        motion.acceleration = optionalValue(record.acceleration);
+        motion.pumpingDistance = optionalValue(record.pumpingDistance);
+        plan.layers.push_back(PlannedLayer{ record.sliceIndex, record.exposureFrames, record.darkTimeMs, record.intensity,
+            record.moveDistance, record.foldedEmptyLayers, record.doseMJ, profile, motion });
+    }
+    return true;
+}
+
+bool PlanFileSliceSource::loadLayer(size_t index, sf::Image& image) const {
+    std::string error;
+    if (!file->sliceUnchanged(index, error)) {
+        std::cerr << error << std::endl; // Replaced during the print, the print loop reports the layer as not loaded
+        return false;
+    }
+    return image.loadFromFile(layerName(index));
+}
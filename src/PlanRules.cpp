@@ -0,0 +1,588 @@
+
+#include "PlanRules.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+namespace {
+    const char* const settingNames[] = { "exposure", "dark", "intensity", "dose", "step", "velocity", "acceleration", "pumping" };
+    const char* const variableNames[] = { "layer", "layers", "progress", "height", "area", "newarea", "islands", "newislands" };
+    static_assert(sizeof(settingNames) / sizeof(settingNames[0]) == static_cast<size_t>(RuleSetting::Count), "One name per setting");
+    static_assert(sizeof(variableNames) / sizeof(variableNames[0]) == static_cast<size_t>(RuleVariable::Count), "One name per variable");
+
+    constexpr size_t settingCount = static_cast<size_t>(RuleSetting::Count);
+
+    size_t index(RuleSetting setting) {
+        return static_cast<size_t>(setting);
+    }
+
+    size_t index(RuleVariable variable) {
+        return static_cast<size_t>(variable);
+    }
+}
+
+//--------------------------------------------------------Parser-----------------------------------------------------------------
+
+// Recursive descent over one rule line, the expressions are emitted in postfix order as they are parsed
+class RuleParser {
+public:
+    RuleParser(const std::string& text, uint32_t& usedVariables) : text(text), usedVariables(usedVariables) {}
+
+    bool parseRule(PlanRules::Rule& rule, std::string& error) {
+        next();
+        if (token == Token::Identifier && word == "when") {
+            next();
+            if (!parseExpression(rule.condition) || !expect(":")) {
+                error = message;
+                return false;
+            }
+        }
+        do {
+            if (token != Token::Identifier) {
+                error = "Expected a setting name";
+                return false;
+            }
+            auto name = std::find(std::begin(settingNames), std::end(settingNames), word);
+            if (name == std::end(settingNames)) {
+                error = "Unknown setting \"" + word + "\"";
+                return false;
+            }
+            PlanRules::Assignment assignment;
+            assignment.setting = static_cast<RuleSetting>(name - std::begin(settingNames));
+            next();
+            if (!expect("=") || !parseExpression(assignment.program)) {
+                error = message;
+                return false;
+            }
+            rule.assignments.push_back(std::move(assignment));
+        } while (accept(","));
+
+        if (token != Token::End) {
+            error = "Unexpected \"" + word + "\"";
+            return false;
+        }
+        return true;
+    }
+
+    // Stack depth reached by a postfix program, the evaluator has a fixed stack
+    static size_t stackDepth(const PlanRules::Program& program) {
+        size_t depth = 0, deepest = 0;
+        for (const PlanRules::Instruction& instruction : program) {
+            switch (instruction.op) {
+            case Op::Constant: case Op::Variable: depth++; break;
+            case Op::Negate: case Op::Not: case Op::Abs: case Op::Floor: case Op::Round: case Op::Sqrt: break;
+            case Op::Clamp: depth -= 2; break;
+            case Op::Ramp: depth -= 4; break;
+            default: depth--; break;
+            }
+            deepest = std::max(deepest, depth);
+        }
+        return deepest;
+    }
+
+    // Variables referenced by the last parsed rule
+    uint32_t lineVariables = 0;
+
+private:
+    enum class Token { Number, Identifier, Symbol, End, Invalid };
+    using Op = PlanRules::Op;
+
+    void next() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+        if (position >= text.size()) {
+            token = Token::End;
+            word = "end of line";
+            return;
+        }
+        char c = text[position];
+        size_t start = position;
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            char* end = nullptr;
+            number = std::strtod(text.c_str() + position, &end);
+            position = static_cast<size_t>(end - text.c_str());
+            token = position > start ? Token::Number : Token::Invalid;
+        }
+        else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            while (position < text.size() && (std::isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_')) {
+                position++;
+            }
+            token = Token::Identifier;
+        }
+        else {
+            static const char* const symbols[] = { "<=", ">=", "==", "!=", "&&", "||", "<", ">", "+", "-", "*", "/", "(", ")", ",", "!",
+                "=", ":" };
+            token = Token::Invalid;
+            for (const char* symbol : symbols) {
+                size_t length = std::char_traits<char>::length(symbol);
+                if (text.compare(position, length, symbol) == 0) {
+                    position += length;
+                    token = Token::Symbol;
+                    break;
+                }
+            }
+            if (token == Token::Invalid) {
+                position++;
+            }
+        }
+        word = text.substr(start, position - start);
+        if (token == Token::Identifier) {
+            std::transform(word.begin(), word.end(), word.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+        }
+    }
+
+    bool accept(const char* symbol) {
+        if (token == Token::Symbol && word == symbol) {
+            next();
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(const char* symbol) {
+        if (accept(symbol)) {
+            return true;
+        }
+        return fail("Expected \"" + std::string(symbol) + "\" but found \"" + word + "\"");
+    }
+
+    bool fail(const std::string& reason) {
+        if (message.empty()) {
+            message = reason;
+        }
+        return false;
+    }
+
+    static void emit(PlanRules::Program& program, Op op, double value = 0.0, RuleVariable variable = RuleVariable::Layer) {
+        program.push_back({ op, variable, value });
+    }
+
+    bool parseExpression(PlanRules::Program& program) {
+        return parseBinary(program, 0);
+    }
+
+    // Precedence levels from loosest to tightest: ||, &&, comparisons, + -, * /
+    bool parseBinary(PlanRules::Program& program, int level) {
+        static const std::vector<std::vector<std::pair<const char*, Op>>> levels = {
+            { { "||", Op::Or } },
+            { { "&&", Op::And } },
+            { { "<=", Op::LessEqual }, { ">=", Op::GreaterEqual }, { "==", Op::Equal }, { "!=", Op::NotEqual }, { "<", Op::Less },
+                { ">", Op::Greater } },
+            { { "+", Op::Add }, { "-", Op::Subtract } },
+            { { "*", Op::Multiply }, { "/", Op::Divide } },
+        };
+        if (level == static_cast<int>(levels.size())) {
+            return parseUnary(program);
+        }
+        if (!parseBinary(program, level + 1)) {
+            return false;
+        }
+        while (token == Token::Symbol) {
+            auto op = std::find_if(levels[level].begin(), levels[level].end(), [&](const auto& entry) { return word == entry.first; });
+            if (op == levels[level].end()) {
+                break;
+            }
+            next();
+            if (!parseBinary(program, level + 1)) {
+                return false;
+            }
+            emit(program, op->second);
+        }
+        return true;
+    }
+
+    bool parseUnary(PlanRules::Program& program) {
+        if (accept("-")) {
+            if (!parseUnary(program)) {
+                return false;
+            }
+            emit(program, Op::Negate);
+            return true;
+        }
+        if (accept("!")) {
+            if (!parseUnary(program)) {
+                return false;
+            }
+            emit(program, Op::Not);
+            return true;
+        }
+        return parsePrimary(program);
+    }
+
+    bool parsePrimary(PlanRules::Program& program) {
+        if (token == Token::Number) {
+            emit(program, Op::Constant, number);
+            next();
+            return true;
+        }
+        if (accept("(")) {
+            return parseExpression(program) && expect(")");
+        }
+        if (token != Token::Identifier) {
+            return fail("Expected a value but found \"" + word + "\"");
+        }
+
+        std::string name = word;
+        next();
+        auto variable = std::find(std::begin(variableNames), std::end(variableNames), name);
+        if (variable != std::end(variableNames)) {
+            RuleVariable v = static_cast<RuleVariable>(variable - std::begin(variableNames));
+            emit(program, Op::Variable, 0.0, v);
+            lineVariables |= 1u << index(v);
+            usedVariables |= 1u << index(v);
+            return true;
+        }
+
+        struct Function { const char* name; Op op; int arity; };
+        static const Function functions[] = { { "min", Op::Min, 2 }, { "max", Op::Max, 2 }, { "abs", Op::Abs, 1 },
+            { "floor", Op::Floor, 1 }, { "round", Op::Round, 1 }, { "sqrt", Op::Sqrt, 1 }, { "clamp", Op::Clamp, 3 },
+            { "ramp", Op::Ramp, 5 } };
+        const Function* function = std::find_if(std::begin(functions), std::end(functions),
+            [&](const Function& f) { return name == f.name; });
+        if (function == std::end(functions)) {
+            return fail("Unknown variable or function \"" + name + "\"");
+        }
+        if (!expect("(")) {
+            return false;
+        }
+        for (int argument = 0; argument < function->arity; ++argument) {
+            if ((argument > 0 && !expect(",")) || !parseExpression(program)) {
+                return false;
+            }
+        }
+        if (!expect(")")) {
+            return false;
+        }
+        emit(program, function->op);
+        return true;
+    }
+
+    const std::string& text;
+    uint32_t& usedVariables;
+    size_t position = 0;
+    Token token = Token::End;
+    std::string word;
+    double number = 0.0;
+    std::string message;
+};
+
+/**************************************************************************************************************************************
+Function:
+    PlanRules::compile
+Parameters:
+    const std::string& text: Rule file contents, see PlanRules.h
+    std::vector<RuleError>& errors: Receives every rejected line
+Returns:
+    std::shared_ptr<PlanRules>: Compiled rules, nullptr if any line was rejected
+Description:
+    Parses every line into postfix programs for the condition and the assigned settings. Besides the syntax it checks that an
+    unconditional rule sets the dark time and either the exposure or the dose, so every layer gets a complete setting, and that
+    rules assigning the step do not depend on the height, which is the sum of the steps below.
+***************************************************************************************************************************************/
+
+std::shared_ptr<PlanRules> PlanRules::compile(const std::string& text, std::vector<RuleError>& errors) {
+    std::shared_ptr<PlanRules> compiled(new PlanRules());
+    bool baseDark = false, baseExposure = false;
+    size_t errorCount = errors.size();
+
+    std::istringstream lines(text);
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        Rule rule;
+        std::string error;
+        RuleParser parser(line, compiled->usedVariables);
+        if (!parser.parseRule(rule, error)) {
+            errors.push_back({ lineNumber, error });
+            continue;
+        }
+
+        bool setsStep = std::any_of(rule.assignments.begin(), rule.assignments.end(),
+            [](const Assignment& assignment) { return assignment.setting == RuleSetting::Step; });
+        if (setsStep && (parser.lineVariables & (1u << index(RuleVariable::Height)))) {
+            errors.push_back({ lineNumber, "A rule setting the step cannot use the height, the height is made of the steps" });
+            continue;
+        }
+        bool tooDeep = RuleParser::stackDepth(rule.condition) > maxStackDepth;
+        for (const Assignment& assignment : rule.assignments) {
+            tooDeep = tooDeep || RuleParser::stackDepth(assignment.program) > maxStackDepth;
+        }
+        if (tooDeep) {
+            errors.push_back({ lineNumber, "Expression is nested too deeply" });
+            continue;
+        }
+
+        if (rule.condition.empty()) {
+            for (const Assignment& assignment : rule.assignments) {
+                baseDark = baseDark || assignment.setting == RuleSetting::Dark;
+                baseExposure = baseExposure || assignment.setting == RuleSetting::Exposure || assignment.setting == RuleSetting::Dose;
+            }
+        }
+        compiled->rules.push_back(std::move(rule));
+    }
+
+    if (errors.size() == errorCount && (!baseDark || !baseExposure)) {
+        errors.push_back({ 0, "A rule without a condition must set dark and either exposure or dose" });
+    }
+    return errors.size() == errorCount ? compiled : nullptr;
+}
+
+std::shared_ptr<PlanRules> PlanRules::load(const std::string& filePath, std::vector<RuleError>& errors) {
+    std::ifstream file(filePath);
+    if (!file) {
+        errors.push_back({ 0, "Failed to open " + filePath });
+        return nullptr;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return compile(contents.str(), errors);
+}
+
+bool PlanRules::assigns(RuleSetting setting) const {
+    return std::any_of(rules.begin(), rules.end(), [setting](const Rule& rule) {
+        return std::any_of(rule.assignments.begin(), rule.assignments.end(),
+            [setting](const Assignment& assignment) { return assignment.setting == setting; });
+        });
+}
+
+//--------------------------------------------------------Evaluator-----------------------------------------------------------------
+
+double PlanRules::run(const Program& program, const Variables& variables) {
+    double stack[maxStackDepth];
+    size_t top = 0;
+    for (const Instruction& instruction : program) {
+        switch (instruction.op) {
+        case Op::Constant: stack[top++] = instruction.value; break;
+        case Op::Variable: stack[top++] = variables[index(instruction.variable)]; break;
+        case Op::Negate: stack[top - 1] = -stack[top - 1]; break;
+        case Op::Not: stack[top - 1] = stack[top - 1] == 0.0 ? 1.0 : 0.0; break;
+        case Op::Abs: stack[top - 1] = std::abs(stack[top - 1]); break;
+        case Op::Floor: stack[top - 1] = std::floor(stack[top - 1]); break;
+        case Op::Round: stack[top - 1] = std::round(stack[top - 1]); break;
+        case Op::Sqrt: stack[top - 1] = std::sqrt(stack[top - 1]); break;
+        case Op::Clamp:
+            top -= 2;
+            stack[top - 1] = std::min(std::max(stack[top - 1], stack[top]), stack[top + 1]);
+            break;
+        case Op::Ramp: {
+            top -= 4;
+            double x = stack[top - 1], x0 = stack[top], x1 = stack[top + 1], y0 = stack[top + 2], y1 = stack[top + 3];
+            double t = x1 == x0 ? (x < x0 ? 0.0 : 1.0) : std::min(1.0, std::max(0.0, (x - x0) / (x1 - x0)));
+            stack[top - 1] = y0 + t * (y1 - y0);
+            break;
+        }
+        default: {
+            double b = stack[--top];
+            double& a = stack[top - 1];
+            switch (instruction.op) {
+            case Op::Add: a = a + b; break;
+            case Op::Subtract: a = a - b; break;
+            case Op::Multiply: a = a * b; break;
+            case Op::Divide: a = a / b; break;
+            case Op::Less: a = a < b; break;
+            case Op::LessEqual: a = a <= b; break;
+            case Op::Greater: a = a > b; break;
+            case Op::GreaterEqual: a = a >= b; break;
+            case Op::Equal: a = a == b; break;
+            case Op::NotEqual: a = a != b; break;
+            case Op::And: a = (a != 0.0) && (b != 0.0); break;
+            case Op::Or: a = (a != 0.0) || (b != 0.0); break;
+            case Op::Min: a = std::min(a, b); break;
+            case Op::Max: a = std::max(a, b); break;
+            default: break;
+            }
+            break;
+        }
+        }
+    }
+    return stack[0];
+}
+
+void PlanRules::evaluate(const Variables& variables, double (&settings)[settingCount], bool stepOnly) const {
+    std::fill(std::begin(settings), std::end(settings), std::numeric_limits<double>::quiet_NaN());
+    for (const Rule& rule : rules) {
+        bool relevant = !stepOnly || std::any_of(rule.assignments.begin(), rule.assignments.end(),
+            [](const Assignment& assignment) { return assignment.setting == RuleSetting::Step; });
+        if (!relevant) {
+            continue;
+        }
+        if (!rule.condition.empty()) {
+            double condition = run(rule.condition, variables);
+            if (!(condition != 0.0) || std::isnan(condition)) {
+                continue;
+            }
+        }
+        for (const Assignment& assignment : rule.assignments) {
+            if (!stepOnly || assignment.setting == RuleSetting::Step) {
+                settings[index(assignment.setting)] = run(assignment.program, variables);
+            }
+        }
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    PlanRules::buildPlan
+Parameters:
+    std::shared_ptr<SliceSource> source: Complete slices of the job
+    float stepSize: Step of layers without a step rule, its sign gives the direction of every move
+    const RuleInputs& inputs: Slice analytics, required when the rules use area, newarea, islands or newislands
+    PrintPlan& plan: Receives one planned layer per slice
+    std::string& error: First layer with an invalid setting
+Returns:
+    bool: True if every layer has valid settings
+Description:
+    The layers are split into blocks that the hardware threads pull from a shared counter. When rules set the step, a first pass
+    evaluates only those rules, the heights are summed in order and the second pass evaluates the complete rules with the height
+    of each layer known.
+***************************************************************************************************************************************/
+
+bool PlanRules::buildPlan(std::shared_ptr<SliceSource> source, float stepSize, const RuleInputs& inputs, PrintPlan& plan,
+    std::string& error) const {
+    size_t layerCount = source->layerCount();
+    if (uses(RuleVariable::Area) && inputs.slices.size() < layerCount) {
+        error = "The rules use the area but the slices were not analysed";
+        return false;
+    }
+    if ((uses(RuleVariable::NewArea) || uses(RuleVariable::Islands) || uses(RuleVariable::NewIslands)) && inputs.diffs.size() < layerCount) {
+        error = "The rules use the slice differences but the slices were not compared";
+        return false;
+    }
+
+    bool stepRules = assigns(RuleSetting::Step);
+    const float defaultStep = std::abs(stepSize);
+    const double pixelArea = static_cast<double>(inputs.pixelSize) * inputs.pixelSize;
+
+    auto fillVariables = [&](size_t layer, double height, Variables& variables) {
+        variables[index(RuleVariable::Layer)] = static_cast<double>(layer);
+        variables[index(RuleVariable::Layers)] = static_cast<double>(layerCount);
+        variables[index(RuleVariable::Progress)] = layerCount > 1 ? static_cast<double>(layer) / (layerCount - 1) : 0.0;
+        variables[index(RuleVariable::Height)] = height;
+        variables[index(RuleVariable::Area)] = layer < inputs.slices.size() ? inputs.slices[layer].litPixels * pixelArea : 0.0;
+        bool hasDiff = layer < inputs.diffs.size();
+        variables[index(RuleVariable::NewArea)] = hasDiff ? inputs.diffs[layer].newAreaMm2 : 0.0;
+        variables[index(RuleVariable::Islands)] = hasDiff ? static_cast<double>(inputs.diffs[layer].islands) : 0.0;
+        variables[index(RuleVariable::NewIslands)] = hasDiff ? static_cast<double>(inputs.diffs[layer].newIslands) : 0.0;
+    };
+
+    // Runs body(layer) for every layer on all hardware threads, stops early once a layer failed and returns the lowest failed layer
+    auto parallelFor = [&](auto body) {
+        const size_t blockSize = 4096;
+        std::atomic<size_t> nextBlock{ 0 };
+        std::atomic<size_t> firstFailure{ layerCount };
+        auto worker = [&]() {
+            for (size_t block = nextBlock++; block * blockSize < layerCount; block = nextBlock++) {
+                size_t end = std::min(layerCount, (block + 1) * blockSize);
+                for (size_t layer = block * blockSize; layer < end && layer < firstFailure.load(std::memory_order_relaxed); ++layer) {
+                    if (!body(layer)) {
+                        size_t expected = firstFailure.load();
+                        while (layer < expected && !firstFailure.compare_exchange_weak(expected, layer)) {
+                        }
+                        break;
+                    }
+                }
+            }
+        };
+        unsigned int threadCount = ingestThreadCount((layerCount + blockSize - 1) / blockSize);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threadCount; ++t) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& w : workers) {
+            w.join();
+        }
+        return firstFailure.load();
+    };
+
+    // Pass 1: thickness of every layer, then the height below each layer in order
+    std::vector<double> heights(layerCount + 1, 0.0);
+    std::vector<float> steps(stepRules ? layerCount : 0, defaultStep);
+    if (stepRules) {
+        size_t failed = parallelFor([&](size_t layer) {
+            Variables variables;
+            fillVariables(layer, 0.0, variables);
+            double settings[settingCount];
+            evaluate(variables, settings, true);
+            double step = settings[index(RuleSetting::Step)];
+            if (!std::isnan(step)) {
+                steps[layer] = static_cast<float>(step);
+            }
+            return std::isfinite(steps[layer]) && steps[layer] > 0.0f;
+        });
+        if (failed < layerCount) {
+            error = "Layer " + std::to_string(failed) + ": step must be a positive number of mm";
+            return false;
+        }
+    }
+    for (size_t layer = 0; layer < layerCount; ++layer) {
+        heights[layer + 1] = heights[layer] + (stepRules ? steps[layer] : defaultStep);
+    }
+
+    // Pass 2: all settings of every layer
+    plan = PrintPlan();
+    plan.source = source;
+    plan.layers.resize(layerCount);
+    std::vector<const char*> problems(layerCount, nullptr);
+    size_t failed = parallelFor([&](size_t layer) {
+        Variables variables;
+        fillVariables(layer, heights[layer], variables);
+        double settings[settingCount];
+        evaluate(variables, settings, false);
+
+        auto optionalSetting = [&](RuleSetting setting) {
+            double value = settings[index(setting)];
+            return std::isnan(value) ? std::optional<float>() : std::optional<float>(static_cast<float>(value));
+        };
+        double exposure = settings[index(RuleSetting::Exposure)];
+        double dark = settings[index(RuleSetting::Dark)];
+        double intensity = settings[index(RuleSetting::Intensity)];
+        double dose = settings[index(RuleSetting::Dose)];
+        bool doseLayer = dose > 0.0;
+
+        const char*& problem = problems[layer];
+        if (!doseLayer && !(std::round(exposure) >= 1.0 && exposure < 1e6)) problem = "exposure must be at least one frame";
+        else if (!(dark >= 0.0 && dark < 1e9)) problem = "dark must be a non-negative number of ms";
+        else if (!std::isnan(intensity) && !(intensity >= 0.0 && intensity <= 255.0)) problem = "intensity must be 0 to 255";
+        else if (!std::isnan(dose) && !std::isfinite(dose)) problem = "dose must be a number";
+
+        LayerMotion motion;
+        motion.velocity = optionalSetting(RuleSetting::Velocity);
+        motion.acceleration = optionalSetting(RuleSetting::Acceleration);
+        motion.pumpingDistance = optionalSetting(RuleSetting::Pumping);
+        if ((motion.velocity && !(*motion.velocity > 0.0f)) || (motion.acceleration && !(*motion.acceleration > 0.0f))) {
+            problem = problem ? problem : "velocity and acceleration must be positive";
+        }
+        if (motion.pumpingDistance && !(*motion.pumpingDistance >= 0.0f)) {
+            problem = problem ? problem : "pumping must not be negative";
+        }
+        if (problem) {
+            return false;
+        }
+
+        float thickness = stepRules ? steps[layer] : defaultStep;
+        plan.layers[layer] = PlannedLayer{ layer, doseLayer ? 0 : static_cast<int>(std::round(exposure)), static_cast<int>(std::round(dark)),
+            std::isnan(intensity) ? -1 : static_cast<int>(std::round(intensity)), std::copysign(thickness, stepSize), 0,
+            doseLayer ? dose : 0.0, nullptr, motion };
+        return true;
+    });
+    if (failed < layerCount) {
+        error = "Layer " + std::to_string(failed) + ": " + problems[failed];
+        plan.layers.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,285 @@
+
+#include "PrintPlan.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+
+namespace {
+    thread_local unsigned int ingestThreadLimit = 0;
+}
+
+/**************************************************************************************************************************************
+Function:
+    setIngestThreadLimit
+Parameters:
+    unsigned int threads: Most threads the ingest stages of the calling thread may use, 0 for every hardware thread
+Returns:
+    void
+Description:
+    A job prepared while another one prints sets 1, its ingest then runs on the preparing thread alone and leaves the other cores
+    to the running print's prefetcher.
+***************************************************************************************************************************************/
+
+void setIngestThreadLimit(unsigned int threads) {
+    ingestThreadLimit = threads;
+}
+
+// Threads for the given number of independent tasks, including the calling thread, at least 1
+unsigned int ingestThreadCount(size_t tasks) {
+    unsigned int threads = ingestThreadLimit > 0 ? ingestThreadLimit : std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, tasks)));
+}
+
+/**************************************************************************************************************************************
+Function:
+    ingestSlices
+Parameters:
+    const SliceSource& source: Slices of the job
+Returns:
+    std::vector<SliceInfo>: One entry per layer of the source, in the same order
+Description:
+    Inspects every slice once before the print (see SliceSource::inspectLayer) so the planner can drop the exposure of all-black
+    layers. The layers are spread over the ingest threads (see setIngestThreadLimit), each worker pulling the next index from a
+    shared counter.
+***************************************************************************************************************************************/
+
+std::vector<SliceInfo> ingestSlices(const SliceSource& source) {
+    size_t layerCount = source.layerCount();
+    std::vector<SliceInfo> slices(layerCount, SliceInfo{ 0, false, false });
+    std::atomic<size_t> nextSlice{ 0 };
+
+    auto worker = [&]() {
+        for (size_t i = nextSlice++; i < layerCount; i = nextSlice++) {
+            slices[i] = source.inspectLayer(i);
+        }
+    };
+
+    unsigned int threadCount = ingestThreadCount(layerCount);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threadCount; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    return slices;
+}
+
+/**************************************************************************************************************************************
+Function:
+    staticLayerSettings
+Parameters:
+    int maxImageDisplayCount, int mindarktime, float stepSize, int initialExposureCounter, int initialLayers
+Returns:
+    LayerSettingsFunction: Settings of the non-dynamic print for any slice index
+Description:
+    The first initialLayers slices use initialExposureCounter frames, all others maxImageDisplayCount. The intensity is left untouched
+    since it is set once by InitializeSystem.
+***************************************************************************************************************************************/
+
+LayerSettingsFunction staticLayerSettings(int maxImageDisplayCount, int mindarktime, float stepSize, int initialExposureCounter,
+    int initialLayers) {
+    return [=](size_t sliceIndex, PlannedLayer& layer) {
+        int exposure = (static_cast<int>(sliceIndex) < initialLayers) ? initialExposureCounter : maxImageDisplayCount;
+        layer = PlannedLayer{};
+        layer.sliceIndex = sliceIndex;
+        layer.exposureFrames = exposure;
+        layer.darkTimeMs = mindarktime;
+        layer.intensity = -1;
+        layer.moveDistance = stepSize;
+        return true;
+    };
+}
+
+/**************************************************************************************************************************************
+Function:
+    dynamicLayerSettings
+Parameters:
+    float stepSize, const std::vector<std::pair<LayerSettings, int>>& orderedSettings
+Returns:
+    LayerSettingsFunction: Settings of the dynamic print, false past the last group
+Description:
+    Looks up the (settings, layer count) group of the dynamic CSV that covers a slice index. Intensity profiles are parsed once per
+    group and shared by its layers; a malformed profile is reported and the group falls back to its constant intensity.
+    A group with its own step size moves by that thickness in the direction of the job's stepSize, its motion settings are passed on
+    to RunPlan unchanged.
+***************************************************************************************************************************************/
+
+LayerSettingsFunction dynamicLayerSettings(float stepSize, const std::vector<std::pair<LayerSettings, int>>& orderedSettings) {
+    // First slice index after each group
+    std::vector<size_t> groupEnds;
+    std::vector<std::shared_ptr<const IntensityProfile>> profiles;
+    size_t end = 0;
+    for (const auto& setting : orderedSettings) {
+        end += static_cast<size_t>(std::max(0, setting.second));
+        groupEnds.push_back(end);
+
+        std::shared_ptr<IntensityProfile> profile;
+        if (!setting.first.profile.empty()) {
+            profile = std::make_shared<IntensityProfile>();
+            std::string error;
+            if (!parseIntensityProfile(setting.first.profile, *profile, error)) {
+                std::cerr << "Ignoring intensity profile: " << error << std::endl;
+                profile.reset();
+            }
+        }
+        profiles.push_back(profile);
+    }
+
+    return [=](size_t sliceIndex, PlannedLayer& layer) {
+        auto group = std::upper_bound(groupEnds.begin(), groupEnds.end(), sliceIndex);
+        if (group == groupEnds.end()) {
+            return false;
+        }
+        size_t index = group - groupEnds.begin();
+        const LayerSettings& settings = orderedSettings[index].first;
+        float move = settings.stepSize ? std::copysign(*settings.stepSize, stepSize) : stepSize;
+        layer = PlannedLayer{ sliceIndex, settings.exposureTime, settings.darkTime, settings.intensity, move, 0, settings.dose,
+            profiles[index], settings.motion };
+        return true;
+    };
+}
+
+/**************************************************************************************************************************************
+Function:
+    buildPlan
+Parameters:
+    std::shared_ptr<SliceSource> source, const LayerSettingsFunction& layerSettings
+Returns:
+    PrintPlan: One planned layer per slice
+Description:
+    Plans every slice of the source in order. The print ends when either the slices or the settings run out.
+***************************************************************************************************************************************/
+
+PrintPlan buildPlan(std::shared_ptr<SliceSource> source, const LayerSettingsFunction& layerSettings) {
+    size_t layerCount = source->layerCount();
+    PrintPlan plan;
+    plan.source = source;
+    plan.layers.reserve(layerCount);
+
+    PlannedLayer layer;
+    for (size_t i = 0; i < layerCount && layerSettings(i, layer); ++i) {
+        plan.layers.push_back(layer);
+    }
+
+    return plan;
+}
+
+/**************************************************************************************************************************************
+Function:
+    buildStreamingPlan
+Parameters:
+    std::shared_ptr<SliceSource> source: Source that is still being written, see StreamingDirectorySource
+    size_t lead: Number of available slices the print keeps between itself and the slicer
+    LayerSettingsFunction layerSettings: Settings of each slice
+Returns:
+    PrintPlan: Initially empty plan whose extend function adds the layers during the print
+Description:
+    While the source is incomplete only the slices more than lead layers behind the newest one are planned, so the print starts once
+    lead + 1 slices exist and waits in the dark phase when it catches up with the slicer. Once the source is complete the remaining
+    slices are planned without a lead.
+Notes:
+    - Empty slices are not folded in a streaming plan, the layers are exposed as they arrive.
+***************************************************************************************************************************************/
+
+PrintPlan buildStreamingPlan(std::shared_ptr<SliceSource> source, size_t lead, LayerSettingsFunction layerSettings) {
+    PrintPlan plan;
+    plan.source = source;
+
+    plan.extend = [lead, layerSettings](PrintPlan& plan) {
+        // Read completeness first, a source that completes in between only adds layers
+        bool complete = plan.source->isComplete();
+        size_t available = plan.source->layerCount();
+        size_t limit = complete ? available : (available > lead ? available - lead : 0);
+
+        size_t next = plan.layers.empty() ? 0 : plan.layers.back().sliceIndex + 1;
+        PlannedLayer layer;
+        for (; next < limit; ++next) {
+            if (!layerSettings(next, layer)) {
+                return false;
+            }
+            plan.layers.push_back(layer);
+        }
+        return !complete;
+    };
+
+    return plan;
+}
+
+/**************************************************************************************************************************************
+Function:
+    buildStaticPlan
+Parameters:
+    std::shared_ptr<SliceSource> source, int maxImageDisplayCount, float stepSize, int mindarktime, int initialExposureCounter,
+    int initialLayers
+Returns:
+    PrintPlan: One planned layer per slice
+Description:
+    Plan for the non-dynamic print, see staticLayerSettings.
+***************************************************************************************************************************************/
+
+PrintPlan buildStaticPlan(std::shared_ptr<SliceSource> source, int maxImageDisplayCount, int mindarktime, float stepSize,
+    int initialExposureCounter, int initialLayers) {
+    return buildPlan(source, staticLayerSettings(maxImageDisplayCount, mindarktime, stepSize, initialExposureCounter, initialLayers));
+}
+
+/**************************************************************************************************************************************
+Function:
+    buildDynamicPlan
+Parameters:
+    std::shared_ptr<SliceSource> source, float stepSize, const std::vector<std::pair<LayerSettings, int>>& orderedSettings
+Returns:
+    PrintPlan: One planned layer per slice covered by the settings
+Description:
+    Expands the (settings, layer count) groups read from the dynamic CSV into one planned layer per slice. The print ends when either
+    the slices or the settings run out.
+***************************************************************************************************************************************/
+
+PrintPlan buildDynamicPlan(std::shared_ptr<SliceSource> source, float stepSize,
+    const std::vector<std::pair<LayerSettings, int>>& orderedSettings) {
+    return buildPlan(source, dynamicLayerSettings(stepSize, orderedSettings));
+}
+
+/**************************************************************************************************************************************
+Function:
+    foldEmptyLayers
+Parameters:
+    PrintPlan& plan: Plan to rewrite in place
+    const std::vector<SliceInfo>& slices: Ingest result for plan.source
+Returns:
+    void
+Description:
+    Removes the layers whose slice is all black. Their stage travel is added to the preceding exposed layer, so a run of empty slices
+    becomes part of a single move and costs neither an exposure, a dark phase nor a texture upload. Empty slices in front of the first
+    exposed layer are collected in plan.leadingMove and travelled before the print starts.
+***************************************************************************************************************************************/
+
+void foldEmptyLayers(PrintPlan& plan, const std::vector<SliceInfo>& slices) {
+    std::vector<PlannedLayer> kept;
+    kept.reserve(plan.layers.size());
+
+    for (const PlannedLayer& layer : plan.layers) {
+        bool isEmpty = layer.sliceIndex < slices.size() && slices[layer.sliceIndex].isEmpty;
+        if (!isEmpty) {
+            kept.push_back(layer);
+            continue;
+        }
+
+        plan.emptyLayers++;
+        if (kept.empty()) {
+            plan.leadingMove += layer.moveDistance;
+        }
+        else {
+            kept.back().moveDistance += layer.moveDistance;
+            kept.back().foldedEmptyLayers++;
+        }
+    }
+
+    plan.layers.swap(kept);
+}
@@ -0,0 +1,188 @@
+
+#include "PrintTrace.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+int64_t steadyMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The names are literals of this program, only quotes and backslashes could break the JSON
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+}
+
+PrintTrace::ThreadBuffer::~ThreadBuffer() {
+    for (auto& chunk : chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+PrintTrace::ThreadHandle::~ThreadHandle() {
+    if (buffer) {
+        std::lock_guard<std::mutex> lock(printTrace().mutex);
+        buffer->owned = false; // The next thread of the same name continues this track
+    }
+}
+
+PrintTrace::ThreadHandle& PrintTrace::threadHandle() {
+    thread_local ThreadHandle handle;
+    return handle;
+}
+
+PrintTrace::ThreadBuffer& PrintTrace::threadBuffer(const char* name) {
+    ThreadHandle& handle = threadHandle();
+    if (handle.buffer) {
+        return *handle.buffer;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& buffer : buffers) {
+        bool sameName = (buffer->name == nullptr && name == nullptr) ||
+            (buffer->name != nullptr && name != nullptr && std::strcmp(buffer->name, name) == 0);
+        if (!buffer->owned && sameName) {
+            buffer->owned = true;
+            handle.buffer = buffer;
+            return *buffer;
+        }
+    }
+    auto buffer = std::make_shared<ThreadBuffer>();
+    buffer->trackId = nextTrackId++;
+    buffer->name = name;
+    buffers.push_back(buffer);
+    handle.buffer = buffer;
+    return *buffer;
+}
+
+void PrintTrace::restart() {
+    epochUs.store(steadyMicroseconds(), std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+int64_t PrintTrace::now() const {
+    return steadyMicroseconds() - epochUs.load(std::memory_order_relaxed);
+}
+
+void PrintTrace::nameThread(const char* name) {
+    threadBuffer(name);
+}
+
+/**************************************************************************************************************************************
+Function:
+    PrintTrace::record
+Parameters:
+    const TraceZoneRecord& zone: Finished zone of the calling thread
+Returns:
+    void
+Description:
+    Appends the zone to the calling thread's buffer without a lock. Chunks are allocated the first time they are needed and kept
+    across restarts, so a traced print allocates only while its buffers grow beyond any previous print.
+***************************************************************************************************************************************/
+
+void PrintTrace::record(const TraceZoneRecord& zone) {
+    ThreadBuffer& buffer = threadBuffer(nullptr);
+    uint32_t current = generation.load(std::memory_order_acquire);
+    if (buffer.generation.load(std::memory_order_relaxed) != current) {
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.generation.store(current, std::memory_order_relaxed);
+    }
+
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    size_t chunkIndex = index / chunkSize;
+    if (chunkIndex >= maxChunks) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceZoneRecord* chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new TraceZoneRecord[chunkSize];
+        buffer.chunks[chunkIndex].store(chunk, std::memory_order_relaxed);
+    }
+    chunk[index % chunkSize] = zone;
+    buffer.count.store(index + 1, std::memory_order_release); // Publishes the zone and its chunk to the export
+}
+
+/**************************************************************************************************************************************
+Function:
+    PrintTrace::exportChromeTrace
+Parameters:
+    const std::string& filePath: JSON file to write
+    std::string& error: Reason the file could not be written
+Returns:
+    bool: True if the file was written
+Description:
+    Writes the zones of the current trace as complete ("X") events and names the tracks with thread_name metadata events. Threads
+    may keep recording while the trace is exported, their later zones are simply not included.
+***************************************************************************************************************************************/
+
+bool PrintTrace::exportChromeTrace(const std::string& filePath, std::string& error) const {
+    std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = buffers;
+    }
+
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file) {
+        error = "Failed to open trace file: " + filePath;
+        return false;
+    }
+    uint32_t current = generation.load(std::memory_order_acquire);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& buffer : snapshot) {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        if (buffer->generation.load(std::memory_order_relaxed) != current || count == 0) {
+            continue; // Nothing recorded by this thread since the restart
+        }
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->trackId <<
+            ",\"args\":{\"name\":";
+        writeJsonString(file, buffer->name ? buffer->name : "Thread");
+        file << "}}";
+        first = false;
+
+        for (size_t index = 0; index < count; ++index) {
+            const TraceZoneRecord& zone = buffer->chunks[index / chunkSize].load(std::memory_order_relaxed)[index % chunkSize];
+            file << ",\n{\"name\":";
+            writeJsonString(file, zone.name);
+            file << ",\"cat\":";
+            writeJsonString(file, zone.category);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->trackId << ",\"ts\":" << zone.startUs << ",\"dur\":" << zone.durationUs;
+            if (zone.layer >= 0 || zone.detail) {
+                file << ",\"args\":{";
+                if (zone.layer >= 0) {
+                    file << "\"layer\":" << zone.layer << (zone.detail ? "," : "");
+                }
+                if (zone.detail) {
+                    file << "\"detail\":";
+                    writeJsonString(file, zone.detail);
+                }
+                file << "}";
+            }
+            file << "}";
+        }
+    }
+    file << "\n]}\n";
+    if (!file) {
+        error = "Failed to write trace file: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+PrintTrace& printTrace() {
+    static PrintTrace trace;
+    return trace;
+}
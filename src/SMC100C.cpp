@@ -32,6 +32,7 @@ Can now effectively communicate with serial port
 
 /*------------------------------------ Include Files ---------------------------------------------*/
 #include "SMC100C.h"
+#include "PrintTrace.h"
 #include <serial.h>
 #include <stdio.h>
 #include <string.h>
@@ -470,6 +471,7 @@ Author:
     Mats Grobe, 27/12/2023
 ***************************************************************************************************************************************/
 std::string SMC100C::GetPosition() {
+    TraceZone zone("Position query", "serial");
     my_serial.flushInput();  // Flush the receiver buffer
 
     SetCommand(CommandType::PositionReal, 0.0, CommandGetSetType::Get);
@@ -608,6 +610,7 @@ Author:
 ***************************************************************************************************************************************/
 
 bool SMC100C::SendCurrentCommand() {
+    TraceZone zone("Serial write", "serial", -1, CommandToPrint.Command->CommandChar);
     bool status = true;
 
     // Write the controller address
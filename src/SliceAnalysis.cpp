@@ -0,0 +1,268 @@
+
+#include "SliceAnalysis.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SLICE_ANALYSIS_SSE2
+#endif
+
+/**************************************************************************************************************************************
+Function:
+    buildSliceMask
+Parameters:
+    const sf::Image& image: Slice at projector resolution
+    unsigned int downsample: Projector pixels per mask cell along each axis
+    SliceMask& mask: Receives the coarse mask
+Returns:
+    void
+Description:
+    Marks a mask cell as lit if any pixel inside it has a non-zero colour channel, so thin supporting features are never lost by the
+    downsampling.
+***************************************************************************************************************************************/
+
+void buildSliceMask(const sf::Image& image, unsigned int downsample, SliceMask& mask) {
+    downsample = std::max(1u, downsample);
+    const unsigned int imageWidth = image.getSize().x;
+    const unsigned int imageHeight = image.getSize().y;
+
+    mask.width = (imageWidth + downsample - 1) / downsample;
+    mask.height = (imageHeight + downsample - 1) / downsample;
+    mask.wordsPerRow = (mask.width + 63) / 64;
+    mask.bits.assign(mask.wordsPerRow * mask.height, 0);
+
+    const sf::Uint8* pixels = image.getPixelsPtr();
+    for (unsigned int y = 0; y < imageHeight; ++y) {
+        uint64_t* row = mask.bits.data() + (y / downsample) * mask.wordsPerRow;
+        const sf::Uint8* px = pixels + static_cast<size_t>(y) * imageWidth * 4;
+        for (unsigned int x = 0; x < imageWidth; ++x, px += 4) {
+            if (px[0] | px[1] | px[2]) {
+                unsigned int cell = x / downsample;
+                row[cell / 64] |= uint64_t(1) << (cell % 64);
+            }
+        }
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    andNotCount
+Parameters:
+    const SliceMask& current, const SliceMask& previous: Masks of the same size
+Returns:
+    size_t: Number of cells lit in current but not in previous
+Description:
+    Unsupported area of a slice. The masks are combined two words at a time with SSE2 AND-NOT where available, the scalar loop handles
+    the remaining word and other platforms.
+***************************************************************************************************************************************/
+
+size_t andNotCount(const SliceMask& current, const SliceMask& previous) {
+    const size_t words = std::min(current.bits.size(), previous.bits.size());
+    const uint64_t* a = current.bits.data();
+    const uint64_t* b = previous.bits.data();
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef SLICE_ANALYSIS_SSE2
+    alignas(16) uint64_t lanes[2];
+    for (; i + 2 <= words; i += 2) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_andnot_si128(vb, va));
+        count += std::popcount(lanes[0]) + std::popcount(lanes[1]);
+    }
+#endif
+    for (; i < words; ++i) {
+        count += std::popcount(a[i] & ~b[i]);
+    }
+
+    // Cells beyond the previous mask have nothing below them
+    for (i = words; i < current.bits.size(); ++i) {
+        count += std::popcount(a[i]);
+    }
+    return count;
+}
+
+/**************************************************************************************************************************************
+Function:
+    diffSlices
+Parameters:
+    const SliceMask& current, const SliceMask& previous, float cellAreaMm2
+Returns:
+    SliceDiff: New area and island counts of current on top of previous
+Description:
+    Labels the 4-connected lit regions of the current mask with a flood fill. A region none of whose cells is lit in the previous mask
+    hangs in the resin without any support and is counted as a new island.
+***************************************************************************************************************************************/
+
+SliceDiff diffSlices(const SliceMask& current, const SliceMask& previous, float cellAreaMm2) {
+    SliceDiff diff;
+    diff.newCells = andNotCount(current, previous);
+    diff.newAreaMm2 = static_cast<float>(diff.newCells) * cellAreaMm2;
+
+    const bool samePrevious = previous.width == current.width && previous.height == current.height;
+    std::vector<uint8_t> visited(static_cast<size_t>(current.width) * current.height, 0);
+    std::vector<std::pair<unsigned int, unsigned int>> stack;
+
+    for (unsigned int y = 0; y < current.height; ++y) {
+        for (unsigned int x = 0; x < current.width; ++x) {
+            if (visited[static_cast<size_t>(y) * current.width + x] || !current.test(x, y)) {
+                continue;
+            }
+
+            bool supported = false;
+            stack.push_back({ x, y });
+            visited[static_cast<size_t>(y) * current.width + x] = 1;
+            while (!stack.empty()) {
+                auto [cx, cy] = stack.back();
+                stack.pop_back();
+                supported = supported || (samePrevious && previous.test(cx, cy));
+
+                auto visit = [&](unsigned int nx, unsigned int ny) {
+                    size_t index = static_cast<size_t>(ny) * current.width + nx;
+                    if (!visited[index] && current.test(nx, ny)) {
+                        visited[index] = 1;
+                        stack.push_back({ nx, ny });
+                    }
+                };
+                if (cx > 0) visit(cx - 1, cy);
+                if (cx + 1 < current.width) visit(cx + 1, cy);
+                if (cy > 0) visit(cx, cy - 1);
+                if (cy + 1 < current.height) visit(cx, cy + 1);
+            }
+
+            diff.islands++;
+            if (!supported) {
+                diff.newIslands++;
+            }
+        }
+    }
+
+    return diff;
+}
+
+/**************************************************************************************************************************************
+Function:
+    analyzeSliceDiffs
+Parameters:
+    const SliceSource& source: Slices of the job
+    unsigned int downsample: Projector pixels per mask cell
+    float pixelSize: mm per projector pixel, for the new area in mm²
+    std::vector<SliceInfo>* slices: Receives the ingest result of every slice (see ingestSlices) if not null
+Returns:
+    std::vector<SliceDiff>: One entry per slice, the first slice sits on the build plate and is reported without new area
+Description:
+    Ingest stage for adaptive exposure. The slices are processed in blocks: the masks of a block are built in parallel, then every
+    slice of the block is compared with the one below it, again in parallel on the ingest threads (see setIngestThreadLimit). Only one block of masks plus the last mask of the previous
+    block are kept in memory.
+    The ingest result is taken from the same decoded images, a job that needs both reads every slice only once.
+***************************************************************************************************************************************/
+
+std::vector<SliceDiff> analyzeSliceDiffs(const SliceSource& source, unsigned int downsample, float pixelSize,
+    std::vector<SliceInfo>* slices) {
+    const size_t layerCount = source.layerCount();
+    const size_t blockSize = 64;
+    const float cellSize = pixelSize * static_cast<float>(std::max(1u, downsample));
+    const float cellAreaMm2 = cellSize * cellSize;
+
+    std::vector<SliceDiff> diffs(layerCount);
+    if (slices) {
+        slices->assign(layerCount, SliceInfo{ 0, false, false });
+    }
+    std::vector<SliceMask> masks(blockSize + 1); // masks[0] holds the last slice of the previous block
+
+    auto runParallel = [&](size_t count, auto work) {
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                work(i);
+            }
+        };
+        std::vector<std::thread> workers;
+        unsigned int used = ingestThreadCount(count);
+        for (unsigned int t = 1; t < used; ++t) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& w : workers) {
+            w.join();
+        }
+    };
+
+    for (size_t first = 0; first < layerCount; first += blockSize) {
+        size_t count = std::min(blockSize, layerCount - first);
+
+        runParallel(count, [&](size_t i) {
+            sf::Image image;
+            if (!source.loadLayer(first + i, image)) {
+                std::cerr << "Slice analysis failed to load: " << source.layerName(first + i) << std::endl;
+                masks[i + 1] = SliceMask();
+                return;
+            }
+            buildSliceMask(image, downsample, masks[i + 1]);
+            if (slices) {
+                (*slices)[first + i] = inspectSliceImage(image);
+            }
+        });
+
+        runParallel(count, [&](size_t i) {
+            size_t layer = first + i;
+            if (layer == 0 || masks[i + 1].bits.empty()) {
+                return;
+            }
+            diffs[layer] = diffSlices(masks[i + 1], masks[i], cellAreaMm2);
+        });
+
+        masks[0] = std::move(masks[count]);
+    }
+
+    return diffs;
+}
+
+/**************************************************************************************************************************************
+Function:
+    applySliceDiffs
+Parameters:
+    PrintPlan& plan: Plan to adjust in place
+    const std::vector<SliceDiff>& diffs: Result of analyzeSliceDiffs for plan.source
+    const AdaptiveExposureSettings& settings: Thresholds and factors
+Returns:
+    size_t: Number of adjusted layers
+Description:
+    Raises the exposure of layers with an unsupported new area above the threshold or with new islands, and extends their dark time so
+    the resin can settle before the next layer. All other layers keep their planned settings.
+Notes:
+    - Must run before foldEmptyLayers so every plan entry still maps to its own slice.
+***************************************************************************************************************************************/
+
+size_t applySliceDiffs(PrintPlan& plan, const std::vector<SliceDiff>& diffs, const AdaptiveExposureSettings& settings) {
+    size_t adjusted = 0;
+    for (PlannedLayer& layer : plan.layers) {
+        if (layer.sliceIndex >= diffs.size()) {
+            continue;
+        }
+        const SliceDiff& diff = diffs[layer.sliceIndex];
+
+        float factor = 1.0f;
+        if (diff.newAreaMm2 >= settings.minOverhangAreaMm2) {
+            factor = std::max(factor, settings.overhangExposureFactor);
+        }
+        if (diff.newIslands > 0) {
+            factor = std::max(factor, settings.newIslandExposureFactor);
+        }
+        if (factor <= 1.0f) {
+            continue;
+        }
+
+        layer.exposureFrames = static_cast<int>(std::ceil(layer.exposureFrames * factor));
+        layer.doseMJ *= factor;
+        layer.darkTimeMs += settings.extraDarkTimeMs;
+        adjusted++;
+    }
+    return adjusted;
+}
@@ -0,0 +1,151 @@
+
+#include "SliceRasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Byte order R, G, B, A in memory on little-endian hosts
+    const uint32_t blackPixel = 0xFF000000u;
+    const uint32_t whitePixel = 0xFFFFFFFFu;
+
+    struct ActiveEdge {
+        int lastRow;    // Last scanline crossed by the edge
+        float x;        // Crossing at the current scanline centre
+        float dxdy;     // Change of x per scanline
+    };
+}
+
+/**************************************************************************************************************************************
+Function:
+    scanEvenOdd
+Parameters:
+    const std::vector<EdgeSegment>& edges: Unordered contour edges in pixel coordinates
+    unsigned int width, unsigned int height: Output resolution
+    SpanFunction span: Called as span(row, start, end) for every run of lit pixels [start, end) of a row
+Returns:
+    void
+Description:
+    Scanline walk with the even-odd rule. For every pixel row the crossings of all edges with the row centre are sorted and each pair
+    of crossings is reported as a span. A pixel is lit when its centre lies inside the contour.
+Notes:
+    - The edges do not need to be chained into closed polygons, only the set of edges has to be closed. This lets mesh slices skip
+      the contour stitching step entirely.
+    - Edges are sorted by their first row and kept in an active list, so each row only looks at the edges crossing it.
+***************************************************************************************************************************************/
+
+template <typename SpanFunction>
+static void scanEvenOdd(const std::vector<EdgeSegment>& edges, unsigned int width, unsigned int height, SpanFunction span) {
+    struct PendingEdge {
+        int firstRow;
+        ActiveEdge edge;
+    };
+    std::vector<PendingEdge> pending;
+    pending.reserve(edges.size());
+
+    for (const EdgeSegment& e : edges) {
+        if (e.y0 == e.y1) {
+            continue; // Horizontal edges never cross a row centre
+        }
+        float xa = e.x0, ya = e.y0, xb = e.x1, yb = e.y1;
+        if (ya > yb) {
+            std::swap(xa, xb);
+            std::swap(ya, yb);
+        }
+
+        // Rows whose centre r + 0.5 lies in [ya, yb)
+        int firstRow = static_cast<int>(std::ceil(ya - 0.5f));
+        int lastRow = static_cast<int>(std::ceil(yb - 0.5f)) - 1;
+        if (lastRow < 0 || firstRow >= static_cast<int>(height) || lastRow < firstRow) {
+            continue;
+        }
+
+        float dxdy = (xb - xa) / (yb - ya);
+        float x = xa + (firstRow + 0.5f - ya) * dxdy;
+        pending.push_back(PendingEdge{ firstRow, ActiveEdge{ lastRow, x, dxdy } });
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const PendingEdge& a, const PendingEdge& b) { return a.firstRow < b.firstRow; });
+
+    std::vector<ActiveEdge> active;
+    std::vector<float> crossings;
+    size_t nextPending = 0;
+
+    for (int row = 0; row < static_cast<int>(height); ++row) {
+        while (nextPending < pending.size() && pending[nextPending].firstRow <= row) {
+            ActiveEdge edge = pending[nextPending].edge;
+            // Edges starting above the image are advanced to the first visible row
+            int skipped = row - pending[nextPending].firstRow;
+            edge.x += skipped * edge.dxdy;
+            active.push_back(edge);
+            nextPending++;
+        }
+
+        active.erase(std::remove_if(active.begin(), active.end(), [row](const ActiveEdge& e) { return e.lastRow < row; }), active.end());
+        if (active.empty()) {
+            if (nextPending >= pending.size()) {
+                break;
+            }
+            continue;
+        }
+
+        crossings.clear();
+        for (ActiveEdge& e : active) {
+            crossings.push_back(e.x);
+            e.x += e.dxdy;
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            // Pixels whose centre c + 0.5 lies in [xa, xb)
+            int start = std::max(0, static_cast<int>(std::ceil(crossings[i] - 0.5f)));
+            int end = std::min(static_cast<int>(width), static_cast<int>(std::ceil(crossings[i + 1] - 0.5f)));
+            if (start < end) {
+                span(row, start, end);
+            }
+        }
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    rasterizeEvenOdd
+Parameters:
+    const std::vector<EdgeSegment>& edges: Unordered contour edges in pixel coordinates
+    unsigned int width, unsigned int height: Output resolution
+    SliceBitmap& bitmap: Receives the white-on-black slice, reused between calls to avoid reallocation
+Returns:
+    void
+Description:
+    Fills the spans of scanEvenOdd white on a black slice.
+***************************************************************************************************************************************/
+
+void rasterizeEvenOdd(const std::vector<EdgeSegment>& edges, unsigned int width, unsigned int height, SliceBitmap& bitmap) {
+    bitmap.width = width;
+    bitmap.height = height;
+    bitmap.pixels.assign(static_cast<size_t>(width) * height, blackPixel);
+
+    scanEvenOdd(edges, width, height, [&](int row, int start, int end) {
+        uint32_t* line = bitmap.pixels.data() + static_cast<size_t>(row) * width;
+        std::fill(line + start, line + end, whitePixel);
+    });
+}
+
+/**************************************************************************************************************************************
+Function:
+    countEvenOdd
+Parameters:
+    const std::vector<EdgeSegment>& edges: Unordered contour edges in pixel coordinates
+    unsigned int width, unsigned int height: Output resolution
+Returns:
+    size_t: Pixels rasterizeEvenOdd would light
+Description:
+    Sums the span lengths of scanEvenOdd without writing a bitmap, the ingest only needs the lit pixel count of a layer.
+***************************************************************************************************************************************/
+
+size_t countEvenOdd(const std::vector<EdgeSegment>& edges, unsigned int width, unsigned int height) {
+    size_t lit = 0;
+    scanEvenOdd(edges, width, height, [&](int, int start, int end) {
+        lit += static_cast<size_t>(end - start);
+    });
+    return lit;
+}
@@ -0,0 +1,191 @@
+
+#include "SliceSource.h"
+#include "PrintTrace.h"
+#include <algorithm>
+#include <iostream>
+
+/**************************************************************************************************************************************
+Function:
+    inspectSliceImage
+Parameters:
+    const sf::Image& image: Decoded slice
+Returns:
+    SliceInfo: Lit pixel count and empty flag of the slice
+Description:
+    Counts every pixel with a non-zero colour channel, alpha is ignored.
+***************************************************************************************************************************************/
+
+SliceInfo inspectSliceImage(const sf::Image& image) {
+    const sf::Uint8* pixels = image.getPixelsPtr();
+    size_t pixelCount = static_cast<size_t>(image.getSize().x) * image.getSize().y;
+    size_t lit = 0;
+    for (size_t p = 0; p < pixelCount; ++p) {
+        const sf::Uint8* px = pixels + p * 4;
+        lit += (px[0] | px[1] | px[2]) != 0;
+    }
+
+    return SliceInfo{ lit, lit == 0, true };
+}
+
+/**************************************************************************************************************************************
+Function:
+    SliceSource::inspectLayer
+Parameters:
+    size_t index: Layer to inspect
+Returns:
+    SliceInfo: Lit pixel count and empty flag of the layer
+Description:
+    Default ingest of a layer: the layer is produced through loadLayer and its lit pixels are counted (see inspectSliceImage).
+Notes:
+    - Layers that cannot be produced are reported as non-empty so the print loop still attempts them and logs the failure.
+***************************************************************************************************************************************/
+
+SliceInfo SliceSource::inspectLayer(size_t index) const {
+    sf::Image image;
+    if (!loadLayer(index, image)) {
+        std::cerr << "Ingest failed to load: " << layerName(index) << std::endl;
+        return SliceInfo{ 0, false, false };
+    }
+    return inspectSliceImage(image);
+}
+
+/**************************************************************************************************************************************
+Function:
+    SlicePrefetcher::SlicePrefetcher
+Parameters:
+    const SliceSource& source: Source producing the frames, must outlive the prefetcher
+    const std::vector<size_t>& order: Layer indices in the order the print loop will acquire them
+    size_t depth: Number of frames that may be ready ahead of the print loop
+    unsigned int threadCount: Worker threads decoding or rasterizing the frames
+Returns:
+    None
+Description:
+    Starts the workers of the ready-frame queue. Each worker claims the next position of the order as soon as a slot is free, produces
+    the frame outside the lock and marks the slot ready. The print loop acquires the frames in order and releases them after the
+    texture upload, which frees the slot for the layer depth positions further on.
+Notes:
+    - Only the texture upload remains on the print loop thread, decoding and slicing run entirely on the workers.
+***************************************************************************************************************************************/
+
+SlicePrefetcher::SlicePrefetcher(const SliceSource& source, const std::vector<size_t>& order, size_t depth, unsigned int threadCount)
+    : source(source), order(order), slots(std::max<size_t>(1, depth)) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned int t = 0; t < threadCount; ++t) {
+        workers.emplace_back(&SlicePrefetcher::workerLoop, this);
+    }
+}
+
+SlicePrefetcher::~SlicePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void SlicePrefetcher::workerLoop() {
+    printTrace().nameThread("Slice loader");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this]() {
+            return stopping || (nextToProduce < order.size() && nextToProduce < released + slots.size());
+        });
+        if (stopping) {
+            return;
+        }
+
+        size_t position = nextToProduce++;
+        size_t layerIndex = order[position]; // The order may grow while the lock is released
+        Slot& slot = slots[position % slots.size()];
+
+        lock.unlock();
+        bool ok;
+        {
+            TraceZone zone("Load slice", "slices", static_cast<int64_t>(layerIndex));
+            ok = source.loadLayer(layerIndex, slot.image);
+        }
+        if (!ok) {
+            std::cerr << "Failed to load slice: " << source.layerName(layerIndex) << std::endl;
+        }
+        lock.lock();
+
+        slot.position = position;
+        slot.ok = ok;
+        slot.ready = true;
+        changed.notify_all();
+    }
+}
+
+const sf::Image* SlicePrefetcher::acquire(size_t position) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (position >= order.size()) {
+        return nullptr;
+    }
+
+    Slot& slot = slots[position % slots.size()];
+    changed.wait(lock, [&]() { return slot.ready && slot.position == position; });
+    return slot.ok ? &slot.image : nullptr;
+}
+
+void SlicePrefetcher::release(size_t position) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[position % slots.size()].ready = false;
+        released = position + 1;
+    }
+    changed.notify_all();
+}
+
+void SlicePrefetcher::append(size_t layerIndex) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(layerIndex);
+    }
+    changed.notify_all();
+}
+
+/**************************************************************************************************************************************
+Function:
+    PreloadedSliceSource::PreloadedSliceSource
+Parameters:
+    std::shared_ptr<SliceSource> source: Source of the job
+    const std::vector<size_t>& layers: Layers to decode now, usually the first ones of the plan
+Returns:
+    None
+Description:
+    Decodes the layers through the wrapped source and keeps them until the print loads them. A layer that fails to decode is not
+    kept, loading it during the print then tries the wrapped source again and reports the failure there.
+***************************************************************************************************************************************/
+
+PreloadedSliceSource::PreloadedSliceSource(std::shared_ptr<SliceSource> source, const std::vector<size_t>& layers)
+    : source(std::move(source)) {
+    for (size_t index : layers) {
+        TraceZone zone("Preload slice", "slices", static_cast<int64_t>(index));
+        // Decoded in place, sf::Image cannot be moved into the map
+        if (!this->source->loadLayer(index, preloaded[index])) {
+            preloaded.erase(index);
+        }
+    }
+}
+
+bool PreloadedSliceSource::loadLayer(size_t index, sf::Image& image) const {
+    std::map<size_t, sf::Image>::node_type layer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        layer = preloaded.extract(index);
+    }
+    if (layer) {
+        // sf::Image declares no move operations, the pixels are copied once, outside the lock
+        image = std::move(layer.mapped());
+        return true;
+    }
+    return source->loadLayer(index, image);
+}
+
+size_t PreloadedSliceSource::preloadedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return preloaded.size();
+}
@@ -0,0 +1,198 @@
+
+#include "StreamingSource.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/**************************************************************************************************************************************
+Function:
+    StreamingDirectorySource::StreamingDirectorySource
+Parameters:
+    const std::string& directoryPath: Job folder the slicer writes into
+    const SliceSourceSettings& settings: streamEndMarker and streamIdleTimeoutMs decide when the job is complete
+    PathOrder order: Sort order of the slice files, customSort for the exported SEC_ images
+Returns:
+    None
+Description:
+    Reads the slices already present and starts the watcher thread, so the print can start before the slicer has finished. The job
+    is complete once the end marker file appears or no new slice arrived for streamIdleTimeoutMs.
+***************************************************************************************************************************************/
+
+StreamingDirectorySource::StreamingDirectorySource(const std::string& directoryPath, const SliceSourceSettings& settings, PathOrder order)
+    : directoryPath(directoryPath), settings(settings), order(order), lastChange(std::chrono::steady_clock::now()) {
+    rescan();
+    watcher = std::thread(&StreamingDirectorySource::watchLoop, this);
+}
+
+StreamingDirectorySource::~StreamingDirectorySource() {
+    stopping = true;
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+}
+
+size_t StreamingDirectorySource::layerCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return imagePaths.size();
+}
+
+std::string StreamingDirectorySource::layerName(size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return index < imagePaths.size() ? imagePaths[index] : std::string();
+}
+
+bool StreamingDirectorySource::loadLayer(size_t index, sf::Image& image) const {
+    std::string path = layerName(index);
+    return !path.empty() && image.loadFromFile(path);
+}
+
+bool StreamingDirectorySource::isComplete() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete;
+}
+
+/**************************************************************************************************************************************
+Function:
+    StreamingDirectorySource::rescan
+Parameters:
+    None
+Returns:
+    void
+Description:
+    Lists the job folder and accepts the slices that are completely written. Files are only ever appended, a slice that sorts before
+    an already accepted one is appended at the end with a warning instead of reordering layers that may already be printed.
+Notes:
+    - Files ending in .tmp or .part and the end marker itself are not slices.
+    - Only the files that are not accepted yet are sorted, usually the one or two the slicer wrote since the last scan. Late in a
+      large job the accepted slices would otherwise be sorted by their file name pattern on every wake.
+***************************************************************************************************************************************/
+
+void StreamingDirectorySource::rescan() {
+    std::vector<std::string> files;
+    size_t fileCount = 0;
+    bool markerFound = false;
+    try {
+        for (const auto& entry : fs::directory_iterator(directoryPath)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            std::string fileName = entry.path().filename().string();
+            std::string extension = entry.path().extension().string();
+            if (!settings.streamEndMarker.empty() && fileName == settings.streamEndMarker) {
+                markerFound = true;
+            }
+            else if (extension != ".tmp" && extension != ".part") {
+                fileCount++;
+                std::string path = entry.path().string();
+                if (accepted.count(path) == 0) { // Only rescan writes accepted, it is read here without the lock
+                    files.push_back(std::move(path));
+                }
+            }
+        }
+    }
+    catch (const fs::filesystem_error& e) {
+        std::cerr << "Filesystem error: " << e.what() << '\n';
+        return;
+    }
+    std::sort(files.begin(), files.end(), order);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (fileCount != filesSeen) {
+        filesSeen = fileCount;
+        lastChange = now;
+    }
+
+    bool idle = settings.streamIdleTimeoutMs > 0 && fileCount > 0 &&
+        now - lastChange > std::chrono::milliseconds(settings.streamIdleTimeoutMs);
+    if ((markerFound || idle) && !complete) {
+        complete = true;
+        if (!markerFound) {
+            std::cerr << "No new slices for " << settings.streamIdleTimeoutMs << " ms, treating the job as complete." << std::endl;
+        }
+    }
+
+    // The newest file may still be open in the slicer, files holds the ones not accepted yet
+    size_t written = complete ? files.size() : (files.empty() ? 0 : files.size() - 1);
+    for (size_t i = 0; i < written; ++i) {
+        if (accepted.insert(files[i]).second) {
+            if (!imagePaths.empty() && order(files[i], imagePaths.back())) {
+                std::cerr << "Slice arrived out of order, appending it at the end: " << files[i] << std::endl;
+            }
+            imagePaths.push_back(files[i]);
+        }
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    StreamingDirectorySource::watchLoop
+Parameters:
+    None
+Returns:
+    void
+Description:
+    Waits for changes to the job folder and rescans it. The wait uses the change notifications of the operating system
+    (FindFirstChangeNotification on Windows, inotify on Linux) with a short timeout, so the idle timeout is still evaluated and folders
+    without notification support, such as some network shares, are polled instead.
+***************************************************************************************************************************************/
+
+void StreamingDirectorySource::watchLoop() {
+    const int waitMs = 200;
+
+#ifdef _WIN32
+    HANDLE change = FindFirstChangeNotificationA(directoryPath.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+
+    while (!stopping && !isComplete()) {
+        if (change == INVALID_HANDLE_VALUE) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+        else if (WaitForSingleObject(change, waitMs) == WAIT_OBJECT_0) {
+            FindNextChangeNotification(change);
+        }
+        rescan();
+    }
+
+    if (change != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(change);
+    }
+#else
+    int fd = inotify_init1(IN_NONBLOCK);
+    if (fd >= 0 && inotify_add_watch(fd, directoryPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(fd);
+        fd = -1;
+    }
+
+    while (!stopping && !isComplete()) {
+        if (fd < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+        else {
+            pollfd descriptor{ fd, POLLIN, 0 };
+            if (poll(&descriptor, 1, waitMs) > 0) {
+                char events[4096];
+                while (read(fd, events, sizeof(events)) > 0) {
+                    // Drain the queue, the folder is rescanned as a whole
+                }
+            }
+        }
+        rescan();
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
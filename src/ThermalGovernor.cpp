@@ -0,0 +1,131 @@
+
+#include "ThermalGovernor.h"
+#include <algorithm>
+#include <cmath>
+
+ThermalGovernor::ThermalGovernor(const ThermalGovernorSettings& settings) : settings(settings) {
+}
+
+void ThermalGovernor::addSample(Clock::time_point time, double temperature) {
+    samples.emplace_back(time, temperature);
+    while (!samples.empty() && time - samples.front().first > std::chrono::seconds(settings.trendWindowSeconds)) {
+        samples.pop_front();
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    ThermalGovernor::projectedTemperature
+Parameters:
+    None
+Returns:
+    double: Expected temperature in lookaheadSeconds, the latest temperature while fewer than two samples exist
+Description:
+    Fits a line through the samples of the trend window by least squares and extends it by the lookahead. A falling trend is not
+    projected, the governor only needs to know whether the engine is going to run hot.
+***************************************************************************************************************************************/
+
+double ThermalGovernor::projectedTemperature() const {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    double latest = samples.back().second;
+    if (samples.size() < 2) {
+        return latest;
+    }
+
+    Clock::time_point origin = samples.front().first;
+    double sumT = 0.0, sumY = 0.0, sumTT = 0.0, sumTY = 0.0;
+    for (const auto& sample : samples) {
+        double t = std::chrono::duration<double>(sample.first - origin).count();
+        sumT += t;
+        sumY += sample.second;
+        sumTT += t * t;
+        sumTY += t * sample.second;
+    }
+    double n = static_cast<double>(samples.size());
+    double denominator = n * sumTT - sumT * sumT;
+    if (denominator <= 0.0) {
+        return latest;
+    }
+    double slope = (n * sumTY - sumT * sumY) / denominator; // Celsius per second
+
+    return latest + std::max(0.0, slope) * settings.lookaheadSeconds;
+}
+
+/**************************************************************************************************************************************
+Function:
+    ThermalGovernor::update
+Parameters:
+    Clock::time_point now
+Returns:
+    bool: True if the current limit changed
+Description:
+    Lowers the current limit by one step while the projected temperature is above the target and raises it again once the projection
+    is below the target minus the hysteresis. Changes are at least adjustIntervalSeconds apart, since the light engine needs a settle
+    time after every current change and the temperature reacts with a delay.
+***************************************************************************************************************************************/
+
+bool ThermalGovernor::update(Clock::time_point now) {
+    if (!settings.enabled || samples.empty()) {
+        return false;
+    }
+    if (changed && now - lastChange < std::chrono::seconds(settings.adjustIntervalSeconds)) {
+        return false;
+    }
+
+    double projected = projectedTemperature();
+    int newLimit = limit;
+    if (projected > settings.targetTemperature) {
+        newLimit = std::max(settings.minCurrent, limit - settings.currentStep);
+    }
+    else if (projected < settings.targetTemperature - settings.hysteresis) {
+        newLimit = std::min(255, limit + settings.currentStep);
+    }
+
+    if (newLimit == limit) {
+        return false;
+    }
+    limit = newLimit;
+    lastChange = now;
+    changed = true;
+    return true;
+}
+
+/**************************************************************************************************************************************
+Function:
+    ThermalGovernor::govern
+Parameters:
+    int intensity: Current requested by the layer
+    int exposureFrames: Frames requested by the layer
+    double temperature: Latest light engine temperature, used for the calibration lookup
+    const IntensityCalibration* calibration: Measured irradiance, or null
+Returns:
+    GovernedExposure: The requested exposure if it is within the limit, otherwise the limit with the frames scaled by the ratio of
+    the irradiances
+***************************************************************************************************************************************/
+
+GovernedExposure ThermalGovernor::govern(int intensity, int exposureFrames, double temperature,
+    const IntensityCalibration* calibration) const {
+    if (!settings.enabled || intensity <= limit) {
+        return GovernedExposure{ intensity, exposureFrames };
+    }
+
+    double ratio = static_cast<double>(intensity) / limit;
+    if (calibration && !calibration->empty()) {
+        double reduced = calibration->irradiance(limit, temperature);
+        if (reduced > 0.0) {
+            ratio = calibration->irradiance(intensity, temperature) / reduced;
+        }
+    }
+    int frames = static_cast<int>(std::ceil(exposureFrames * std::max(1.0, ratio) - 1e-9));
+    return GovernedExposure{ limit, frames };
+}
+
+bool ThermalGovernor::needsCooldown() const {
+    return settings.enabled && !samples.empty() && samples.back().second >= settings.cooldownTemperature;
+}
+
+bool ThermalGovernor::cooledDown() const {
+    return samples.empty() || samples.back().second < settings.cooldownTemperature - settings.hysteresis;
+}
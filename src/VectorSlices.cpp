@@ -0,0 +1,312 @@
+
+#include "VectorSlices.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Value of an attribute inside a tag, empty if the tag does not carry it
+    std::string getAttribute(const std::string& tag, const std::string& attribute) {
+        size_t pos = 0;
+        while ((pos = tag.find(attribute, pos)) != std::string::npos) {
+            bool boundary = pos > 0 && std::isspace(static_cast<unsigned char>(tag[pos - 1]));
+            size_t eq = pos + attribute.size();
+            while (eq < tag.size() && std::isspace(static_cast<unsigned char>(tag[eq]))) eq++;
+            if (boundary && eq + 1 < tag.size() && tag[eq] == '=') {
+                size_t quote = eq + 1;
+                while (quote < tag.size() && std::isspace(static_cast<unsigned char>(tag[quote]))) quote++;
+                if (quote < tag.size() && (tag[quote] == '"' || tag[quote] == '\'')) {
+                    size_t end = tag.find(tag[quote], quote + 1);
+                    if (end != std::string::npos) {
+                        return tag.substr(quote + 1, end - quote - 1);
+                    }
+                }
+            }
+            pos += attribute.size();
+        }
+        return std::string();
+    }
+
+    // Reads the next number of a points or path list, skipping separators
+    bool nextNumber(const char*& cursor, float& value) {
+        while (*cursor && (std::isspace(static_cast<unsigned char>(*cursor)) || *cursor == ',')) cursor++;
+        char* end;
+        value = std::strtof(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+        return true;
+    }
+
+    void addPolygonPoints(const std::string& pointList, VectorLayer& layer) {
+        const char* cursor = pointList.c_str();
+        uint32_t start = static_cast<uint32_t>(layer.points.size());
+        float x, y;
+        while (nextNumber(cursor, x) && nextNumber(cursor, y)) {
+            layer.points.push_back(x);
+            layer.points.push_back(y);
+        }
+        if (layer.points.size() - start >= 6) {
+            layer.contourStarts.push_back(start);
+        }
+        else {
+            layer.points.resize(start); // Fewer than three points enclose nothing
+        }
+    }
+
+    // Straight-line subset of the SVG path syntax, curves are replaced by a line to their end point
+    void addPathPoints(const std::string& data, VectorLayer& layer) {
+        const char* cursor = data.c_str();
+        char command = 'M';
+        float x = 0.0f, y = 0.0f, startX = 0.0f, startY = 0.0f;
+        uint32_t contourStart = static_cast<uint32_t>(layer.points.size());
+        bool closed = false; // A drawing command after Z without a move starts the next subpath at the close point
+
+        auto closeContour = [&]() {
+            if (layer.points.size() - contourStart >= 6) {
+                layer.contourStarts.push_back(contourStart);
+            }
+            else {
+                layer.points.resize(contourStart);
+            }
+            contourStart = static_cast<uint32_t>(layer.points.size());
+        };
+
+        while (true) {
+            while (*cursor && (std::isspace(static_cast<unsigned char>(*cursor)) || *cursor == ',')) cursor++;
+            if (!*cursor) {
+                break;
+            }
+            if (std::isalpha(static_cast<unsigned char>(*cursor))) {
+                command = *cursor++;
+                if (command == 'Z' || command == 'z') {
+                    closeContour();
+                    x = startX;
+                    y = startY;
+                    closed = true;
+                }
+                continue;
+            }
+
+            bool relative = std::islower(static_cast<unsigned char>(command)) != 0;
+            float values[7];
+            int count;
+            switch (std::toupper(static_cast<unsigned char>(command))) {
+            case 'H': case 'V': count = 1; break;
+            case 'C': count = 6; break;
+            case 'S': case 'Q': count = 4; break;
+            case 'A': count = 7; break;
+            default: count = 2; break;
+            }
+            for (int i = 0; i < count; ++i) {
+                if (!nextNumber(cursor, values[i])) {
+                    closeContour();
+                    return;
+                }
+            }
+
+            float nx = x, ny = y;
+            switch (std::toupper(static_cast<unsigned char>(command))) {
+            case 'H': nx = relative ? x + values[0] : values[0]; break;
+            case 'V': ny = relative ? y + values[0] : values[0]; break;
+            default:
+                nx = relative ? x + values[count - 2] : values[count - 2];
+                ny = relative ? y + values[count - 1] : values[count - 1];
+                break;
+            }
+
+            if (command == 'M' || command == 'm') {
+                closeContour();
+                startX = nx;
+                startY = ny;
+                command = relative ? 'l' : 'L'; // Further pairs after a move are line segments
+            }
+            else if (closed) {
+                layer.points.push_back(startX);
+                layer.points.push_back(startY);
+            }
+            closed = false;
+            x = nx;
+            y = ny;
+            layer.points.push_back(x);
+            layer.points.push_back(y);
+        }
+        closeContour();
+    }
+}
+
+/**************************************************************************************************************************************
+Function:
+    loadSvgLayers
+Parameters:
+    const std::string& filePath: SVG file with one top-level group per layer
+    std::vector<VectorLayer>& layers: Receives the contours of each layer
+    std::string& error: Reason of the failure if the function returns false
+Returns:
+    bool: True if at least one layer was read
+Description:
+    Reads layered SVG exports as written by slicers such as Slic3r: every top-level <g> element is one layer and holds <polygon>
+    and <path> elements in mm. Holes need no special marking since the slices are filled with the even-odd rule. Shapes outside any
+    group form a layer of their own.
+Notes:
+    - Only the geometry is read, transforms and styles are ignored.
+***************************************************************************************************************************************/
+
+bool loadSvgLayers(const std::string& filePath, std::vector<VectorLayer>& layers, std::string& error) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        error = "Cannot open vector slice file: " + filePath;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    layers.clear();
+    int depth = 0;
+    bool looseLayerOpen = false;
+    size_t pos = 0;
+
+    while ((pos = text.find('<', pos)) != std::string::npos) {
+        size_t end = text.find('>', pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string tag = text.substr(pos, end - pos + 1);
+        pos = end + 1;
+
+        size_t nameEnd = 1;
+        while (nameEnd < tag.size() && !std::isspace(static_cast<unsigned char>(tag[nameEnd])) && tag[nameEnd] != '>' && tag[nameEnd] != '/') {
+            nameEnd++;
+        }
+        std::string name = tag.substr(1, nameEnd - 1);
+        bool selfClosing = tag.size() >= 2 && tag[tag.size() - 2] == '/';
+
+        if (name == "g" && !selfClosing) {
+            if (depth++ == 0) {
+                layers.emplace_back();
+                looseLayerOpen = false;
+            }
+        }
+        else if (tag.compare(0, 3, "</g") == 0) {
+            depth = std::max(0, depth - 1);
+        }
+        else if (name == "polygon" || name == "path") {
+            if (depth == 0 && !looseLayerOpen) {
+                layers.emplace_back();
+                looseLayerOpen = true;
+            }
+            if (name == "polygon") {
+                addPolygonPoints(getAttribute(tag, "points"), layers.back());
+            }
+            else {
+                addPathPoints(getAttribute(tag, "d"), layers.back());
+            }
+        }
+    }
+
+    if (layers.empty()) {
+        error = "No layers found in vector slice file: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************************************************************************************
+Function:
+    VectorSliceSource::VectorSliceSource
+Parameters:
+    std::vector<VectorLayer> layers, const SliceSourceSettings& settings, const std::string& name
+Returns:
+    None
+Description:
+    Keeps the contours of all layers in memory and centres their common bounding box on the projector image. The slices are only
+    rasterized when the ready-frame queue asks for them, at the resolution and pixel size of the printer.
+***************************************************************************************************************************************/
+
+VectorSliceSource::VectorSliceSource(std::vector<VectorLayer> layers, const SliceSourceSettings& settings, const std::string& name)
+    : layers(std::move(layers)), settings(settings), name(name) {
+
+    float minX = std::numeric_limits<float>::max(), minY = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest(), maxY = std::numeric_limits<float>::lowest();
+    for (const VectorLayer& layer : this->layers) {
+        for (size_t i = 0; i + 1 < layer.points.size(); i += 2) {
+            minX = std::min(minX, layer.points[i]);
+            maxX = std::max(maxX, layer.points[i]);
+            minY = std::min(minY, layer.points[i + 1]);
+            maxY = std::max(maxY, layer.points[i + 1]);
+        }
+    }
+    if (minX <= maxX) {
+        centerX = 0.5f * (minX + maxX);
+        centerY = 0.5f * (minY + maxY);
+    }
+}
+
+std::shared_ptr<VectorSliceSource> VectorSliceSource::open(const std::string& filePath, const SliceSourceSettings& settings, std::string& error) {
+    if (settings.pixelSize <= 0.0f) {
+        error = "Pixel size must be positive to rasterize vector slices.";
+        return nullptr;
+    }
+
+    std::vector<VectorLayer> layers;
+    if (!loadSvgLayers(filePath, layers, error)) {
+        return nullptr;
+    }
+    return std::make_shared<VectorSliceSource>(std::move(layers), settings, fs::path(filePath).filename().string());
+}
+
+std::string VectorSliceSource::layerName(size_t index) const {
+    return name + " layer " + std::to_string(index);
+}
+
+void VectorSliceSource::layerEdges(size_t index, std::vector<EdgeSegment>& edges) const {
+    edges.clear();
+    if (index >= layers.size()) {
+        return;
+    }
+
+    const VectorLayer& layer = layers[index];
+    const float scale = 1.0f / settings.pixelSize;
+    const float offsetX = 0.5f * settings.width;
+    const float offsetY = 0.5f * settings.height;
+    auto toPixelX = [&](float x) { return (x - centerX) * scale + offsetX; };
+    auto toPixelY = [&](float y) { return (y - centerY) * scale + offsetY; };
+
+    edges.reserve(layer.points.size() / 2);
+    for (size_t c = 0; c < layer.contourStarts.size(); ++c) {
+        size_t first = layer.contourStarts[c];
+        size_t last = (c + 1 < layer.contourStarts.size()) ? layer.contourStarts[c + 1] : layer.points.size();
+        for (size_t i = first; i < last; i += 2) {
+            // The last point connects back to the first to close the contour
+            size_t j = (i + 2 < last) ? i + 2 : first;
+            edges.push_back(EdgeSegment{ toPixelX(layer.points[i]), toPixelY(layer.points[i + 1]),
+                toPixelX(layer.points[j]), toPixelY(layer.points[j + 1]) });
+        }
+    }
+}
+
+bool VectorSliceSource::loadLayer(size_t index, sf::Image& image) const {
+    std::vector<EdgeSegment> edges;
+    SliceBitmap bitmap;
+    layerEdges(index, edges);
+    rasterizeEvenOdd(edges, settings.width, settings.height, bitmap);
+    image.create(bitmap.width, bitmap.height, bitmap.data());
+    return true;
+}
+
+SliceInfo VectorSliceSource::inspectLayer(size_t index) const {
+    // A layer without contours is empty without rasterizing it
+    if (index >= layers.size() || layers[index].contourStarts.empty()) {
+        return SliceInfo{ 0, true, true };
+    }
+    std::vector<EdgeSegment> edges;
+    layerEdges(index, edges);
+    size_t lit = countEvenOdd(edges, settings.width, settings.height);
+    return SliceInfo{ lit, lit == 0, true };
+}
@@ -1,7 +1,8 @@
 
 #include <SFML/Graphics.hpp>
 #include "SMC100C.h"
-#include "LibUSB3DPrinter.h" // Include the provided header file
+#include "LightEngineDriver.h"
+#include "LightEngineTrace.h"
 #include <serial.h>
 #include <stdio.h>
 #include <string.h>
@@ -17,8 +18,27 @@
 #include <regex>
 #include <fstream>
 #include <sstream>
+#include <cctype>
+#include <cmath>
 #include <tuple>
 #include <unordered_map>
+#include "PrintPlan.h"
+#include "SliceSource.h"
+#include "MeshSlicer.h"
+#include "VectorSlices.h"
+#include "StreamingSource.h"
+#include "SliceAnalysis.h"
+#include "LayerSettingsParser.h"
+#include "PlanFile.h"
+#include "LiveAdjustment.h"
+#include "PlanRules.h"
+#include "EventLog.h"
+#include "Metrics.h"
+#include "PrintTrace.h"
+#include "LayerReport.h"
+#include <optional>
+#include <ctime>
+#include <iomanip>
 
 namespace fs = std::filesystem;
 
@@ -75,7 +95,7 @@ Returns:
 Description:
     This function attempts to initialize the motorized stage controller and then queries it for its current status, including
     position, velocity, acceleration, and positive/negative limits. It performs a homing operation before retrieving the values.
-    If initialization fails, the program exits. The function assumes that the controller's responses follow a specific format,
+    If initialization fails, a status with connected false is returned. The function assumes that the controller's responses follow a specific format,
     and it extracts numerical values from these responses for the status struct. If any operation fails or an exception occurs,
     the function logs the error but attempts to continue gracefully, returning whatever status information was successfully gathered.
 Notes:
@@ -84,24 +104,28 @@ Notes:
     - Uses `std::remove` and `std::stof` for string manipulation and conversion to float, respectively.
     - Any exceptions caught during the retrieval of stage parameters are logged, and the function attempts to continue,
       potentially returning partial or default status information.
-    - Exiting the program on initialization failure indicates that the function considers successful controller communication
-      critical for further operations.
+    - It runs on the hardware executor's stage thread, a failed controller open is therefore reported through the status and
+      left to the caller to show.
+    - cancelled is checked before the homing and between the queries, a cancelled check returns a zeroed status.
 Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
 
 
-StageStatus checkStage() {
+StageStatus checkStage(std::function<bool()> cancelled) {
 
     SMC100C controller;
+    StageStatus status{};
+    auto stop = [&]() { return cancelled && cancelled(); };
 
     if (!initializeController(controller)) {
-
-        exit(0);
+        std::cerr << "checkStage: the controller could not be opened" << std::endl;
+        return status;
+    }
+    status.connected = true;
+    if (stop()) {
+        return status;
     }
-    
-    
-    
 
     // Test Home
     std::cout << "Testing Home... ";
@@ -114,8 +138,6 @@ StageStatus checkStage() {
 
     std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
 
-    StageStatus status;
-
     // Assuming GetPosition, GetVelocity, etc., return strings like "Pos:123.45"
     try {
         std::string pos = controller.GetPosition();
@@ -123,23 +145,35 @@ StageStatus checkStage() {
         pos.erase(std::remove(pos.begin(), pos.end(), '\r'), pos.end()); // Remove carriage return
         std::cout << "Position: " << pos.substr(3, 6) << " mm" << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
+        if (stop()) {
+            return status;
+        }
         std::string vel = controller.GetVelocity();
         vel.erase(std::remove(vel.begin(), vel.end(), '\n'), vel.end()); // Remove newline
         vel.erase(std::remove(vel.begin(), vel.end(), '\r'), vel.end()); // Remove carriage return
         std::cout << "Velocity: " << vel.substr(3, 4) << " mm/s" << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
+        if (stop()) {
+            return status;
+        }
 
         std::string acc = controller.GetAcceleration();
         acc.erase(std::remove(acc.begin(), acc.end(), '\n'), acc.end()); // Remove newline
         acc.erase(std::remove(acc.begin(), acc.end(), '\r'), acc.end()); // Remove carriage return
         std::cout << "Acceleration: " << acc.substr(3, 2) << " mm/s2" << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
+        if (stop()) {
+            return status;
+        }
 
         std::string pL = controller.GetPositiveLimit();
         pL.erase(std::remove(pL.begin(), pL.end(), '\n'), pL.end()); // Remove newline
         pL.erase(std::remove(pL.begin(), pL.end(), '\r'), pL.end()); // Remove carriage return
         std::cout << "Positive Limit: " << pL.substr(3, 2) << " mm" << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
+        if (stop()) {
+            return status;
+        }
 
         std::string nL = controller.GetNegativeLimit();
         nL.erase(std::remove(nL.begin(), nL.end(), '\n'), nL.end()); // Remove newline
@@ -185,6 +219,7 @@ StageStatus checkStageDummy() {
     StageStatus status;
 
     // Assign some dummy values
+    status.connected = true;
     status.position = 123.45f;
     status.velocity = 67.89f;
     status.acceleration = 10.11f;
@@ -214,23 +249,25 @@ Notes:
 Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
+
 // Real function to get the status from the light engine
 LightEngineStatus getLightEngineStatus() {
-    LightEngineStatus status;
+    LightEngineStatus status{};
+    LightEngineDriver& engine = lightEngine();
 
     // Assuming you have setup code to initialize and work with your light engine
     // Here, just call the APIs and assign the values to your structure
-    status.status = GetStatus();
-    GetCurrent(0, &status.current); // Assuming index 0 for simplicity
-    status.sysStatus = GetSysStatus();
+    status.status = engine.getStatus();
+    engine.getCurrent(status.current);
+    status.sysStatus = engine.getSysStatus();
 
-    unsigned char flag;
-    if (GetLedDefaultStatus(&flag)) {
-        status.ledDefaultStatus = flag ? true : false;
+    bool flag;
+    if (engine.getLedDefaultStatus(flag)) {
+        status.ledDefaultStatus = flag;
     }
 
     int16_t temp;
-    if (GetTemperature(&temp)) {
+    if (engine.getTemperature(temp)) {
         status.temperature = temp;
     }
 
@@ -271,27 +308,38 @@ LightEngineStatus getLightEngineStatusDummy() {
 Function:
     TurnLightEngineOn
 Parameters:
-    None
+    std::function<bool()> isCancelled: Polled during the warm-up, returning true aborts it; may be empty
+    WarmUpProgressCallback onProgress: Called about once per second and whenever the system status changes; may be empty
+    std::chrono::seconds timeout: Longest warm-up before the light engine is switched off again
 Returns:
-    None
+    LightEngineWarmUpResult: Outcome, duration and last system status of the warm-up
 Description:
     Initiates the process of turning the light engine on by checking the connectivity with USB devices, selecting a device based on
-    predefined criteria (e.g., index), and sending a command to power on the light engine. It includes checks for device availability,
-    online status, and monitors the system status until the light engine is fully operational or a timeout occurs.
+    predefined criteria (e.g., index), and sending a command to power on the light engine. It then waits until the system status
+    reports the light engine as ready, the warm-up is cancelled or the timeout passes.
 Notes:
-    - The function assumes the use of specific APIs for USB device enumeration, selection, and status checking.
-    - It demonstrates a pattern of waiting for a condition (light engine ready) within a timeout period, which is critical for operations
-      requiring confirmation of device readiness.
+    - Blocks the calling thread for the whole warm-up, the GUI runs it on a pool thread so homing and other setup can continue.
+    - A cancelled or timed-out warm-up switches the power off again and reports it in the result; the process is never terminated.
+    - The driver serializes its calls, so the stage setup may set the current while the light engine warms up.
 Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
 
-void TurnLightEngineOn() {
+LightEngineWarmUpResult TurnLightEngineOn(std::function<bool()> isCancelled, WarmUpProgressCallback onProgress, std::chrono::seconds timeout) {
 
     std::cout << "Checking connectivity with the Light Engine..." << std::endl;
 
+    LightEngineWarmUpResult result{ WarmUpOutcome::Ready, std::chrono::milliseconds(0), 0, "" };
+    auto inittime = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - inittime);
+    };
+
+    LightEngineDriver& engine = lightEngine();
+    LightEnginePhaseScope tracePhase(LightEnginePhase::WarmUp);
+
     // Enumerate USB devices and check if any is available
-    unsigned char numDevices = EnumUsbDevice();
+    unsigned char numDevices = engine.enumerateDevices();
     if (numDevices == 0) {
         std::cerr << "No USB devices found." << std::endl;
     }
@@ -301,67 +349,77 @@ void TurnLightEngineOn() {
 
     // Assuming you know the index of your device (here, using 0 as an example)
     unsigned char deviceIndex = 0;
-    SetUsbDeviceIndex(deviceIndex);
+    engine.selectDevice(deviceIndex);
 
     // Check if the USB device is online
-    unsigned char isOnline = CheckUSBOnline();
-    if (isOnline == 0) { // Assuming '0' indicates the device is not online
+    if (!engine.isOnline()) {
         std::cerr << "USB device is not online." << std::endl;
     }
     else {
         std::cout << "USB device is online." << std::endl;
     }
 
-    unsigned char result;
-
-    S16 temp, time;
-    unsigned char stat = 4;
-    unsigned char status;
-
-    // Example: Turn on the power (assuming '1' is for power on)
-    status = PowerOnOff(1);
-    if (status == 1) { // Assuming '0' indicates success
+    if (engine.setPower(true)) {
         std::cout << "Power turned on successfully." << std::endl;
     }
     else {
         std::cout << "Failed to turn on power." << std::endl;
+        result.outcome = WarmUpOutcome::PowerOnFailed;
+        result.message = "Failed to turn on the light engine power.";
+        return result;
     }
 
+    std::cout << "System is warming up..." << std::endl;
 
-    char userChoice; // User's choice for turning the LED on or off
-    unsigned char flag; // Flag for the LedOnOff function
-    std::cout << "System is warming up..."<<std::endl;
-
-    auto frameEndTime = std::chrono::high_resolution_clock::now();
-    auto inittime = std::chrono::high_resolution_clock::now();
-    std::chrono::seconds maxDuration(600); // 100ms for the dark time
+    unsigned char stat = 4;
+    bool first = true;
+    auto lastProgress = inittime;
 
     while (stat != 1) {
-        stat = GetSysStatus();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        std::cout << static_cast<int>(stat) << std::endl;
+        unsigned char previous = stat;
+        stat = engine.getSysStatus();
+        result.lastSysStatus = stat;
 
-        if (stat != 4 && stat != 1) {
-            std::cout << static_cast<int>(stat) << std::endl;
+        // Only changes are printed, the status is polled ten times per second
+        if (stat != previous || first) {
+            std::cout << "System status: " << static_cast<int>(stat) << std::endl;
         }
 
-        auto timeouttime = std::chrono::high_resolution_clock::now();
-        auto total = std::chrono::duration_cast<std::chrono::seconds>(timeouttime - inittime);
-        //std::cout << "Time: " << total.count() << " s" << std::endl;
+        auto now = std::chrono::steady_clock::now();
+        if (onProgress && (stat != previous || first || now - lastProgress >= std::chrono::seconds(1))) {
+            onProgress(LightEngineWarmUpProgress{ elapsed(), stat });
+            lastProgress = now;
+        }
+        first = false;
+
+        if (stat == 1) {
+            break;
+        }
 
-        if (total > maxDuration) {
-            status = PowerOnOff(0);
-            std::cout << "Took tooooooooooo long..." << std::endl;
-            if (status == 1) { // Assuming '0' indicates success
+        bool cancelled = isCancelled && isCancelled();
+        if (cancelled || now - inittime > timeout) {
+            result.outcome = cancelled ? WarmUpOutcome::Cancelled : WarmUpOutcome::TimedOut;
+            result.message = cancelled ? "Light engine warm-up cancelled." :
+                "Light engine did not become ready within " + std::to_string(timeout.count()) + " s.";
+            std::cout << result.message << std::endl;
+
+            if (engine.setPower(false)) {
                 std::cout << "Power turned off successfully." << std::endl;
             }
             else {
                 std::cerr << "Failed to turn off power." << std::endl;
             }
-            exit(1); // Exit the entire program
+            break;
         }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
+    result.elapsed = elapsed();
+    if (result.outcome == WarmUpOutcome::Ready) {
+        result.message = "Light engine ready after " + std::to_string(result.elapsed.count() / 1000) + " s.";
+    }
+    return result;
 }
 
 
@@ -383,10 +441,8 @@ Author:
 ***************************************************************************************************************************************/
 
 void TurnLightEngineOff() {
-    unsigned char status;
     // Example: Turn off the power (assuming '0' is for power off)
-    status = PowerOnOff(0);
-    if (status == 1) { // Assuming '0' indicates success
+    if (lightEngine().setPower(false)) {
         std::cout << "Power turned off successfully." << std::endl;
     }
     else {
@@ -447,9 +503,11 @@ Author:
 
 
 void moveStage(SMC100C& controller, double stepSize, bool isClip, float dlpPumpingAction) {
+    TraceZone moveZone("Move stage", "stage");
     auto sleepDuration = std::chrono::milliseconds(3);
 
-    auto moveAndCheckReady = [&](float moveStep) {
+    auto moveAndCheckReady = [&](float moveStep, const char* zoneName) {
+        TraceZone zone(zoneName, "stage");
         while (true) {
             try {
                 controller.RelativeMove(moveStep);
@@ -474,14 +532,36 @@ void moveStage(SMC100C& controller, double stepSize, bool isClip, float dlpPumpi
     if (!isClip) {
         std::cout << "DLP Movement triggered UP" << std::endl;
         float updlp = -1 * dlpPumpingAction;
-        moveAndCheckReady(updlp); // Move up
+        moveAndCheckReady(updlp, "Pump up"); // Move up
     }
 
-    moveAndCheckReady(stepSize); // Move to the next position
+    moveAndCheckReady(stepSize, "Layer step"); // Move to the next position
 
     if (!isClip) {
-        moveAndCheckReady(dlpPumpingAction); // Move down
+        moveAndCheckReady(dlpPumpingAction, "Pump down"); // Move down
+    }
+}
+/**************************************************************************************************************************************
+Function:
+    parseStageReply
+Parameters:
+    const std::string& reply: Controller reply such as "1VA5.00000"
+    float& value: Receives the number after the address and command
+Returns:
+    bool: False if the reply holds no number, value is then left unchanged
+***************************************************************************************************************************************/
+
+bool parseStageReply(const std::string& reply, float& value) {
+    try {
+        if (reply.length() > 3) {
+            value = std::stof(reply.substr(3));
+            return true;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Invalid stage reply \"" << reply << "\": " << e.what() << std::endl;
     }
+    return false;
 }
 /**************************************************************************************************************************************
 Function:
@@ -626,7 +706,7 @@ Function:
 Parameters:
     int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity
 Returns:
-    void
+    bool: False if the stage controller could not be opened, the stage and the light engine are then left as they were
 Description:
     Sets up the initial state of the system including the stage and the graphical display. Initializes the controller, configures
     stage velocity and position, and prepares the SFML window for rendering. This function encapsulates the initial setup required
@@ -639,7 +719,7 @@ Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
 
-void InitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity ) {
+bool InitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity ) {
     // Retrieve the desktop mode of the primary monitor
     sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
 
@@ -652,7 +732,7 @@ void InitializeSystem(int inputCurrent, float initialPosition, float velocity, s
 
     SMC100C controller;
     if (!initializeController(controller)) {
-        exit(0);
+        return false;
     }
 
     // Test Home
@@ -666,7 +746,36 @@ void InitializeSystem(int inputCurrent, float initialPosition, float velocity, s
 
     std::cout << "Input Current: " << inputCurrent << std::endl;
 
+    moveToJobStart(controller, initialPosition, velocity, initialVelocity);
+
+    unsigned char currentValue = 0;
+
 
+
+    window.clear();
+    window.display();
+    lightEngine().setCurrent(static_cast<unsigned char>(inputCurrent));
+
+    lightEngine().getCurrent(currentValue);
+    std::cout << "The  current value is: " << static_cast<int>(currentValue) << std::endl;
+    return true;
+}
+
+/**************************************************************************************************************************************
+Function:
+    moveToJobStart
+Parameters:
+    SMC100C& controller: Open and homed controller
+    float initialPosition, float velocity, float initialVelocity
+Returns:
+    void
+Description:
+    Moves the stage to 10 mm before the initial position at initialVelocity and the rest of the way at the print velocity, which
+    the controller keeps for the print. Used by InitializeSystem after homing and between the queued jobs of a batch, whose stage
+    stays homed from the first job.
+***************************************************************************************************************************************/
+
+void moveToJobStart(SMC100C& controller, float initialPosition, float velocity, float initialVelocity) {
     float intermediatePosition = initialPosition - 10.0f;
     float positionTolerance = 0.01f;
     float velocityTolerance = 0.5f;
@@ -697,19 +806,6 @@ void InitializeSystem(int inputCurrent, float initialPosition, float velocity, s
 
 
     std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Wait for response
-    //---------------------------------------------------------------------------------Stage Setup-------------------------------------------------------------------------
-
-    U8 currentValue; // = GetCurrent(0, 0);
-
-
-
-    window.clear();
-    window.display();
-    SetCurrent(0, static_cast<U8>(inputCurrent));
-
-    GetCurrent(0, &currentValue);
-    std::cout << "The  current value is: " << static_cast<int>(currentValue) << std::endl;
-
 }
 
 /**************************************************************************************************************************************
@@ -718,7 +814,7 @@ Function:
 Parameters:
     int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity
 Returns:
-    void
+    bool: False if the stage controller could not be opened, the light engine is switched off nevertheless
 Description:
     Safely shuts down the system by resetting the stage to a base position and turning off any initialized hardware or software
     components. This function reverses the setup done by InitializeSystem, ensuring that the system is left in a safe state after
@@ -731,14 +827,17 @@ Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
 
-void DeinitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity) {
+bool DeinitializeSystem(int inputCurrent, float initialPosition, float velocity, sf::RenderWindow& window, float initialVelocity) {
     
     std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Settle for 50 ms
 
 
     SMC100C controller;
     if (!initializeController(controller)) {
-        exit(0);
+        window.clear();
+        window.display();
+        lightEngine().setCurrent(0);
+        return false;
     }
 
     // Test Home
@@ -791,91 +890,276 @@ void DeinitializeSystem(int inputCurrent, float initialPosition, float velocity,
     std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Wait for response
     //---------------------------------------------------------------------------------Stage Setup-------------------------------------------------------------------------
 
-    U8 currentValue; // = GetCurrent(0, 0);
+    unsigned char currentValue = 0;
 
 
 
     window.clear();
     window.display();
-    SetCurrent(0, static_cast<U8>(0));
+    lightEngine().setCurrent(0);
 
-    GetCurrent(0, &currentValue);
+    lightEngine().getCurrent(currentValue);
     std::cout << "The  current value is: " << static_cast<int>(currentValue) << std::endl;
-
+    return true;
 }
 
 /**************************************************************************************************************************************
 Function:
-    RunFull
+    openSliceSource
 Parameters:
-    const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction, int initialExposureCounter, int initialLayers
+    const std::string& jobPath: Folder of exported slice images, an STL mesh or a layered SVG file
+    const SliceSourceSettings& settings: Output resolution, layer height and pixel size
+    LogCallback logCallback: Receives the error if the job cannot be opened
 Returns:
-    void
+    std::shared_ptr<SliceSource>: Source of the job, nullptr on failure
 Description:
-    Non-Dynamic Print. Either DLP or Clip according to user input. Executes a full run of the system, cycling through a sequence of images while controlling the stage based on specified parameters.
-    This function integrates image display, stage control, and dynamic parameter adjustments into a cohesive operation, demonstrating
-    the system's full capabilities.
-Notes:
-    - The function is designed to be flexible, allowing for dynamic adjustment of parameters such as exposure time and step size.
-    - It showcases the ability to respond to external signals (e.g., an abort flag) for increased control during operation.
-Author:
-    Mats Grobe, 28/02/2024
+    Selects how the slices of a job are produced. A folder is read as exported images sorted with customSort, a mesh file is sliced
+    in memory by MeshSliceSource and the contours of an SVG file are rasterized by VectorSliceSource, so in both cases no images have
+    to be exported and decoded. With settings.streaming the folder is watched by StreamingDirectorySource while the slicer writes it.
 ***************************************************************************************************************************************/
 
-void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
-    float dlpPumpingAction, 
-    int initialExposureCounter, int initialLayers) {
-
-
-    logCallback("Run Full has started");
-    if (!isClip) {
-        logCallback("Dlp mode initialized.");
+std::shared_ptr<SliceSource> openSliceSource(const std::string& jobPath, const SliceSourceSettings& settings, LogCallback logCallback) {
+    std::string extension = fs::path(jobPath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (fs::is_regular_file(jobPath) && extension == ".svg") {
+        logCallback("Reading vector slices " + jobPath + ".", LogSeverity::Info, LogSubsystem::Slices);
+        std::string error;
+        std::shared_ptr<VectorSliceSource> vector = VectorSliceSource::open(jobPath, settings, error);
+        if (!vector) {
+            std::cerr << error << std::endl;
+            logCallback(error, LogSeverity::Error, LogSubsystem::Slices);
+            return nullptr;
+        }
+        logCallback("Vector slices contain " + std::to_string(vector->layerCount()) + " layers.", LogSeverity::Info, LogSubsystem::Slices);
+        return vector;
     }
-    //--------------------------------------------------------Graphics Set Up-----------------------------------------------------------------
 
-    // Retrieve the desktop mode of the primary monitor
-    sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+    if (fs::is_regular_file(jobPath)) {
+        logCallback("Slicing mesh " + jobPath + " at " + std::to_string(settings.layerHeight) + " mm layers.",
+            LogSeverity::Info, LogSubsystem::Slices);
+        std::string error;
+        std::shared_ptr<MeshSliceSource> mesh = MeshSliceSource::open(jobPath, settings, error);
+        if (!mesh) {
+            std::cerr << error << std::endl;
+            logCallback(error, LogSeverity::Error, LogSubsystem::Slices);
+            return nullptr;
+        }
+        logCallback("Mesh sliced into " + std::to_string(mesh->layerCount()) + " layers.", LogSeverity::Info, LogSubsystem::Slices);
+        return mesh;
+    }
 
-    // Enable VSync to synchronize with the monitor refresh rate
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(30);
+    if (settings.streaming) {
+        if (!fs::is_directory(jobPath)) {
+            logCallback("Streaming needs the job folder the slicer writes into: " + jobPath, LogSeverity::Error, LogSubsystem::Slices);
+            return nullptr;
+        }
+        logCallback("Watching " + jobPath + " for slices, the job is complete once " + settings.streamEndMarker + " appears.",
+            LogSeverity::Info, LogSubsystem::Slices);
+        return std::make_shared<StreamingDirectorySource>(jobPath, settings, customSort);
+    }
 
     // Vector to store image paths
     std::vector<std::string> imagePaths;
 
 
-    logCallback("Adding paths to imagePaths vector.");
+    logCallback("Adding paths to imagePaths vector.", LogSeverity::Info, LogSubsystem::Slices);
 
     // Iterate over files in the directory and add image paths to the vector
     try {
-        for (const auto& entry : fs::directory_iterator(directoryPath)) {
+        for (const auto& entry : fs::directory_iterator(jobPath)) {
             imagePaths.push_back(entry.path().string());
         }
     }
     catch (const std::filesystem::filesystem_error& e) {
         std::cerr << "Filesystem error: " << e.what() << '\n';
-        logCallback("Filesystem error: " + std::string(e.what()));
-
-        // Handle error (e.g., return or throw an exception)
-        return;
+        logCallback("Filesystem error: " + std::string(e.what()), LogSeverity::Error, LogSubsystem::Slices);
+        return nullptr;
     }
 
 
     std::sort(imagePaths.begin(), imagePaths.end(), customSort);
 
-    sf::Texture currentTexture, nextTexture, textures[2];
+    return std::make_shared<ImageDirectorySource>(imagePaths);
+}
+
+/**************************************************************************************************************************************
+Function:
+    ingestPlan
+Parameters:
+    PrintPlan& plan, const AdaptiveExposureSettings& adaptiveSettings, float pixelSize, LogCallback logCallback
+    const std::vector<SliceInfo>* slices, const std::vector<SliceDiff>* diffs: Analysis already done for the plan, nullptr to run it
+Returns:
+    void
+Description:
+    Ingest stage of a complete job. With adaptive exposure enabled, every slice is compared with the slice below it and the layers
+    with overhangs or new islands get a longer exposure and dark time (see applySliceDiffs). Empty slices are then folded into the
+    neighbouring moves. The analysis also counts the lit pixels, each slice is decoded once for both.
+***************************************************************************************************************************************/
+
+void ingestPlan(PrintPlan& plan, const AdaptiveExposureSettings& adaptiveSettings, float pixelSize, LogCallback logCallback,
+    const std::vector<SliceInfo>* slices, const std::vector<SliceDiff>* diffs) {
+    std::vector<SliceInfo> ingested;
+    if (adaptiveSettings.enabled) {
+        std::vector<SliceDiff> analysed;
+        if (!diffs) {
+            logCallback("Analysing slice differences...", LogSeverity::Info, LogSubsystem::Slices);
+            analysed = analyzeSliceDiffs(*plan.source, adaptiveSettings.downsample, pixelSize, slices ? nullptr : &ingested);
+            diffs = &analysed;
+            if (!slices) {
+                slices = &ingested;
+            }
+        }
+        size_t adjusted = applySliceDiffs(plan, *diffs, adaptiveSettings);
+        logCallback("Adaptive exposure adjusted " + std::to_string(adjusted) + " layers.", LogSeverity::Info, LogSubsystem::Slices);
+    }
+
+    if (slices) {
+        foldEmptyLayers(plan, *slices);
+    }
+    else {
+        logCallback("Ingesting slices...", LogSeverity::Info, LogSubsystem::Slices);
+        foldEmptyLayers(plan, ingestSlices(*plan.source));
+    }
+    logCallback("Empty layers folded into moves: " + std::to_string(plan.emptyLayers), LogSeverity::Info, LogSubsystem::Slices);
+}
+
+/**************************************************************************************************************************************
+Function:
+    printFilePrefix
+Parameters:
+    const std::string& jobName: PrintPlan::name, may be empty
+Returns:
+    std::string: e.g. "part_20261018_221500_"
+Description:
+    Prefix of the report, trace and journal files of a print. The start time keeps the files of a job printed twice apart.
+***************************************************************************************************************************************/
+
+static std::string printFilePrefix(const std::string& jobName) {
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    std::ostringstream prefix;
+    prefix << (jobName.empty() ? "print" : jobName) << "_" << std::put_time(&local, "%Y%m%d_%H%M%S") << "_";
+    return prefix.str();
+}
+
+/**************************************************************************************************************************************
+Function:
+    RunPlan
+Parameters:
+    PrintPlan& plan, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+    float dlpPumpingAction, bool closeWindow: False while further queued jobs follow, the window then stays open for them
+    SMC100C* stage: Open stage of a batch of queued jobs, it is neither homed nor closed at the end of the print. Null opens a
+    connection for this print, which homes the stage and closes it once the print has finished.
+Returns:
+    void
+Description:
+    Executes a print plan built by buildStaticPlan or buildDynamicPlan. Every planned layer is shown for its exposure frame count,
+    followed by a dark phase in which the stage moves by the layer's move distance and the next slice is uploaded. The dark phase ends
+    once the minimum dark time has passed, the move is finished and the next texture is ready. Intensity changes between layers are
+    sent to the light engine before the next exposure.
+Notes:
+    - Empty slices are no longer part of plan.layers, their travel is included in moveDistance or plan.leadingMove.
+    - Shared by RunFull and RunFullDynamic, which only differ in how the plan is built.
+    - A streaming plan (plan.extend set) grows during the print. When the print catches up with the slicer it stays in the dark
+      phase, with the stage already moved, until the next layer is available.
+    - Exposure, dark time, step size and intensity can be changed during the print through parameterChannel(). The changes are
+      picked up when the next layer's settings are applied, journaled to parameter_journal.csv and echoed to the log.
+    - Velocity and acceleration are sent on the stage thread right before a move and only when they differ from the last values
+      sent, so a plan without per-layer motion sends at most the job's values once.
+    - The timing of every layer is written to layer_timing.csv, with percentiles and the idle time per cause in
+      layer_timing_summary.txt, when the print finishes or is aborted.
+    - The files a print writes are named after the job and the start of the print, e.g. part_20261018_221500_layer_timing.csv,
+      so the jobs of a batch keep their own (see printFilePrefix).
+***************************************************************************************************************************************/
+
+void RunPlan(PrintPlan& plan, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+    float dlpPumpingAction, bool closeWindow, SMC100C* stage) {
+
+    const SliceSource& source = *plan.source;
+    std::vector<PlannedLayer>& layers = plan.layers;
+
+    // A streaming job starts once the slicer is far enough ahead for the first layer
+    bool streaming = static_cast<bool>(plan.extend);
+    if (streaming) {
+        logCallback("Waiting for the slicer...", LogSeverity::Info, LogSubsystem::Slices);
+        while ((streaming = plan.extend(plan)) && layers.empty()) {
+            if (getAbortFlag()) {
+                logCallback("Run Full aborted.", LogSeverity::Warning, LogSubsystem::Print);
+                return;
+            }
+            sf::Event event;
+            while (window.pollEvent(event)) {
+            }
+            window.clear();
+            window.display();
+        }
+    }
+
+    if (layers.empty()) {
+        logCallback("Plan contains no layers to expose.", LogSeverity::Warning, LogSubsystem::Print);
+        return;
+    }
+    const std::string filePrefix = printFilePrefix(plan.name);
+    auto printFile = [&](const std::string& name) { return filePrefix + name; };
+    // Zones of this print only, the print loop is the first track of the trace
+    if (printTrace().isEnabled()) {
+        printTrace().restart();
+    }
+    printTrace().nameThread("Print loop");
+    std::optional<TraceZone> phaseZone; // Exposure or dark phase of the current layer, they span many frames
+
+    PrinterMetrics& metrics = printerMetrics();
+    metrics.printsStarted.add();
+    metrics.layerCount.set(static_cast<double>(plan.source->layerCount()));
+
+    sf::Texture textures[2];
     sf::Sprite sprite;
     int currentTextureIndex = 0; // Index to track the current texture
 
-    size_t currentImage = 0, nextImage = 1, currentImageIndex = 0;
-    bool showImage = true, nextImageLoaded = false, isNextImageLoading = false, allImagesShown = false;
+    size_t currentLayerIndex = 0;
+    bool nextImageLoaded = false, isNextImageLoading = false, allImagesShown = false;
 
-    // Preload the first image
-    if (!textures[currentTextureIndex].loadFromFile(imagePaths[currentImage])) {
-        std::cerr << "Failed to load first image: " << imagePaths[currentImage] << std::endl;
-        logCallback("Failed to load first image: " + imagePaths[currentImage]);
+    // Ready-frame queue, the slices are decoded or sliced on worker threads a few layers ahead of the print
+    std::vector<size_t> order;
+    order.reserve(layers.size());
+    for (const PlannedLayer& layer : layers) {
+        order.push_back(layer.sliceIndex);
+    }
+    const size_t prefetchDepth = 4;
+    unsigned int prefetchThreads = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(prefetchDepth)));
+    SlicePrefetcher prefetcher(source, order, prefetchDepth, prefetchThreads);
+    bool waitingForSlicer = false;
+    bool layerMoveStarted = false; // The dark phase may last several frames while waiting for the slicer
+
+    // Appends the layers the slicer has finished since the last call, false once the job has no further layers
+    auto extendPlan = [&]() {
+        size_t planned = layers.size();
+        bool more = plan.extend(plan);
+        for (size_t i = planned; i < layers.size(); ++i) {
+            prefetcher.append(layers[i].sliceIndex);
+        }
+        return more;
+    };
 
-        //return -1;
+    // Uploads the frame of a plan position into a texture, only the upload itself runs on this thread
+    auto uploadFrame = [&](size_t position, sf::Texture& texture) {
+        TraceZone zone("Upload slice", "slices", static_cast<int64_t>(layers[position].sliceIndex));
+        const sf::Image* frame = prefetcher.acquire(position);
+        bool ok = frame != nullptr && texture.loadFromImage(*frame);
+        prefetcher.release(position);
+        return ok;
+    };
+
+    // Preload the first image
+    if (!uploadFrame(0, textures[currentTextureIndex])) {
+        std::cerr << "Failed to load first image: " << source.layerName(layers[0].sliceIndex) << std::endl;
+        logCallback("Failed to load first image: " + source.layerName(layers[0].sliceIndex), LogSeverity::Error, LogSubsystem::Slices);
     }
 
     // Pre-calculate the scale for all sprites
@@ -886,129 +1170,477 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
 
     //--------------------------------------------------------Stage Set Up-----------------------------------------------------------------
 
-    SMC100C controller;
+    // A batch of queued jobs shares one stage connection, a single print opens its own
+    SMC100C ownController;
+    SMC100C& controller = stage ? *stage : ownController;
+    if (!stage) {
+        // Test Initialization
+        logCallback("Testing Initialization...", LogSeverity::Info, LogSubsystem::Stage);
+        if (!initializeController(controller)) {
+            logCallback("The stage controller could not be opened, the print did not start.", LogSeverity::Error, LogSubsystem::Stage);
+            metrics.printsAborted.add();
+            return;
+        }
+        logCallback("Success", LogSeverity::Info, LogSubsystem::Stage);
 
-    // Test Initialization
-    logCallback("Testing Initialization...");
-    if (!initializeController(controller)) {
-        exit(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Wait for response
     }
-    logCallback("Success");
-    
 
-    std::future<void> stageThread; // Future for async operation
+    // The print loop records its events instead of logging them, they reach logCallback from the writer thread and are kept in
+    // print_events.bin for later analysis. Declared before the stage thread, which records as well.
+    EventLogScope events(printFile("print_events.bin"), logCallback);
+
+    // Stage motion last sent to the controller, layers with their own motion only send the values that change. Job values left at 0
+    // are the controller's settings at the start, so a layer without its own motion returns to them.
+    MotionSettings controllerMotion;
+    parseStageReply(controller.GetVelocity(), controllerMotion.velocity);
+    parseStageReply(controller.GetAcceleration(), controllerMotion.acceleration);
+    MotionSettings jobMotion = plan.motion;
+    if (jobMotion.velocity <= 0.0f) {
+        jobMotion.velocity = controllerMotion.velocity;
+    }
+    if (jobMotion.acceleration <= 0.0f) {
+        jobMotion.acceleration = controllerMotion.acceleration;
+    }
+    MotionSettings appliedMotion = controllerMotion;
+
+    // Runs on the stage thread in front of the layer's move
+    auto applyMotion = [&](const LayerMotion& motion) {
+        float velocity = motion.velocity.value_or(jobMotion.velocity);
+        if (velocity > 0.0f && velocity != appliedMotion.velocity) {
+            controller.SetVelocity(velocity);
+            appliedMotion.velocity = velocity;
+            eventLog().record(PrintEventType::StageVelocity, 0, 0, 0, 0, velocity);
+        }
+        float acceleration = motion.acceleration.value_or(jobMotion.acceleration);
+        if (acceleration > 0.0f && acceleration != appliedMotion.acceleration) {
+            controller.SetAcceleration(acceleration);
+            appliedMotion.acceleration = acceleration;
+            eventLog().record(PrintEventType::StageAcceleration, 0, 0, 0, 0, acceleration);
+        }
+    };
+
+    // Written by the stage thread, read once its future is ready. Declared before the future, which outlives neither
+    double stageMoveMs = 0.0;
+    std::chrono::high_resolution_clock::time_point stageFinishedAt;
+    std::future<void> stageThread; // Future for async operation, declared after applyMotion so an abort waits for the move first
 
     bool isStageThreadRunning = false;
 
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Wait for response
+    // Empty slices in front of the first exposure are travelled in a single move
+    if (plan.leadingMove != 0.0f) {
+        logCallback("Skipping leading empty layers, moving " + std::to_string(plan.leadingMove) + " mm",
+            LogSeverity::Info, LogSubsystem::Stage);
+        moveStage(controller, plan.leadingMove, isClip, dlpPumpingAction);
+    }
 
 
     //---------------------------------------------------------------------------------Stage Setup-------------------------------------------------------------------------
 
-
+    const int intensitySettleMs = 2000; // Time the light engine needs after SetCurrent
+    const int intensitySettleStep = 10; // Smaller current changes, such as one governor step, skip the settle wait
 
     std::chrono::high_resolution_clock::time_point darkTimeStart;
-    std::chrono::milliseconds darkDuration(mindarktime); // 100ms for the dark time
-
-
-    // Initialize timers
-    std::chrono::high_resolution_clock::time_point lastFrameStart = std::chrono::high_resolution_clock::now();
-    std::chrono::high_resolution_clock::time_point lastFrameEnd = lastFrameStart;
     std::chrono::high_resolution_clock::time_point phaseStartTime = std::chrono::high_resolution_clock::now(); // Track the start of the phase
 
+    // Timing of the layer being exposed, added to the report once its dark phase has ended
+    LayerReport report;
+    LayerTiming timing;
+    bool timingOpen = false;
+    std::chrono::high_resolution_clock::time_point sliceReadyAt, cooldownFinishedAt;
+    bool slicerWaited = false;
+    auto elapsedMs = [](std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    };
 
-    float accumulatedDuration = 0.0f;
     int imageDisplayCount = 0;
-    int darkDisplayCount = 0;
-    const int maxDarkDisplayCount = 1;
-    sf::Clock clock;
     bool filenameLogged = false; // Ensures filename is logged once per image
+    std::chrono::high_resolution_clock::time_point exposureStartTime; // Of the previous layer, for the layer cycle time
     bool inLightPhase = true;
-
-    // Start the game loop
     bool displayImage = true;
-    bool change = true;
-    U8 currentValue; // = GetCurrent(0, 0);
-    int currentLayer = 0; // Track the current layer being processed
-    bool inInitialPhase = true;
-    int maxCount;
-
-    while (window.isOpen()) {
-        // Process events
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
-                window.close();
+    int appliedIntensity = -1;
+    bool settingsApplied = false;
+    PlannedLayer appliedSettings{};
+
+    // The monitor's snapshot while it runs and the sample is recent, otherwise one USB query. A failed read returns false with the
+    // last measured temperature, which must not reach the governor, and is recorded once until a read succeeds again.
+    const auto maxSampleAge = std::chrono::seconds(3);
+    int16_t lastTemperature = 25;
+    bool temperatureFailed = false;
+    auto readTemperature = [&](int16_t& temperature) {
+        LightEngineSample engine;
+        bool measured = lightEngineMonitor().isRunning() && lightEngineMonitor().latest(engine) &&
+            std::chrono::system_clock::now() - engine.timestamp < maxSampleAge;
+        if (measured) {
+            temperature = engine.status.temperature;
+        }
+        else {
+            measured = lightEngine().getTemperature(temperature);
         }
+        if (!measured) {
+            temperature = lastTemperature;
+            if (!temperatureFailed) {
+                eventLog().record(PrintEventType::TemperatureUnavailable, lastTemperature);
+            }
+            temperatureFailed = true;
+            return false;
+        }
+        lastTemperature = temperature;
+        temperatureFailed = false;
+        return true;
+    };
 
-        // Draw the white or black screen
-        if (displayImage) {
+    ThermalGovernor governor(plan.thermal);
+    IntensityProfilePlayer profilePlayer; // Sends the intensity profile segments during the exposure
+    int baseIntensity = -1; // Current set by InitializeSystem, used by layers that keep the current value
+    bool coolingDown = false;
+    bool cooledThisLayer = false; // At most one cooldown per dark phase
+    auto cooldownStart = std::chrono::steady_clock::now();
+    auto lastTemperatureRead = cooldownStart;
+    if (plan.thermal.enabled) {
+        unsigned char current = 0;
+        lightEngine().getCurrent(current);
+        baseIntensity = current;
+        appliedIntensity = baseIntensity;
+    }
 
+    // Chooses intensity and exposure of a dose layer for the current light engine temperature, so drift is compensated per layer
+    auto resolveDose = [&](PlannedLayer& layer, int16_t temperature) {
+        if (layer.doseMJ <= 0.0 || !plan.dose.calibration) {
+            return;
+        }
 
-            if (getAbortFlag()) {
-                logCallback("Run Full aborted.");
-                // Perform any necessary cleanup...
-                return; // Exit the function
-            }
+        int maxCurrent = plan.thermal.enabled ? std::min(plan.dose.maxCurrent, governor.currentLimit()) : plan.dose.maxCurrent;
+        DoseExposure exposure;
+        if (!plan.dose.calibration->exposureForDose(layer.doseMJ, temperature, maxCurrent, plan.dose.frameRate, exposure)) {
+            eventLog().record(PrintEventType::DoseUnreachable, maxCurrent);
+            return;
+        }
+        layer.intensity = exposure.intensity;
+        layer.exposureFrames = exposure.exposureFrames;
+        eventLog().record(PrintEventType::DoseResolved, temperature, exposure.intensity, exposure.exposureFrames, 0, layer.doseMJ,
+            exposure.deliveredDose);
+    };
 
-            // Clear screen
-            window.clear();
-            sprite.setTexture(textures[currentTextureIndex]);
-            sprite.setScale(scaleX, scaleY);
-            window.draw(sprite);
-            window.display(); // Update the window (this is where VSync wait happens)
+    // Feeds the governor a temperature sample, a new limit applies to the layer being prepared
+    auto sampleGovernor = [&](int16_t temperature) {
+        auto now = std::chrono::steady_clock::now();
+        governor.addSample(now, temperature);
+        lastTemperatureRead = now;
+        if (governor.update(now)) {
+            eventLog().record(PrintEventType::GovernorLimit, governor.currentLimit(), static_cast<int>(governor.projectedTemperature()));
+        }
+    };
 
-            if (!filenameLogged && inLightPhase) {
-                logCallback("Displaying: " + imagePaths[currentImageIndex]);
-                filenameLogged = true;
-                auto now = std::chrono::high_resolution_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - phaseStartTime).count();
-                logCallback("Dark phase duration: " + std::to_string(duration) + " ms");
-                inLightPhase = false; // Next phase is dark
-                phaseStartTime = now; // Reset start time for dark phase
-            }
+    // Caps the current at the governor's limit and lengthens the exposure by the lost irradiance
+    auto governLayer = [&](PlannedLayer& layer, int16_t temperature) {
+        if (layer.doseMJ > 0.0 && plan.dose.calibration) {
+            return; // resolveDose already stays within the limit
+        }
+        int requested = layer.intensity >= 0 ? layer.intensity : baseIntensity;
+        GovernedExposure governed = governor.govern(requested, layer.exposureFrames, temperature, plan.dose.calibration.get());
+        if (governed.intensity != requested) {
+            eventLog().record(PrintEventType::GovernorIntensity, requested, governed.intensity, layer.exposureFrames,
+                governed.exposureFrames);
+        }
+        layer.intensity = governed.intensity;
+        layer.exposureFrames = governed.exposureFrames;
+    };
 
-            if (inInitialPhase) {
-                maxCount = initialExposureCounter;
-            }
-            else {
-                maxCount = maxImageDisplayCount;
-            }
+    // Caps every segment of the layer's intensity profile at the governor's limit, the segment durations stay as planned
+    auto governProfile = [&](PlannedLayer& layer) {
+        int16_t temperature = 0;
+        if (readTemperature(temperature)) {
+            sampleGovernor(temperature);
+        }
+        int limit = governor.currentLimit();
+        int requested = std::max_element(layer.profile->begin(), layer.profile->end(),
+            [](const IntensitySegment& a, const IntensitySegment& b) { return a.intensity < b.intensity; })->intensity;
+        if (requested <= limit) {
+            return;
+        }
+        auto capped = std::make_shared<IntensityProfile>(*layer.profile);
+        for (IntensitySegment& segment : *capped) {
+            segment.intensity = std::min(segment.intensity, limit);
+        }
+        eventLog().record(PrintEventType::GovernorIntensity, requested, limit, layer.exposureFrames, layer.exposureFrames);
+        layer.profile = capped;
+    };
 
-            imageDisplayCount++;
-            //std::cout << imageDisplayCount << std::endl;
+    // Adjustments the operator submits during the print, received whenever the next layer's settings are applied
+    LayerOverrides overrides;
+    ParameterJournal journal(printFile("parameter_journal.csv"));
+    std::vector<ParameterAdjustment> activatedAdjustments;
+    parameterChannel().setPrinting(true);
+
+    auto receiveAdjustments = [&](PlannedLayer& layer) {
+        ParameterAdjustment adjustment;
+        while (parameterChannel().receive(adjustment)) {
+            journal.record("received", adjustment, layer.sliceIndex);
+            overrides.add(adjustment);
+        }
+        activatedAdjustments.clear();
+        overrides.apply(layer, activatedAdjustments);
+        for (const ParameterAdjustment& activated : activatedAdjustments) {
+            journal.record("applied", activated, layer.sliceIndex);
+            logCallback("Adjustment " + describeAdjustment(activated) + " took effect at layer " + std::to_string(layer.sliceIndex),
+                LogSeverity::Info, LogSubsystem::Print);
+        }
+        parameterChannel().publishLayer(layer.sliceIndex);
+    };
 
-            if (imageDisplayCount >= maxCount) {
-                displayImage = false;
-                imageDisplayCount = 0;
-                currentLayer++;
-                if (currentLayer >= initialLayers) {
-                    inInitialPhase = false;
-                }
+    // Adjustments for layers the print did not reach are journaled as unused
+    auto finishAdjustments = [&](size_t layer) {
+        parameterChannel().setPrinting(false);
+        ParameterAdjustment adjustment;
+        while (parameterChannel().receive(adjustment)) {
+            overrides.add(adjustment);
+        }
+        for (const ParameterAdjustment& unused : overrides.pending()) {
+            journal.record("unused", unused, layer);
+            logCallback("Adjustment " + describeAdjustment(unused) + " was not applied, the print ended at layer " + std::to_string(layer),
+                LogSeverity::Warning, LogSubsystem::Print);
+        }
+    };
 
-                try {
-                    std::string pos = controller.GetPosition();
-                    pos.erase(std::remove(pos.begin(), pos.end(), '\n'), pos.end());
-                    pos.erase(std::remove(pos.begin(), pos.end(), '\r'), pos.end());
-                    if (pos.length() >= 9) { // Ensure the string is long enough for substr operation
-                        std::string positionValue = pos.substr(3, 6);
-                        std::string posMessage = "Position: " + positionValue + " mm";
-                        logCallback(posMessage);
-                    }
-                    else {
-                        logCallback("Error: Position string too short or in unexpected format.");
-                    }
-                }
-                catch (const std::exception& e) {
-                    logCallback("Exception caught while processing position: " + std::string(e.what()));
-                    // Handle the exception or log it, but don't terminate the loop
-                }
+    // Sends the layer's settings to the hardware if they differ from the previous layer
+    auto applySettings = [&](PlannedLayer& layer) {
+        TraceZone zone("Apply settings", "light engine", static_cast<int64_t>(layer.sliceIndex));
+        // Operator adjustments come first, the profile, the dose and the thermal governor then work on the adjusted values
+        receiveAdjustments(layer);
 
-                // Debug print the current status
-                std::cout << "Current Image Index: " << currentImageIndex << " / " << imagePaths.size() << std::endl;
-                logCallback("Current Image Index: " + std::to_string(currentImageIndex) + " / " + std::to_string(imagePaths.size()));
-                darkTimeStart = std::chrono::high_resolution_clock::now(); // Start dark time
+        if (layer.profile) {
+            if (plan.thermal.enabled) {
+                governProfile(layer);
+            }
+            // The first segment is set like a constant intensity, the exposure lasts at least as long as the profile
+            layer.intensity = layer.profile->front().intensity;
+            int profileFrames = static_cast<int>(std::ceil(profileDurationMs(*layer.profile) * plan.dose.frameRate / 1000.0));
+            layer.exposureFrames = std::max(layer.exposureFrames, profileFrames);
+        }
+        else if (plan.thermal.enabled || layer.doseMJ > 0.0) {
+            int16_t temperature = 0;
+            bool measured = readTemperature(temperature);
+            if (plan.thermal.enabled) {
+                if (measured) {
+                    sampleGovernor(temperature);
+                }
+                governLayer(layer, temperature);
+            }
+            resolveDose(layer, temperature);
+        }
+
+        if (!settingsApplied || appliedSettings.intensity != layer.intensity ||
+            appliedSettings.exposureFrames != layer.exposureFrames || appliedSettings.darkTimeMs != layer.darkTimeMs) {
+            eventLog().record(PrintEventType::SettingsApplied, layer.intensity, layer.exposureFrames, layer.darkTimeMs);
+        }
+        appliedSettings = layer;
+        settingsApplied = true;
+
+        if (layer.intensity >= 0 && layer.intensity != appliedIntensity) {
+            lightEngine().setCurrent(static_cast<unsigned char>(layer.intensity));
+            bool largeStep = appliedIntensity < 0 || std::abs(layer.intensity - appliedIntensity) > intensitySettleStep;
+            appliedIntensity = layer.intensity;
+            // Profiles switch the current within the exposure anyway, waiting before their first segment would only cost time
+            if (!layer.profile && largeStep) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(intensitySettleMs));  // Wait for response
+            }
+        }
+
+        // The remaining segments are queued now, the exposure only has to start the player
+        if (layer.profile && layer.profile->size() > 1) {
+            profilePlayer.arm(layer.profile);
+        }
+    };
+
+    // Latency of the light engine commands per phase, written next to the executable with the job log
+    auto reportTrace = [&]() {
+        if (!lightEngineTrace().isEnabled()) {
+            return;
+        }
+        std::istringstream summary(lightEngineTrace().summary());
+        std::string line;
+        while (std::getline(summary, line)) {
+            logCallback("USB latency " + line, LogSeverity::Info, LogSubsystem::LightEngine);
+        }
+        if (lightEngineTrace().exportCsv(printFile("light_engine_latency.csv"))) {
+            logCallback("Light engine latency written to " + printFile("light_engine_latency.csv"),
+                LogSeverity::Info, LogSubsystem::LightEngine);
+        }
+    };
+
+    // Timeline of the print for ui.perfetto.dev, written when phase tracing is enabled
+    auto exportPrintTrace = [&]() {
+        if (!printTrace().isEnabled()) {
+            return;
+        }
+        phaseZone.reset();
+        std::string error;
+        if (printTrace().exportChromeTrace(printFile("print_trace.json"), error)) {
+            logCallback("Print phases written to " + printFile("print_trace.json") + ", open it in ui.perfetto.dev",
+                LogSeverity::Info, LogSubsystem::Print);
+        }
+        else {
+            logCallback(error, LogSeverity::Warning, LogSubsystem::Print);
+        }
+        if (printTrace().droppedZones() > 0) {
+            logCallback(std::to_string(printTrace().droppedZones()) + " trace zones were dropped, the trace buffers were full.",
+                LogSeverity::Warning, LogSubsystem::Print);
+        }
+    };
+
+    // Ends the phase in progress and adds the layer to the report
+    auto closeTiming = [&](std::chrono::high_resolution_clock::time_point now) {
+        if (!timingOpen) {
+            return;
+        }
+        if (inLightPhase) {
+            timing.actualDarkMs = elapsedMs(phaseStartTime, now);
+        }
+        else {
+            timing.actualExposureMs = elapsedMs(phaseStartTime, now); // Aborted during the exposure
+        }
+        report.add(timing);
+        timingOpen = false;
+    };
+
+    // Written for every print, finished or aborted, so production runs can be compared for throughput
+    auto writeLayerReport = [&]() {
+        std::string error;
+        if (!report.writeCsv(printFile("layer_timing.csv"), error) || !report.writeSummary(printFile("layer_timing_summary.txt"), error)) {
+            logCallback(error, LogSeverity::Warning, LogSubsystem::Print);
+            return;
+        }
+        for (const std::string& line : report.summary()) {
+            logCallback("Layer timing: " + line, LogSeverity::Info, LogSubsystem::Print);
+        }
+        logCallback("Layer timing written to " + printFile("layer_timing.csv"), LogSeverity::Info, LogSubsystem::Print);
+    };
+
+    // Leaves the print at the operator's abort, the stage stays where it is
+    auto abortPrint = [&](size_t sliceIndex) {
+        // A move started in this dark phase is finished first, its thread still writes the layer's timing
+        if (isStageThreadRunning) {
+            stageThread.get();
+            isStageThreadRunning = false;
+            timing.moveMs = stageMoveMs;
+        }
+        metrics.printsAborted.add();
+        closeTiming(std::chrono::high_resolution_clock::now());
+        eventLog().stop();
+        logCallback("Run Full aborted.", LogSeverity::Warning, LogSubsystem::Print);
+        reportTrace();
+        exportPrintTrace();
+        writeLayerReport();
+        finishAdjustments(sliceIndex);
+    };
+
+    lightEngineTrace().reset(); // Each print reports its own latencies
+    LightEnginePhaseScope tracePhase(LightEnginePhase::Dark); // The setup before the first exposure counts as dark time
+    applySettings(layers[0]);
+    lightEngineTrace().setPhase(LightEnginePhase::Exposure);
+
+    while (window.isOpen()) {
+        // Process events
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        const PlannedLayer layer = layers[currentLayerIndex]; // Copy, a streaming plan may grow below
+
+        // Draw the white or black screen
+        if (displayImage) {
+
+
+            if (getAbortFlag()) {
+                if (!inLightPhase) {
+                    timing.darkPhaseEnd = DarkPhaseEnd::Aborted;
+                }
+                abortPrint(layer.sliceIndex);
+                return; // Exit the function
+            }
+
+            // Clear screen
+            window.clear();
+            sprite.setTexture(textures[currentTextureIndex]);
+            sprite.setScale(scaleX, scaleY);
+            window.draw(sprite);
+            window.display(); // Update the window (this is where VSync wait happens)
+
+            if (!filenameLogged && inLightPhase) {
+                profilePlayer.start(std::chrono::steady_clock::now()); // The first frame is on screen
+                eventLog().record(PrintEventType::LayerDisplayed, static_cast<int32_t>(layer.sliceIndex));
+                phaseZone.reset();
+                phaseZone.emplace("Exposure", "print", static_cast<int64_t>(layer.sliceIndex));
+                filenameLogged = true;
+                auto now = std::chrono::high_resolution_clock::now();
+                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - phaseStartTime).count();
+                eventLog().record(PrintEventType::DarkPhaseFinished, static_cast<int32_t>(duration));
+                closeTiming(now); // The previous layer's dark phase ends with this frame
+                timing = LayerTiming();
+                timing.sliceIndex = layer.sliceIndex;
+                timing.intensity = appliedIntensity;
+                timing.plannedExposureMs = layer.exposureFrames * 1000.0 / plan.dose.frameRate;
+                timing.plannedDarkMs = layer.darkTimeMs;
+                timingOpen = true;
+                metrics.currentLayer.set(static_cast<double>(layer.sliceIndex));
+                if (currentLayerIndex > 0) { // The first dark phase is the setup
+                    metrics.darkPhaseError.observe(std::chrono::duration<double>(now - phaseStartTime).count() -
+                        layers[currentLayerIndex - 1].darkTimeMs / 1000.0);
+                    metrics.layerCycle.observe(std::chrono::duration<double>(now - exposureStartTime).count());
+                }
+                exposureStartTime = now;
+                inLightPhase = false; // Next phase is dark
+                phaseStartTime = now; // Reset start time for dark phase
+            }
+
+            imageDisplayCount++;
+
+            if (imageDisplayCount >= layer.exposureFrames) {
+                displayImage = false;
+                lightEngineTrace().setPhase(LightEnginePhase::Dark);
+
+                if (layer.profile && layer.profile->size() > 1) {
+                    auto lateness = profilePlayer.finish();
+                    appliedIntensity = layer.profile->back().intensity;
+                    if (lateness > std::chrono::milliseconds(5)) {
+                        eventLog().record(PrintEventType::ProfileLate, static_cast<int32_t>(lateness.count()));
+                    }
+                }
+                imageDisplayCount = 0;
+
+                try {
+                    float position;
+                    auto queryStart = std::chrono::steady_clock::now();
+                    std::string reply = controller.GetPosition();
+                    metrics.serialRoundTrip.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - queryStart).count());
+                    if (parseStageReply(reply, position)) {
+                        eventLog().record(PrintEventType::StagePosition, 0, 0, 0, 0, position);
+                        timing.positionMm = position;
+                        timing.positionValid = true;
+                    }
+                    else {
+                        eventLog().record(PrintEventType::StagePositionInvalid);
+                    }
+                }
+                catch (const std::exception& e) {
+                    logCallback("Exception caught while processing position: " + std::string(e.what()),
+                        LogSeverity::Error, LogSubsystem::Stage);
+                    // Handle the exception or log it, but don't terminate the loop
+                }
+
+                eventLog().record(PrintEventType::LayerExposed, static_cast<int32_t>(layer.sliceIndex),
+                    static_cast<int32_t>(source.layerCount()));
+                if (layer.foldedEmptyLayers > 0) {
+                    eventLog().record(PrintEventType::EmptyLayersSkipped, static_cast<int32_t>(layer.foldedEmptyLayers));
+                }
+                LightEngineSample engine;
+                if (lightEngineMonitor().latest(engine)) {
+                    eventLog().record(PrintEventType::EngineTemperature, engine.status.temperature);
+                }
+                darkTimeStart = std::chrono::high_resolution_clock::now(); // Start dark time
             }
 
         }
@@ -1023,29 +1655,70 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
             if (!inLightPhase) {
                 auto now = std::chrono::high_resolution_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - phaseStartTime).count();
-                logCallback("Light phase duration: " + std::to_string(duration) + " ms");
+                eventLog().record(PrintEventType::LightPhaseFinished, static_cast<int32_t>(duration));
+                phaseZone.reset();
+                phaseZone.emplace("Dark", "print", static_cast<int64_t>(layer.sliceIndex));
+                metrics.lightPhaseError.observe(std::chrono::duration<double>(now - phaseStartTime).count() -
+                    layer.exposureFrames / plan.dose.frameRate);
+                metrics.layersExposed.add();
+                timing.actualExposureMs = elapsedMs(phaseStartTime, now);
+                stageFinishedAt = sliceReadyAt = cooldownFinishedAt = {};
+                slicerWaited = false;
                 inLightPhase = true; // Next phase is light
                 phaseStartTime = now; // Reset start time for light phase
             }
 
-            if (!isStageThreadRunning && !nextImageLoaded) {
-                // Start the stage control thread with the user-defined step size
-                stageThread = std::async(std::launch::async, moveStage, std::ref(controller), stepSize, isClip, dlpPumpingAction);
+            if (!isStageThreadRunning && !nextImageLoaded && !layerMoveStarted) {
+                // Start the stage control thread with the planned travel and motion of this layer
+                stageThread = std::async(std::launch::async, [&, moveDistance = layer.moveDistance, motion = layer.motion,
+                    sliceIndex = layer.sliceIndex]() {
+                    printTrace().nameThread("Stage");
+                    TraceZone zone("Layer move", "stage", static_cast<int64_t>(sliceIndex));
+                    applyMotion(motion);
+                    auto moveStart = std::chrono::steady_clock::now();
+                    moveStage(controller, moveDistance, isClip, motion.pumpingDistance.value_or(dlpPumpingAction));
+                    metrics.moveDuration.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - moveStart).count());
+                    stageMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - moveStart).count();
+                    stageFinishedAt = std::chrono::high_resolution_clock::now();
+                });
                 isStageThreadRunning = true;
+                layerMoveStarted = true;
+            }
+
+            // Stay dark until the slicer has written the next layer
+            if (streaming && currentLayerIndex + 1 >= layers.size()) {
+                streaming = extendPlan();
+                if (currentLayerIndex + 1 >= layers.size() && streaming && !waitingForSlicer) {
+                    eventLog().record(PrintEventType::WaitingForSlicer);
+                }
+                waitingForSlicer = currentLayerIndex + 1 >= layers.size() && streaming;
+                slicerWaited = slicerWaited || waitingForSlicer;
+                // A stalled slicer would hold the print here for good, the abort is only checked before the next exposure otherwise
+                if (waitingForSlicer && getAbortFlag()) {
+                    timing.darkPhaseEnd = DarkPhaseEnd::Aborted;
+                    abortPrint(layer.sliceIndex);
+                    return;
+                }
             }
 
-            // Start loading the next image 
-            if (currentImageIndex + 1 < imagePaths.size() && !isNextImageLoading) {
+            // Start loading the next image
+            if (currentLayerIndex + 1 < layers.size() && !isNextImageLoading) {
                 isNextImageLoading = true;
                 int nextTextureIndex = 1 - currentTextureIndex;
-                textures[nextTextureIndex].loadFromFile(imagePaths[currentImageIndex + 1]);
+                auto decodeStart = std::chrono::steady_clock::now();
+                bool uploaded = uploadFrame(currentLayerIndex + 1, textures[nextTextureIndex]);
+                metrics.sliceDecode.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count());
+                sliceReadyAt = std::chrono::high_resolution_clock::now();
+                timing.sliceReadyMs = elapsedMs(darkTimeStart, sliceReadyAt);
+                if (!uploaded) {
+                    eventLog().record(PrintEventType::ImageLoadFailed, static_cast<int32_t>(layers[currentLayerIndex + 1].sliceIndex));
+                }
                 nextImageLoaded = true;
-                std::cout << "Next Image Loaded." << std::endl;
-                logCallback("Next Image Loaded.");
+                eventLog().record(PrintEventType::NextImageLoaded, static_cast<int32_t>(layers[currentLayerIndex + 1].sliceIndex));
 
             }
 
-            else if (currentImageIndex + 1 >= imagePaths.size() && !isNextImageLoading) {
+            else if (currentLayerIndex + 1 >= layers.size() && !isNextImageLoading && !streaming) {
                 allImagesShown = true;
             }
 
@@ -1053,23 +1726,66 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
             if (isStageThreadRunning && stageThread.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
                 stageThread.get();
                 isStageThreadRunning = false;
+                timing.moveMs = stageMoveMs;
             }
 
 
 
+            // Near the thermal limit the dark phase lasts until the light engine has cooled down, at most maxCooldownMs
+            if (plan.thermal.enabled && std::chrono::steady_clock::now() - lastTemperatureRead > std::chrono::milliseconds(500)) {
+                auto now = std::chrono::steady_clock::now();
+                int16_t temperature = 0;
+                if (readTemperature(temperature)) {
+                    governor.addSample(now, temperature);
+                }
+                lastTemperatureRead = now;
+                if (!coolingDown && !cooledThisLayer && governor.needsCooldown()) {
+                    coolingDown = true;
+                    cooldownStart = now;
+                    eventLog().record(PrintEventType::CooldownStarted);
+                }
+                else if (coolingDown && (governor.cooledDown() || now - cooldownStart > std::chrono::milliseconds(plan.thermal.maxCooldownMs))) {
+                    coolingDown = false;
+                    cooledThisLayer = true;
+                    cooldownFinishedAt = std::chrono::high_resolution_clock::now();
+                    eventLog().record(PrintEventType::CooldownFinished,
+                        static_cast<int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - cooldownStart).count()));
+                }
+            }
+
             auto currentTime = std::chrono::high_resolution_clock::now();
 
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - darkTimeStart) > darkDuration && nextImageLoaded && !isStageThreadRunning) {
-                //std::cout <<"Image Loading Time:" << std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - darkTimeStart) << std::endl;
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - darkTimeStart) > std::chrono::milliseconds(layer.darkTimeMs) &&
+                nextImageLoaded && !isStageThreadRunning && !coolingDown) {
                 displayImage = true;
-                darkDisplayCount = 0;
                 isNextImageLoading = false;
-                currentImageIndex++;
+                currentLayerIndex++;
                 currentTextureIndex = 1 - currentTextureIndex;
                 nextImageLoaded = false;
+                layerMoveStarted = false;
+                cooledThisLayer = false;
                 int counter = 0;
                 filenameLogged = false;
 
+                // The condition met last held the dark phase
+                auto limit = darkTimeStart + std::chrono::milliseconds(layer.darkTimeMs);
+                timing.darkPhaseEnd = DarkPhaseEnd::DarkTime;
+                if (stageFinishedAt > limit) {
+                    limit = stageFinishedAt;
+                    timing.darkPhaseEnd = DarkPhaseEnd::StageMove;
+                }
+                if (sliceReadyAt > limit) {
+                    limit = sliceReadyAt;
+                    timing.darkPhaseEnd = slicerWaited ? DarkPhaseEnd::Slicer : DarkPhaseEnd::SliceLoad;
+                }
+                if (cooldownFinishedAt > limit) {
+                    timing.darkPhaseEnd = DarkPhaseEnd::Cooldown;
+                }
+
+                auto settingsStart = std::chrono::high_resolution_clock::now();
+                applySettings(layers[currentLayerIndex]);
+                timing.settingsMs = elapsedMs(settingsStart, std::chrono::high_resolution_clock::now());
+
                 while (counter <= 1) {//safety black screens
                     // Display the dark screen
                     window.clear();
@@ -1077,15 +1793,14 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
 
                     counter++;
                 }
+                lightEngineTrace().setPhase(LightEnginePhase::Exposure);
             }
 
 
         }
 
         if (allImagesShown && !displayImage) {
-            std::cout << "All images shown, exiting program." << std::endl;
-            logCallback("All images shown, exiting program.");
-            SetCurrent(0, static_cast<U8>(0));
+            lightEngine().setCurrent(0);
             break;
         }
 
@@ -1094,6 +1809,28 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
     // Ensure the stage thread is finished before exiting
     if (isStageThreadRunning) {
         stageThread.get();
+        timing.moveMs = stageMoveMs;
+    }
+    timing.darkPhaseEnd = allImagesShown ? DarkPhaseEnd::LastLayer : DarkPhaseEnd::Aborted;
+    closeTiming(std::chrono::high_resolution_clock::now());
+
+    // Leave the controller with the job's motion for the moves after the print
+    applyMotion(LayerMotion());
+
+    eventLog().stop(); // The layer events are logged before the summary below
+    if (allImagesShown) {
+        std::cout << "All images shown, exiting program." << std::endl;
+        logCallback("All images shown, exiting program.", LogSeverity::Info, LogSubsystem::Print);
+    }
+    reportTrace();
+    exportPrintTrace();
+    writeLayerReport();
+    finishAdjustments(layers[currentLayerIndex].sliceIndex);
+
+    // The metrics endpoint only answers while the program runs, the file keeps the values of the finished print
+    std::string metricsError;
+    if (!metricsRegistry().writeFile(printFile("print_metrics.prom"), metricsError)) {
+        logCallback(metricsError, LogSeverity::Warning, LogSubsystem::General);
     }
 
     std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
@@ -1101,27 +1838,261 @@ void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float s
     std::string position;
     position = controller.GetPosition();
     std::cout << "Final position: " << position << std::endl;
-    logCallback("Final position: " + position);
+    logCallback("Final position: " + position, LogSeverity::Info, LogSubsystem::Stage);
 
 
-    if (controller.Home()) {
-        std::cout << "Homed" << std::endl;
-        logCallback("Homed");
+    if (!stage) {
+        if (controller.Home()) {
+            std::cout << "Homed" << std::endl;
+            logCallback("Homed", LogSeverity::Info, LogSubsystem::Stage);
+        }
+        else {
+            std::cout << "Failed" << std::endl;
+        }
+
+
+        controller.SMC100CClose();
+        std::cout << "Closed connection" << std::endl;
+        logCallback("Closed connection", LogSeverity::Info, LogSubsystem::Stage);
+    }
+
+    if (closeWindow) {
+        window.close();
+    }
+
+    logCallback("Run Full has finished", LogSeverity::Info, LogSubsystem::Print);
+}
+
+/**************************************************************************************************************************************
+Function:
+    planFromRules
+Parameters:
+    const PlanRules& rules, std::shared_ptr<SliceSource> source: Complete slices of the job
+    float stepSize, const AdaptiveExposureSettings& adaptiveSettings, float pixelSize, PrintPlan& plan, LogCallback logCallback
+Returns:
+    bool: False if a layer got invalid settings, the error is logged
+Description:
+    Builds and ingests the plan of a rule file. The slices are only analysed for the variables the rules use, a rule file that only
+    depends on layer and height is evaluated without reading a single slice before the print. The analysis is shared with the
+    ingest, no slice is read twice.
+***************************************************************************************************************************************/
+
+static bool planFromRules(const PlanRules& rules, std::shared_ptr<SliceSource> source, float stepSize,
+    const AdaptiveExposureSettings& adaptiveSettings, float pixelSize, PrintPlan& plan, LogCallback logCallback) {
+    RuleInputs inputs;
+    inputs.pixelSize = pixelSize;
+    if (rules.uses(RuleVariable::NewArea) || rules.uses(RuleVariable::Islands) || rules.uses(RuleVariable::NewIslands)) {
+        logCallback("Analysing slice differences...", LogSeverity::Info, LogSubsystem::Slices);
+        inputs.diffs = analyzeSliceDiffs(*source, adaptiveSettings.downsample, pixelSize, &inputs.slices);
+    }
+    else if (rules.uses(RuleVariable::Area)) {
+        logCallback("Ingesting slices...", LogSeverity::Info, LogSubsystem::Slices);
+        inputs.slices = ingestSlices(*source);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    if (!rules.buildPlan(source, stepSize, inputs, plan, error)) {
+        std::cerr << error << std::endl;
+        logCallback(error, LogSeverity::Error, LogSubsystem::Slices);
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    logCallback("Rules evaluated for " + std::to_string(plan.layers.size()) + " layers in " + std::to_string(elapsed.count()) + " ms.",
+        LogSeverity::Info, LogSubsystem::Slices);
+
+    ingestPlan(plan, adaptiveSettings, pixelSize, logCallback, inputs.slices.empty() ? nullptr : &inputs.slices,
+        inputs.diffs.empty() ? nullptr : &inputs.diffs);
+    return true;
+}
+
+/**************************************************************************************************************************************
+Function:
+    preparePrintJob
+Parameters:
+    const PrintJob& job: Job to prepare, job.sourceSettings must carry the projector resolution
+    LogCallback logCallback, PrintPlan& plan: Receives the plan of the job
+    size_t preloadLayers: Number of planned layers to decode up front, see PreloadedSliceSource
+Returns:
+    bool: False if the job cannot be printed, the reason is logged
+Description:
+    Everything a print does before its first exposure that does not need the printer: the settings are validated, the slices opened
+    and ingested and the plan built. The Worker prepares a queued job this way while the job before it prints.
+Notes:
+    - Only complete jobs are preloaded, a streaming job's first layers may still be written when its turn comes.
+***************************************************************************************************************************************/
+
+bool preparePrintJob(const PrintJob& job, LogCallback logCallback, PrintPlan& plan, size_t preloadLayers) {
+    SliceSourceSettings sourceSettings = job.sourceSettings;
+    sourceSettings.layerHeight = std::abs(job.stepSize);
+
+    if (job.kind == PrintJobKind::Compiled) {
+        std::string error;
+        std::shared_ptr<PlanFile> file = PlanFile::open(job.jobPath, error);
+        if (!file || !buildPlanFromFile(file, plan, error)) {
+            std::cerr << error << std::endl;
+            logCallback(error, LogSeverity::Error, LogSubsystem::Slices);
+            return false;
+        }
+        logCallback("Plan contains " + std::to_string(plan.layers.size()) + " layers, about " +
+            std::to_string(file->header().durationMs / 60000) + " min of exposure and dark time.", LogSeverity::Info, LogSubsystem::Slices);
+
+        // Exposures are frame counts, at another display rate they would last longer or shorter than compiled
+        if (std::abs(file->header().frameRate - job.doseSettings.frameRate) > 0.01) {
+            logCallback("The plan was compiled for " + std::to_string(std::lround(file->header().frameRate)) + " fps but the display runs at " +
+                std::to_string(std::lround(job.doseSettings.frameRate)) + " fps, compile it again.", LogSeverity::Error, LogSubsystem::Slices);
+            return false;
+        }
+
+        bool usesDose = std::any_of(plan.layers.begin(), plan.layers.end(), [](const PlannedLayer& layer) { return layer.doseMJ > 0.0; });
+        if (usesDose && (!job.doseSettings.calibration || job.doseSettings.calibration->empty())) {
+            logCallback("The plan specifies a dose but no intensity calibration is loaded.", LogSeverity::Error, LogSubsystem::LightEngine);
+            return false;
+        }
+    }
+    else if (job.kind == PrintJobKind::Rules) {
+        std::vector<RuleError> errors;
+        std::shared_ptr<PlanRules> rules = PlanRules::load(job.rulesPath, errors);
+        if (!rules) {
+            for (const RuleError& error : errors) {
+                logCallback("Line " + std::to_string(error.line) + ": " + error.message, LogSeverity::Error, LogSubsystem::Slices);
+            }
+            return false;
+        }
+        if (rules->assigns(RuleSetting::Dose) && (!job.doseSettings.calibration || job.doseSettings.calibration->empty())) {
+            logCallback("The rules specify a dose but no intensity calibration is loaded.", LogSeverity::Error, LogSubsystem::LightEngine);
+            return false;
+        }
+
+        sourceSettings.streaming = false;
+        std::shared_ptr<SliceSource> source = openSliceSource(job.jobPath, sourceSettings, logCallback);
+        if (!source) {
+            return false;
+        }
+        if (!source->isComplete()) {
+            logCallback("Rule files need the complete slices of the job.", LogSeverity::Error, LogSubsystem::Slices);
+            return false;
+        }
+        if (!planFromRules(*rules, source, job.stepSize, job.adaptiveSettings, sourceSettings.pixelSize, plan, logCallback)) {
+            return false;
+        }
     }
     else {
-        std::cout << "Failed" << std::endl;
+        bool dynamic = job.kind == PrintJobKind::Dynamic;
+        bool usesDose = std::any_of(job.orderedSettings.begin(), job.orderedSettings.end(),
+            [](const std::pair<LayerSettings, int>& setting) { return setting.first.dose > 0.0; });
+        if (dynamic && usesDose && (!job.doseSettings.calibration || job.doseSettings.calibration->empty())) {
+            logCallback("The layer settings specify a dose but no intensity calibration is loaded.",
+                LogSeverity::Error, LogSubsystem::LightEngine);
+            return false;
+        }
+
+        std::shared_ptr<SliceSource> source = openSliceSource(job.jobPath, sourceSettings, logCallback);
+        if (!source) {
+            return false;
+        }
+        bool usesStepSize = std::any_of(job.orderedSettings.begin(), job.orderedSettings.end(),
+            [](const std::pair<LayerSettings, int>& setting) { return setting.first.stepSize.has_value(); });
+        if (dynamic && usesStepSize && std::dynamic_pointer_cast<MeshSliceSource>(source)) {
+            logCallback("The mesh is sliced at " + std::to_string(sourceSettings.layerHeight) + " mm, per-layer step sizes only change the stage travel.",
+                LogSeverity::Warning, LogSubsystem::Slices);
+        }
+
+        if (!source->isComplete()) {
+            logCallback("Printing while slicing, " + std::to_string(sourceSettings.streamLead) + " layers behind the slicer.",
+                LogSeverity::Info, LogSubsystem::Slices);
+            plan = buildStreamingPlan(source, sourceSettings.streamLead, dynamic ? dynamicLayerSettings(job.stepSize, job.orderedSettings) :
+                staticLayerSettings(job.maxImageDisplayCount, job.mindarktime, job.stepSize, job.initialExposureCounter, job.initialLayers));
+        }
+        else {
+            plan = dynamic ? buildDynamicPlan(source, job.stepSize, job.orderedSettings) :
+                buildStaticPlan(source, job.maxImageDisplayCount, job.mindarktime, job.stepSize, job.initialExposureCounter, job.initialLayers);
+
+            ingestPlan(plan, job.adaptiveSettings, sourceSettings.pixelSize, logCallback);
+        }
     }
+    plan.dose = job.doseSettings;
+    plan.thermal = job.thermalSettings;
+    plan.motion = job.motionSettings;
+    std::filesystem::path jobPath(job.jobPath);
+    plan.name = (jobPath.has_filename() ? jobPath : jobPath.parent_path()).stem().string();
+
+    if (preloadLayers > 0 && !plan.extend) {
+        std::vector<size_t> first;
+        for (size_t i = 0; i < std::min(preloadLayers, plan.layers.size()); ++i) {
+            first.push_back(plan.layers[i].sliceIndex);
+        }
+        auto preloaded = std::make_shared<PreloadedSliceSource>(plan.source, first);
+        logCallback("Preloaded the first " + std::to_string(preloaded->preloadedCount()) + " layers.",
+            LogSeverity::Info, LogSubsystem::Slices);
+        plan.source = preloaded;
+    }
+    return true;
+}
 
+// Shared end of RunFull, RunFullDynamic, RunFullRules and RunCompiledPlan, the plan is built in the print thread right before the print
+static void runPrintJob(PrintJob job, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag) {
+    if (!job.isClip) {
+        logCallback("Dlp mode initialized.", LogSeverity::Info, LogSubsystem::Print);
+    }
 
-    controller.SMC100CClose();
-    std::cout << "Closed connection" << std::endl;
-    logCallback("Closed connection");
+    // Enable VSync to synchronize with the monitor refresh rate
+    window.setVerticalSyncEnabled(true);
+    window.setFramerateLimit(30);
 
-    window.close();
+    job.sourceSettings.width = window.getSize().x;
+    job.sourceSettings.height = window.getSize().y;
 
-    return;
+    PrintPlan plan;
+    if (!preparePrintJob(job, logCallback, plan)) {
+        return;
+    }
+    RunPlan(plan, window, logCallback, getAbortFlag, job.isClip, job.dlpPumpingAction);
+}
+
+/**************************************************************************************************************************************
+Function:
+    RunFull
+Parameters:
+    const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction, int initialExposureCounter, int initialLayers, SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings
+Returns:
+    void
+Description:
+    Non-Dynamic Print. Either DLP or Clip according to user input. Executes a full run of the system, cycling through a sequence of images while controlling the stage based on specified parameters.
+    This function integrates image display, stage control, and dynamic parameter adjustments into a cohesive operation, demonstrating
+    the system's full capabilities.
+Notes:
+    - The function is designed to be flexible, allowing for dynamic adjustment of parameters such as exposure time and step size.
+    - It showcases the ability to respond to external signals (e.g., an abort flag) for increased control during operation.
+    - The slices are ingested before the print, empty slices are folded into the neighbouring moves (see foldEmptyLayers).
+    - directoryPath may also name an STL mesh, which is then sliced in memory at the layer height given by stepSize.
+    - With sourceSettings.streaming the print starts while the slicer is still writing directoryPath (see buildStreamingPlan).
+    - adaptiveSettings.enabled lengthens the exposure of overhang and new island layers, complete jobs only (see ingestPlan).
+Author:
+    Mats Grobe, 28/02/2024
+***************************************************************************************************************************************/
 
-    logCallback("Run Full has finished");
+void RunFull(const std::string& directoryPath, int maxImageDisplayCount, float stepSize, int mindarktime, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+    float dlpPumpingAction, 
+    int initialExposureCounter, int initialLayers, SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings,
+    ThermalGovernorSettings thermalSettings) {
+
+    logCallback("Run Full has started", LogSeverity::Info, LogSubsystem::Print);
+
+    PrintJob job;
+    job.kind = PrintJobKind::Static;
+    job.jobPath = directoryPath;
+    job.maxImageDisplayCount = maxImageDisplayCount;
+    job.mindarktime = mindarktime;
+    job.initialExposureCounter = initialExposureCounter;
+    job.initialLayers = initialLayers;
+    job.stepSize = stepSize;
+    job.isClip = isClip;
+    job.dlpPumpingAction = dlpPumpingAction;
+    job.sourceSettings = sourceSettings;
+    job.adaptiveSettings = adaptiveSettings;
+    job.thermalSettings = thermalSettings;
+    runPrintJob(job, window, logCallback, getAbortFlag);
 }
 
 
@@ -1283,7 +2254,7 @@ void RunFullDummy(const std::string& directoryPath, sf::RenderWindow& window) {
 Function:
     RunFullDynamic
 Parameters:
-    const std::string& directoryPath, float stepSize, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction, const std::vector<std::pair<LayerSettings, int>>& orderedSettings
+    const std::string& directoryPath, float stepSize, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction, const std::vector<std::pair<LayerSettings, int>>& orderedSettings, SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings
 Returns:
     void
 Description:
@@ -1292,6 +2263,9 @@ Description:
 Notes:
     - Demonstrates advanced usage of the system's capabilities, allowing for complex experiments with varying parameters across layers.
     - The function's design supports experimentation with different settings to optimize outcomes based on dynamic criteria.
+    - The settings are expanded into a per-layer plan and executed by RunPlan, empty slices are folded into the neighbouring moves.
+    - Settings may carry their own step size, velocity, acceleration and pumping distance; the others use stepSize,
+      motionSettings and dlpPumpingAction. A mesh is still sliced at stepSize, per-layer step sizes only change the travel.
 Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
@@ -1299,350 +2273,189 @@ Author:
 
 void RunFullDynamic(const std::string& directoryPath, float stepSize, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
     float dlpPumpingAction,
-    const std::vector<std::pair<LayerSettings, int>>& orderedSettings) {
+    const std::vector<std::pair<LayerSettings, int>>& orderedSettings, SliceSourceSettings sourceSettings,
+    AdaptiveExposureSettings adaptiveSettings, DoseSettings doseSettings, ThermalGovernorSettings thermalSettings,
+    MotionSettings motionSettings) {
+
+    logCallback("Run Full Dynamic has started", LogSeverity::Info, LogSubsystem::Print);
+
+    PrintJob job;
+    job.kind = PrintJobKind::Dynamic;
+    job.jobPath = directoryPath;
+    job.orderedSettings = orderedSettings;
+    job.stepSize = stepSize;
+    job.isClip = isClip;
+    job.dlpPumpingAction = dlpPumpingAction;
+    job.sourceSettings = sourceSettings;
+    job.adaptiveSettings = adaptiveSettings;
+    job.doseSettings = doseSettings;
+    job.thermalSettings = thermalSettings;
+    job.motionSettings = motionSettings;
+    runPrintJob(job, window, logCallback, getAbortFlag);
+}
 
-    for (const auto& pair : orderedSettings) {
-        const LayerSettings& settings = pair.first;
-        int layerCount = pair.second;
+/**************************************************************************************************************************************
+Function:
+    RunFullRules
+Parameters:
+    const std::string& directoryPath, const std::string& rulesPath: Rule file, see PlanRules
+    float stepSize, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+    float dlpPumpingAction, SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings, DoseSettings doseSettings,
+    ThermalGovernorSettings thermalSettings, MotionSettings motionSettings
+Returns:
+    void
+Description:
+    Dynamic print whose layer settings are computed from rules instead of read from a CSV. The rules are compiled, evaluated for
+    every slice and the plan executed by RunPlan like the one of RunFullDynamic.
+Notes:
+    - The rules need the number of slices and their analytics up front, a job that is still being sliced cannot be printed with them.
+***************************************************************************************************************************************/
 
-        // Apply settings
-        std::cout << "setIntensity:  " << settings.intensity <<
-            ", setExposureTime:  " << settings.exposureTime << ", setDarkTime:  " << settings.darkTime << std::endl;
+void RunFullRules(const std::string& directoryPath, const std::string& rulesPath, float stepSize, sf::RenderWindow& window,
+    LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip, float dlpPumpingAction,
+    SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings, DoseSettings doseSettings,
+    ThermalGovernorSettings thermalSettings, MotionSettings motionSettings) {
+
+    logCallback("Run Full Rules has started", LogSeverity::Info, LogSubsystem::Print);
+
+    PrintJob job;
+    job.kind = PrintJobKind::Rules;
+    job.jobPath = directoryPath;
+    job.rulesPath = rulesPath;
+    job.stepSize = stepSize;
+    job.isClip = isClip;
+    job.dlpPumpingAction = dlpPumpingAction;
+    job.sourceSettings = sourceSettings;
+    job.adaptiveSettings = adaptiveSettings;
+    job.doseSettings = doseSettings;
+    job.thermalSettings = thermalSettings;
+    job.motionSettings = motionSettings;
+    runPrintJob(job, window, logCallback, getAbortFlag);
+}
 
-        // Wait for one second after processing a group of layers with the same settings
-        std::cout << "Waiting for 1 second after changing parameters..." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+/**************************************************************************************************************************************
+Function:
+    CompilePlan
+Parameters:
+    const std::string& directoryPath: Folder with the slice images
+    const std::string& settingsPath: Dynamic settings CSV or rule file (.rules)
+    const std::string& planPath: Compiled plan to write, see PlanFile
+    float stepSize, SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings
+    double frameRate: Display rate the plan will be printed at (DoseSettings::frameRate), stored in the header for the timing
+    LogCallback logCallback
+Returns:
+    bool: True once the plan file is written
+Description:
+    Does everything RunFullDynamic does before the print once and stores the result: the settings are validated, expanded over the
+    slices of the folder, adjusted for overhangs if enabled and the empty slices folded. RunCompiledPlan then starts from the file
+    without reading the CSV or the slices again.
+Notes:
+    - A settings file with rejected rows is not compiled, the plan file only ever holds a fully validated job.
+    - A rule file is evaluated once here, the compiled plan holds the resulting per-layer values.
+    - Only image folders can be compiled, meshes and vector slices are rendered during the print and have no slice files to refer to.
+***************************************************************************************************************************************/
 
-        // Print layers with the current settings
-        for (int i = 0; i < layerCount; ++i) {
-            //Printing operations take place here
-            std::cout << "Printed layer with Intensity: " << settings.intensity
-                << ", Exposure Time: " << settings.exposureTime
-                << ", Dark Time: " << settings.darkTime << std::endl;
+bool CompilePlan(const std::string& directoryPath, const std::string& settingsPath, const std::string& planPath, float stepSize,
+    SliceSourceSettings sourceSettings, AdaptiveExposureSettings adaptiveSettings, double frameRate, LogCallback logCallback) {
+
+    bool isRuleFile = std::filesystem::path(settingsPath).extension() == ruleFileExtension;
+    std::shared_ptr<PlanRules> rules;
+    LayerSettingsFile settingsFile;
+    if (isRuleFile) {
+        std::vector<RuleError> errors;
+        rules = PlanRules::load(settingsPath, errors);
+        for (const RuleError& error : errors) {
+            logCallback("Line " + std::to_string(error.line) + ": " + error.message, LogSeverity::Error, LogSubsystem::Slices);
+        }
+        if (!rules) {
+            logCallback("Fix the " + std::to_string(errors.size()) + " problems in the rule file before compiling.",
+                LogSeverity::Error, LogSubsystem::Slices);
+            return false;
         }
-
-
     }
-
-
-    logCallback("Run Full Dynamic has started");
-    if (!isClip) {
-        logCallback("Dlp mode initialized.");
+    else {
+        readLayerSettings(settingsPath, settingsFile);
     }
-    //--------------------------------------------------------Graphics Set Up-----------------------------------------------------------------
-
-    // Retrieve the desktop mode of the primary monitor
-    sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
-
-    // Enable VSync to synchronize with the monitor refresh rate
-    window.setVerticalSyncEnabled(true);
-    window.setFramerateLimit(30);
-
-    // Vector to store image paths
-    std::vector<std::string> imagePaths;
-
-
-    logCallback("Adding paths to imagePaths vector.");
-
-    // Iterate over files in the directory and add image paths to the vector
-    try {
-        for (const auto& entry : fs::directory_iterator(directoryPath)) {
-            imagePaths.push_back(entry.path().string());
+    for (const LayerSettingsError& warning : settingsFile.warnings) {
+        logCallback("Line " + std::to_string(warning.line) + ": " + warning.message, LogSeverity::Warning, LogSubsystem::Slices);
+    }
+    if (!settingsFile.errors.empty()) {
+        for (const LayerSettingsError& error : settingsFile.errors) {
+            logCallback("Line " + std::to_string(error.line) + ": " + error.message, LogSeverity::Error, LogSubsystem::Slices);
         }
+        logCallback("Fix the " + std::to_string(settingsFile.errors.size()) + " problems in the settings file before compiling.",
+            LogSeverity::Error, LogSubsystem::Slices);
+        return false;
     }
-    catch (const std::filesystem::filesystem_error& e) {
-        std::cerr << "Filesystem error: " << e.what() << '\n';
-        logCallback("Filesystem error: " + std::string(e.what()));
-
-        // Handle error (e.g., return or throw an exception)
-        return;
+    std::vector<std::pair<LayerSettings, int>> orderedSettings;
+    orderedSettings.reserve(settingsFile.runs.size());
+    for (const LayerSettingsRun& run : settingsFile.runs) {
+        orderedSettings.emplace_back(run.settings, run.layerCount);
     }
 
-
-    std::sort(imagePaths.begin(), imagePaths.end(), customSort);
-
-    sf::Texture currentTexture, nextTexture, textures[2];
-    sf::Sprite sprite;
-    int currentTextureIndex = 0; // Index to track the current texture
-
-    size_t currentImage = 0, nextImage = 1, currentImageIndex = 0;
-    bool showImage = true, nextImageLoaded = false, isNextImageLoading = false, allImagesShown = false;
-
-    // Preload the first image
-    if (!textures[currentTextureIndex].loadFromFile(imagePaths[currentImage])) {
-        std::cerr << "Failed to load first image: " << imagePaths[currentImage] << std::endl;
-        logCallback("Failed to load first image: " + imagePaths[currentImage]);
-
-        //return -1;
+    sourceSettings.streaming = false;
+    sourceSettings.layerHeight = std::abs(stepSize);
+    std::shared_ptr<SliceSource> source = openSliceSource(directoryPath, sourceSettings, logCallback);
+    if (!source) {
+        return false;
     }
-
-    // Pre-calculate the scale for all sprites
-    float scaleX = static_cast<float>(window.getSize().x) / textures[currentTextureIndex].getSize().x;
-    float scaleY = static_cast<float>(window.getSize().y) / textures[currentTextureIndex].getSize().y;
-
-
-
-    //--------------------------------------------------------Stage Set Up-----------------------------------------------------------------
-
-    SMC100C controller;
-
-    // Test Initialization
-    logCallback("Testing Initialization...");
-    if (!initializeController(controller)) {
-        exit(0);
+    if (!std::dynamic_pointer_cast<ImageDirectorySource>(source)) {
+        logCallback("Only slice image folders can be compiled into a plan.", LogSeverity::Error, LogSubsystem::Slices);
+        return false;
     }
-    logCallback("Success");
-
-    std::future<void> stageThread; // Future for async operation
-
-    bool isStageThreadRunning = false;
-
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Wait for response
-
-
-    //---------------------------------------------------------------------------------Stage Setup-------------------------------------------------------------------------
-
-
-
-    std::chrono::high_resolution_clock::time_point darkTimeStart;
-    
-
-
-    // Initialize timers
-    std::chrono::high_resolution_clock::time_point lastFrameStart = std::chrono::high_resolution_clock::now();
-    std::chrono::high_resolution_clock::time_point lastFrameEnd = lastFrameStart;
-    std::chrono::high_resolution_clock::time_point phaseStartTime = std::chrono::high_resolution_clock::now(); // Track the start of the phase
-
-
-    float accumulatedDuration = 0.0f;
-    int imageDisplayCount = 0;
-    int darkDisplayCount = 0;
-    const int maxDarkDisplayCount = 1;
-    sf::Clock clock;
-    bool filenameLogged = false; // Ensures filename is logged once per image
-    bool inLightPhase = true;
-
-    // Start the game loop
-    bool displayImage = true;
-    bool change = true;
-    U8 currentValue; // = GetCurrent(0, 0);
-    int currentLayer = 0; // Track the current layer being processed
-    bool inInitialPhase = true;
-
-    auto startPhaseTime = std::chrono::high_resolution_clock::now();
-    bool inExposurePhase = true;
-    int layercounter = 0;
-
-    while (window.isOpen()) {
-        // Process events
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
-                window.close();
-        }
-
-        logCallback("Just before loop.");
-
-        for (const auto& setting : orderedSettings) {
-            const LayerSettings& currentSetting = setting.first;
-            int layerCount = setting.second;
-
-            // Apply the current settings
-            logCallback("Applying settings: Intensity " + std::to_string(currentSetting.intensity) +
-                ", Exposure Time: " + std::to_string(currentSetting.exposureTime) +
-                ", Dark Time: " + std::to_string(currentSetting.darkTime));
-
-            int maxImageDisplayCount = currentSetting.exposureTime;
-            std::chrono::milliseconds darkDuration(currentSetting.darkTime); // 100ms for the dark time
-            SetCurrent(0, static_cast<U8>(currentSetting.intensity));
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));  // Wait for response
-            layercounter = 0;
-
-            while (layercounter <= layerCount) {
-
-                // Draw the white or black screen
-                if (displayImage) {
-
-
-                    if (getAbortFlag()) {
-                        logCallback("Run Full aborted.");
-                        // Perform any necessary cleanup...
-                        return; // Exit the function
-                    }
-
-                    // Clear screen
-                    window.clear();
-                    sprite.setTexture(textures[currentTextureIndex]);
-                    sprite.setScale(scaleX, scaleY);
-                    window.draw(sprite);
-                    window.display(); // Update the window (this is where VSync wait happens)
-
-                    if (!filenameLogged && inLightPhase) {
-                        logCallback("Displaying: " + imagePaths[currentImageIndex]);
-                        filenameLogged = true;
-                        auto now = std::chrono::high_resolution_clock::now();
-                        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - phaseStartTime).count();
-                        logCallback("Dark phase duration: " + std::to_string(duration) + " ms");
-                        inLightPhase = false; // Next phase is dark
-                        phaseStartTime = now; // Reset start time for dark phase
-                    }
-
-
-                    imageDisplayCount++;
-                    //std::cout << imageDisplayCount << std::endl;
-
-                    if (imageDisplayCount >= maxImageDisplayCount) {
-                        displayImage = false;
-                        imageDisplayCount = 0;
-                        currentLayer++;
-
-                        try {
-                            std::string pos = controller.GetPosition();
-                            pos.erase(std::remove(pos.begin(), pos.end(), '\n'), pos.end());
-                            pos.erase(std::remove(pos.begin(), pos.end(), '\r'), pos.end());
-                            if (pos.length() >= 9) { // Ensure the string is long enough for substr operation
-                                std::string positionValue = pos.substr(3, 6);
-                                std::string posMessage = "Position: " + positionValue + " mm";
-                                logCallback(posMessage);
-                            }
-                            else {
-                                logCallback("Error: Position string too short or in unexpected format.");
-                            }
-                        }
-                        catch (const std::exception& e) {
-                            logCallback("Exception caught while processing position: " + std::string(e.what()));
-                            // Handle the exception or log it, but don't terminate the loop
-                        }
-
-                        // Debug print the current status
-                        std::cout << "Current Image Index: " << currentImageIndex << " / " << imagePaths.size() << std::endl;
-                        logCallback("Current Image Index: " + std::to_string(currentImageIndex) + " / " + std::to_string(imagePaths.size()));
-                        darkTimeStart = std::chrono::high_resolution_clock::now(); // Start dark time
-                    }
-
-                }
-                else {
-
-                    // Display the dark screen
-                    window.clear();
-                    // Update the window (this is where VSync wait happens)
-                    window.display();
-
-                    // Immediately after the dark phase display call
-                    if (!inLightPhase) {
-                        auto now = std::chrono::high_resolution_clock::now();
-                        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - phaseStartTime).count();
-                        logCallback("Light phase duration: " + std::to_string(duration) + " ms");
-                        inLightPhase = true; // Next phase is light
-                        phaseStartTime = now; // Reset start time for light phase
-                    }
-
-                    if (!isStageThreadRunning && !nextImageLoaded) {
-                        // Start the stage control thread with the user-defined step size
-                        stageThread = std::async(std::launch::async, moveStage, std::ref(controller), stepSize, isClip, dlpPumpingAction);
-                        isStageThreadRunning = true;
-                    }
-
-                    // Start loading the next image 
-                    if (currentImageIndex + 1 < imagePaths.size() && !isNextImageLoading) {
-                        isNextImageLoading = true;
-                        int nextTextureIndex = 1 - currentTextureIndex;
-                        textures[nextTextureIndex].loadFromFile(imagePaths[currentImageIndex + 1]);
-                        nextImageLoaded = true;
-                        std::cout << "Next Image Loaded." << std::endl;
-                        logCallback("Next Image Loaded.");
-
-                    }
-
-                    else if (currentImageIndex + 1 >= imagePaths.size() && !isNextImageLoading) {
-                        allImagesShown = true;
-                    }
-
-                    // Check if the stage thread has completed
-                    if (isStageThreadRunning && stageThread.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-                        stageThread.get();
-                        isStageThreadRunning = false;
-                    }
-
-
-
-                    auto currentTime = std::chrono::high_resolution_clock::now();
-
-                    if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - darkTimeStart) > darkDuration && nextImageLoaded && !isStageThreadRunning) {
-                        //std::cout <<"Image Loading Time:" << std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - darkTimeStart) << std::endl;
-                        displayImage = true;
-                        darkDisplayCount = 0;
-                        isNextImageLoading = false;
-                        currentImageIndex++;
-                        currentTextureIndex = 1 - currentTextureIndex;
-                        nextImageLoaded = false;
-                        int counter = 0;
-                        filenameLogged = false;
-
-                        while (counter <= 1) {
-                            // Display the dark screen
-                            window.clear();
-                            window.display();
-
-                            counter++;
-                        }
-                        std::cout << "Printed layer with Intensity: " << currentSetting.intensity
-                            << ", Exposure Time: " << currentSetting.exposureTime
-                            << ", Dark Time: " << currentSetting.darkTime << std::endl;
-                        layercounter++;
-                    }
-
-
-
-
-                }
-                if (allImagesShown && !displayImage) {
-                    std::cout << "All images shown, exiting program." << std::endl;
-                    logCallback("All images shown, exiting program.");
-                    SetCurrent(0, static_cast<U8>(0));
-                    break;
-                }
-            }
-
 
+    PrintPlan plan;
+    if (rules) {
+        if (!planFromRules(*rules, source, stepSize, adaptiveSettings, sourceSettings.pixelSize, plan, logCallback)) {
+            return false;
         }
-
-        break;
-    }
-
-    // Ensure the stage thread is finished before exiting
-    if (isStageThreadRunning) {
-        stageThread.get();
-    }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Wait for response
-
-    std::string position;
-    position = controller.GetPosition();
-    std::cout << "Final position: " << position << std::endl;
-    logCallback("Final position: " + position);
-
-
-    if (controller.Home()) {
-        std::cout << "Homed" << std::endl;
-        logCallback("Homed");
     }
     else {
-        std::cout << "Failed" << std::endl;
+        plan = buildDynamicPlan(source, stepSize, orderedSettings);
+        ingestPlan(plan, adaptiveSettings, sourceSettings.pixelSize, logCallback);
     }
 
+    uint32_t flags = PlanFileEmptyLayersFolded | (adaptiveSettings.enabled ? PlanFileAdaptiveExposure : 0u);
+    std::string error;
+    if (!writePlanFile(planPath, plan, flags, static_cast<float>(frameRate), error)) {
+        std::cerr << error << std::endl;
+        logCallback(error, LogSeverity::Error, LogSubsystem::Slices);
+        return false;
+    }
+    logCallback("Compiled " + std::to_string(plan.layers.size()) + " layers into " + planPath, LogSeverity::Info, LogSubsystem::Slices);
+    return true;
+}
 
-    controller.SMC100CClose();
-    std::cout << "Closed connection" << std::endl;
-    logCallback("Closed connection");
-
-    window.close();
-
-    return;
+/**************************************************************************************************************************************
+Function:
+    RunCompiledPlan
+Parameters:
+    const std::string& planPath, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag, bool isClip,
+    float dlpPumpingAction, DoseSettings doseSettings, ThermalGovernorSettings thermalSettings, MotionSettings motionSettings
+Returns:
+    void
+Description:
+    Dynamic print of a plan compiled by CompilePlan. The file is mapped and its records executed by RunPlan, the layer settings, the
+    slice folder and the ingest are taken from the file as they were when it was compiled.
+Notes:
+    - A plan compiled for another display rate than doseSettings.frameRate is refused, its exposure times would not hold.
+***************************************************************************************************************************************/
 
-    logCallback("Run Full has finished");
+void RunCompiledPlan(const std::string& planPath, sf::RenderWindow& window, LogCallback logCallback, std::function<bool()> getAbortFlag,
+    bool isClip, float dlpPumpingAction, DoseSettings doseSettings, ThermalGovernorSettings thermalSettings,
+    MotionSettings motionSettings) {
+
+    logCallback("Run Compiled Plan has started", LogSeverity::Info, LogSubsystem::Print);
+
+    PrintJob job;
+    job.kind = PrintJobKind::Compiled;
+    job.jobPath = planPath;
+    job.isClip = isClip;
+    job.dlpPumpingAction = dlpPumpingAction;
+    job.doseSettings = doseSettings;
+    job.thermalSettings = thermalSettings;
+    job.motionSettings = motionSettings;
+    runPrintJob(job, window, logCallback, getAbortFlag);
 }
 
 
@@ -1651,11 +2464,17 @@ Function:
     readSettingsOrdered
 Parameters:
     const std::string& filePath
+    std::vector<LayerSettingsError>& errors: Receives the rejected rows and other problems of the file, warnings go to std::cerr only
 Returns:
-    std::vector<std::pair<LayerSettings, int>>
+    std::vector<std::pair<LayerSettings, int>>: Empty if the file has any problem
 Description:
     Needed for dynamic printing. Reads layer settings from a specified file and organizes them into a vector of pairs, where each pair consists of LayerSettings
-    and an integer representing the number of layers to be printed with those settings.
+    and an integer representing the number of consecutive layers to be printed with those settings, in file order (see parseLayerSettings).
+    A file whose header names a Dose column instead (Layer,Dose,DarkTime) specifies the dose in mJ/cm²; intensity and exposure are then
+    chosen from the intensity calibration during the print. An optional last column holds an intensity profile such as 255:400;120:1600
+    (see parseIntensityProfile).
+    The runs only carry layer counts, a skipped row would shift every later run one slice earlier. A file with rejected rows is
+    therefore refused as a whole, the same way CompilePlan refuses it. Warnings such as an ignored column do not refuse the file.
 Notes:
     - The function demonstrates data handling and preprocessing necessary for dynamic operation modes, such as RunFullDynamic.
     - It emphasizes the system's adaptability and potential for automated parameter adjustments based on external input.
@@ -1663,46 +2482,29 @@ Author:
     Mats Grobe, 28/02/2024
 ***************************************************************************************************************************************/
 
-LayerSettings::LayerSettings(int i, int e, int d) : intensity(i), exposureTime(e), darkTime(d) {}
+LayerSettings::LayerSettings(int i, int e, int d, double dose, const std::string& profile)
+    : intensity(i), exposureTime(e), darkTime(d), dose(dose), profile(profile) {}
 
 
 // Function to read and store settings in order of appearance
-std::vector<std::pair<LayerSettings, int>> readSettingsOrdered(const std::string& filePath) {
-    std::ifstream file(filePath);
-    std::string line;
-    std::vector<std::pair<LayerSettings, int>> orderedSettings;
-    std::map<LayerSettings, int> settingsCount;
-
-    // Skip header
-    std::getline(file, line);
-
-    // Read and parse each line
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        int layer, intensity, exposureTime, darkTime;
-        char delim; // For the commas
-
-        iss >> layer >> delim >> intensity >> delim >> exposureTime >> delim >> darkTime;
-        LayerSettings currentSetting(intensity, exposureTime, darkTime);
-
-        // If this setting is new, add it to the ordered vector
-        if (settingsCount.find(currentSetting) == settingsCount.end()) {
-            orderedSettings.emplace_back(currentSetting, 1);
-        }
-        else {
-            // If it exists, increment the count in both the map and the vector
-            settingsCount[currentSetting]++;
-            for (auto& setting : orderedSettings) {
-                if (setting.first == currentSetting) {
-                    setting.second++;
-                    break;
-                }
-            }
-        }
-
-        // Also keep track in the map for easy finding
-        settingsCount[currentSetting]++;
+std::vector<std::pair<LayerSettings, int>> readSettingsOrdered(const std::string& filePath, std::vector<LayerSettingsError>& errors) {
+    LayerSettingsFile settingsFile;
+    readLayerSettings(filePath, settingsFile);
+    errors = settingsFile.errors;
+    for (const LayerSettingsError& error : settingsFile.errors) {
+        std::cerr << filePath << ":" << error.line << ": " << error.message << std::endl;
+    }
+    for (const LayerSettingsError& warning : settingsFile.warnings) {
+        std::cerr << filePath << ":" << warning.line << ": warning: " << warning.message << std::endl;
     }
 
+    std::vector<std::pair<LayerSettings, int>> orderedSettings;
+    if (!errors.empty()) {
+        return orderedSettings;
+    }
+    orderedSettings.reserve(settingsFile.runs.size());
+    for (const LayerSettingsRun& run : settingsFile.runs) {
+        orderedSettings.emplace_back(run.settings, run.layerCount);
+    }
     return orderedSettings;
 }
\ No newline at end of file